@@ -0,0 +1,431 @@
+#include <cstring>
+#include <numeric>
+#include <QFile>
+#include <QFileInfo>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrentMap>
+#include "AsyncFileIO.h"
+#include "Metrics.h"
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef FLATFIELD_IO_URING
+#include <cerrno>
+#include <liburing.h>
+
+// Linux limit of bytes transferred by one read or write, larger blocks are split into several requests.
+static constexpr qint64 maxRequestSize = 0x7ffff000;
+// Large blocks are split into requests of at least this size, so a single strip still fills the queue.
+static constexpr qint64 minSplitRequestSize = 1 << 20;
+
+// One ring per thread, created on first use and kept for the life of the thread. It has room for the maximal queue depth.
+struct UringRing
+{
+	io_uring ring;
+	bool isValid = false;
+
+	UringRing()
+	{
+		isValid = io_uring_queue_init(AsyncFileIO::maxQueueDepth, &ring, 0) == 0;
+	}
+
+	~UringRing()
+	{
+		if (isValid)
+		{
+			io_uring_queue_exit(&ring);
+		}
+	}
+};
+
+static thread_local UringRing uringRing;
+#endif
+
+// Pool size follows the queue depth. It is changed only together with the depth, as the pool is shared by concurrent transfers.
+class TransferThreadPool : public QThreadPool
+{
+public:
+	TransferThreadPool()
+	{
+		setMaxThreadCount(AsyncFileIO::defaultQueueDepth);
+	}
+};
+
+Q_GLOBAL_STATIC(TransferThreadPool, threadPool)
+
+QAtomicInt AsyncFileIO::queueDepth = AsyncFileIO::defaultQueueDepth;
+QAtomicInt AsyncFileIO::cachePolicy = AsyncFileIO::CachePolicyEnum::Buffered;
+
+void AsyncFileIO::setQueueDepth(int depth)
+{
+	queueDepth.storeRelaxed(qBound(1, depth, maxQueueDepth));
+	threadPool->setMaxThreadCount(getQueueDepth());
+}
+
+int AsyncFileIO::getQueueDepth()
+{
+	return queueDepth.loadRelaxed();
+}
+
+void AsyncFileIO::setCachePolicy(CachePolicyEnum policy)
+{
+	cachePolicy.storeRelaxed(policy);
+}
+
+AsyncFileIO::CachePolicyEnum AsyncFileIO::getCachePolicy()
+{
+	return static_cast<CachePolicyEnum>(cachePolicy.loadRelaxed());
+}
+
+bool AsyncFileIO::read(const QString& filePath, const QList<Block>& blocks, bool streamed)
+{
+	const Metrics::GaugeScope inFlight(Metrics::IORequestsInFlight, blocks.size());
+
+	bool isRead;
+#ifdef Q_OS_LINUX
+	if (streamed && getCachePolicy() == CachePolicyEnum::Direct)
+	{
+		isRead = readDirect(filePath, blocks);
+	}
+	else
+#endif
+	{
+		isRead = transfer(filePath, blocks, false, false);
+	}
+
+	if (isRead)
+	{
+		Metrics::add(Metrics::BytesRead, getSize(blocks));
+	}
+	return isRead;
+}
+
+bool AsyncFileIO::write(const QString& filePath, const QList<Block>& blocks)
+{
+	const Metrics::GaugeScope inFlight(Metrics::IORequestsInFlight, blocks.size());
+
+	const bool isWritten = transfer(filePath, blocks, true, false);
+	if (isWritten)
+	{
+		Metrics::add(Metrics::BytesWritten, getSize(blocks));
+	}
+	return isWritten;
+}
+
+qint64 AsyncFileIO::getSize(const QList<Block>& blocks)
+{
+	qint64 size = 0;
+	for (const Block& block : blocks)
+	{
+		size += block.size;
+	}
+	return size;
+}
+
+void AsyncFileIO::readAhead(const QString& filePath, qint64 offset, qint64 size)
+{
+	if (getCachePolicy() != CachePolicyEnum::Direct)
+	{
+		adviseWillNeed(filePath, offset, size);
+	}
+}
+
+void AsyncFileIO::keepCached(const QString& filePath, qint64 offset, qint64 size)
+{
+	if (getCachePolicy() != CachePolicyEnum::Buffered)
+	{
+		adviseWillNeed(filePath, offset, size);
+	}
+}
+
+void AsyncFileIO::adviseWillNeed(const QString& filePath, qint64 offset, qint64 size)
+{
+#ifdef Q_OS_LINUX
+	const int fd = ::open(QFile::encodeName(filePath).constData(), O_RDONLY | O_CLOEXEC);
+	if (fd >= 0)
+	{
+		posix_fadvise(fd, offset, size, POSIX_FADV_WILLNEED);
+		::close(fd);
+	}
+#else
+	Q_UNUSED(filePath);
+	Q_UNUSED(offset);
+	Q_UNUSED(size);
+#endif
+}
+
+void AsyncFileIO::releaseCached(const QString& filePath, bool written)
+{
+#ifdef Q_OS_LINUX
+	if (getCachePolicy() == CachePolicyEnum::Buffered || filePath.isEmpty())
+	{
+		return;
+	}
+
+	const int fd = ::open(QFile::encodeName(filePath).constData(), O_RDONLY | O_CLOEXEC);
+	if (fd >= 0)
+	{
+		if (written)
+		{
+			fdatasync(fd);
+		}
+		posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+		::close(fd);
+	}
+#else
+	Q_UNUSED(filePath);
+	Q_UNUSED(written);
+#endif
+}
+
+bool AsyncFileIO::transfer(const QString& filePath, const QList<Block>& blocks, bool write, bool direct)
+{
+	if (blocks.isEmpty())
+	{
+		return true;
+	}
+
+#ifdef FLATFIELD_IO_URING
+	bool success = false;
+	if (transferUring(filePath, blocks, write, direct, &success))
+	{
+		return success;
+	}
+#endif
+
+	return transferThreaded(filePath, blocks, write, direct);
+}
+
+#ifdef Q_OS_LINUX
+bool AsyncFileIO::readDirect(const QString& filePath, const QList<Block>& blocks)
+{
+	// File systems without O_DIRECT support are read through the page cache.
+	const int fd = ::open(QFile::encodeName(filePath).constData(), O_RDONLY | O_DIRECT | O_CLOEXEC);
+	if (fd < 0)
+	{
+		return transfer(filePath, blocks, false, false);
+	}
+	::close(fd);
+
+	// Blocks are widened to aligned ranges of one aligned buffer and copied out after reading.
+	// Ranges which would end past the end of file can't be read in full, so they go through the page cache.
+	const qint64 fileSize = QFileInfo(filePath).size();
+	QList<Block> alignedBlocks;
+	QList<Block> bufferedBlocks;
+	QList<int> alignedIndexes;
+	qint64 bufferSize = 0;
+	for (int i = 0; i < blocks.size(); i++)
+	{
+		const qint64 start = blocks[i].offset / directAlignment * directAlignment;
+		const qint64 end = (blocks[i].offset + blocks[i].size + directAlignment - 1) / directAlignment * directAlignment;
+		if (end > fileSize)
+		{
+			bufferedBlocks.append(blocks[i]);
+			continue;
+		}
+
+		alignedBlocks.append({ start, end - start, nullptr });
+		alignedIndexes.append(i);
+		bufferSize += end - start;
+	}
+
+	char* buffer = static_cast<char*>(qMallocAligned(static_cast<size_t>(qMax(bufferSize, directAlignment)), directAlignment));
+	if (buffer == nullptr)
+	{
+		return transfer(filePath, blocks, false, false);
+	}
+
+	for (qint64 i = 0, position = 0; i < alignedBlocks.size(); position += alignedBlocks[i].size, i++)
+	{
+		alignedBlocks[i].data = buffer + position;
+	}
+
+	bool success = transfer(filePath, alignedBlocks, false, true);
+	for (int i = 0; i < alignedBlocks.size() && success; i++)
+	{
+		const Block& block = blocks[alignedIndexes[i]];
+		std::memcpy(block.data, alignedBlocks[i].data + (block.offset - alignedBlocks[i].offset), static_cast<size_t>(block.size));
+	}
+
+	qFreeAligned(buffer);
+	return success && transfer(filePath, bufferedBlocks, false, false);
+}
+#endif
+
+bool AsyncFileIO::transferThreaded(const QString& filePath, const QList<Block>& blocks, bool write, bool direct)
+{
+	// Blocks are split into one group per queue slot, every group is handled by a pool thread with its own file handle.
+	const int groupsCount = qBound(1, getQueueDepth(), static_cast<int>(blocks.size()));
+	QList<int> groups(groupsCount);
+	std::iota(groups.begin(), groups.end(), 0);
+
+	QFuture<bool> future = QtConcurrent::mapped(threadPool, groups, [&filePath, &blocks, write, direct, groupsCount](int group)
+		{
+			QFile file(filePath);
+#ifdef Q_OS_LINUX
+			// Qt can't open files with O_DIRECT, so the descriptor is opened here and handed over.
+			if (direct)
+			{
+				const int fd = ::open(QFile::encodeName(filePath).constData(), O_RDONLY | O_DIRECT | O_CLOEXEC);
+				if (fd < 0 || !file.open(fd, QIODevice::ReadOnly | QIODevice::Unbuffered, QFileDevice::AutoCloseHandle))
+				{
+					if (fd >= 0)
+					{
+						::close(fd);
+					}
+					return false;
+				}
+			}
+			else
+#endif
+			if (!file.open(write ? QIODevice::ReadWrite : QIODevice::ReadOnly))
+			{
+				return false;
+			}
+
+			for (qsizetype i = blocks.size() * group / groupsCount; i < blocks.size() * (group + 1) / groupsCount; i++)
+			{
+				const Block& block = blocks[i];
+				if (!file.seek(block.offset) || (write ? file.write(block.data, block.size) : file.read(block.data, block.size)) != block.size)
+				{
+					return false;
+				}
+			}
+			return true;
+		});
+	future.waitForFinished();
+
+	return !future.results().contains(false);
+}
+
+#ifdef FLATFIELD_IO_URING
+bool AsyncFileIO::transferUring(const QString& filePath, const QList<Block>& blocks, bool write, bool direct, bool* success)
+{
+	if (!uringRing.isValid)
+	{
+		return false;
+	}
+	io_uring& ring = uringRing.ring;
+
+	*success = false;
+	const int fd = ::open(QFile::encodeName(filePath).constData(), (write ? O_RDWR : O_RDONLY) | (direct ? O_DIRECT : 0) | O_CLOEXEC);
+	if (fd < 0)
+	{
+		return true;
+	}
+
+	// Blocks larger than their share of the queue are split into concurrent requests. Sizes stay aligned for O_DIRECT.
+	const int queueDepth = getQueueDepth();
+	const qint64 splitSize = qBound(minSplitRequestSize, (getSize(blocks) + queueDepth - 1) / queueDepth, maxRequestSize) / directAlignment * directAlignment;
+	QList<Request> requests;
+	for (int i = 0; i < blocks.size(); i++)
+	{
+		for (qint64 start = 0; start < blocks[i].size; start += splitSize)
+		{
+			requests.append({ blocks[i].data + start, blocks[i].offset + start, qMin(splitSize, blocks[i].size - start), 0 });
+		}
+	}
+
+	// Ring has room for the maximal queue depth, a missing entry means the ring is broken.
+	auto prepare = [&](int index)
+		{
+			io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+			if (sqe == nullptr)
+			{
+				return false;
+			}
+
+			const Request& request = requests[index];
+			char* data = request.data + request.transferred;
+			const unsigned size = static_cast<unsigned>(request.size - request.transferred);
+			const qint64 offset = request.offset + request.transferred;
+			write ? io_uring_prep_write(sqe, fd, data, size, offset) : io_uring_prep_read(sqe, fd, data, size, offset);
+			sqe->user_data = static_cast<quint64>(index);
+			return true;
+		};
+
+	const int depth = qMin(queueDepth, static_cast<int>(requests.size()));
+	int next = 0;
+	int inFlight = 0;
+	bool failed = false;
+	while (!failed)
+	{
+		for (; next < requests.size() && inFlight < depth && !failed; next++)
+		{
+			failed = !prepare(next);
+			inFlight += failed ? 0 : 1;
+		}
+
+		if (inFlight == 0 || failed)
+		{
+			break;
+		}
+
+		const int result = io_uring_submit_and_wait(&ring, 1);
+		if (result < 0 && result != -EINTR)
+		{
+			failed = true;
+			break;
+		}
+
+		io_uring_cqe* cqe;
+		while (io_uring_peek_cqe(&ring, &cqe) == 0)
+		{
+			const int index = static_cast<int>(cqe->user_data);
+			const int res = cqe->res;
+			io_uring_cqe_seen(&ring, cqe);
+			inFlight--;
+
+			// Interrupted and partial requests are resubmitted for the rest of the request, end of file is an error.
+			if (res == -EINTR || res == -EAGAIN || (res > 0 && requests[index].transferred + res < requests[index].size))
+			{
+				requests[index].transferred += qMax(res, 0);
+				if (prepare(index))
+				{
+					inFlight++;
+				}
+				else
+				{
+					failed = true;
+				}
+			}
+			else if (res <= 0)
+			{
+				failed = true;
+			}
+			else
+			{
+				requests[index].transferred += res;
+			}
+		}
+	}
+
+	// Requests still in flight use the buffers, so they are drained before returning.
+	while (inFlight > 0)
+	{
+		io_uring_cqe* cqe;
+		io_uring_submit(&ring);
+		const int result = io_uring_wait_cqe(&ring, &cqe);
+		if (result == 0)
+		{
+			io_uring_cqe_seen(&ring, cqe);
+			inFlight--;
+		}
+		else if (result != -EINTR)
+		{
+			// Ring can't be waited on anymore. Closing it cancels the remaining requests, the next transfer of the thread uses the pool.
+			io_uring_queue_exit(&ring);
+			uringRing.isValid = false;
+			break;
+		}
+	}
+
+	::close(fd);
+
+	*success = !failed;
+	return true;
+}
+#endif
@@ -0,0 +1,77 @@
+#pragma once
+#include <QAtomicInt>
+#include <QList>
+#include <QString>
+
+// Positioned reads and writes of many blocks of one file submitted at once, so the device sees a deep queue instead of one blocking request.
+// Linux builds with liburing (FLATFIELD_IO_URING) use one io_uring per thread, other builds spread blocks over a dedicated thread pool.
+class AsyncFileIO
+{
+public:
+	struct Block
+	{
+		qint64 offset;
+		qint64 size;
+		char* data;
+	};
+
+	// How files which are used once in a batch are kept out of the page cache, so they don't evict reference files.
+	enum CachePolicyEnum
+	{
+		Buffered,
+		// Streamed files are dropped from the page cache after use, reference files are read ahead.
+		Streaming,
+		// As Streaming, and streamed raw data is read with O_DIRECT.
+		Direct
+	};
+
+	static constexpr int defaultQueueDepth = 32;
+	static constexpr int maxQueueDepth = 256;
+
+private:
+	// Part of a block transferred by one request.
+	struct Request
+	{
+		char* data;
+		qint64 offset;
+		qint64 size;
+		qint64 transferred;
+	};
+
+	// O_DIRECT transfers must be aligned to the logical block size, 4096 covers all common devices.
+	static constexpr qint64 directAlignment = 4096;
+
+	static QAtomicInt queueDepth;
+	static QAtomicInt cachePolicy;
+
+	static bool transfer(const QString& filePath, const QList<Block>& blocks, bool write, bool direct);
+	static void adviseWillNeed(const QString& filePath, qint64 offset, qint64 size);
+	static qint64 getSize(const QList<Block>& blocks);
+	static bool transferThreaded(const QString& filePath, const QList<Block>& blocks, bool write, bool direct);
+#ifdef FLATFIELD_IO_URING
+	// Returns false only if io_uring is not available, the result of the transfer itself is stored in success.
+	static bool transferUring(const QString& filePath, const QList<Block>& blocks, bool write, bool direct, bool* success);
+#endif
+#ifdef Q_OS_LINUX
+	static bool readDirect(const QString& filePath, const QList<Block>& blocks);
+#endif
+
+public:
+	// Maximal number of requests in flight for one transfer.
+	static void setQueueDepth(int depth);
+	static int getQueueDepth();
+	static void setCachePolicy(CachePolicyEnum policy);
+	static CachePolicyEnum getCachePolicy();
+
+	// Streamed reads bypass the page cache with the Direct policy.
+	static bool read(const QString& filePath, const QList<Block>& blocks, bool streamed = false);
+	static bool write(const QString& filePath, const QList<Block>& blocks);
+
+	// Page cache hints, they do nothing on platforms without posix_fadvise.
+	// Read ahead is skipped with the Direct policy, direct reads don't use the page cache.
+	static void readAhead(const QString& filePath, qint64 offset, qint64 size);
+	// Keeping and releasing do nothing with the Buffered policy.
+	static void keepCached(const QString& filePath, qint64 offset, qint64 size);
+	// Written files are flushed first, dirty pages can't be dropped.
+	static void releaseCached(const QString& filePath, bool written);
+};
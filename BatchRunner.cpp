@@ -0,0 +1,350 @@
+#include <cstdio>
+#include <utility>
+#include <QDirIterator>
+#include <QJsonDocument>
+#include <QtConcurrent/QtConcurrentRun>
+#include "BatchRunner.h"
+#include "FileUtils.h"
+#include "MemoryProfiler.h"
+#include "MetadataReader.h"
+#include "Tracer.h"
+
+BatchRunner::BatchRunner(const Settings& settings, bool writeToStdout) : settings(settings), writeToStdout(writeToStdout)
+{
+	connect(&processor, &Processor::signalItemProcessed, this, &BatchRunner::slotItemProcessed);
+	connect(&processor, &Processor::signalItemUpToDate, this, &BatchRunner::slotItemUpToDate);
+	connect(&processor, &Processor::signalProcessingFinished, this, &BatchRunner::slotProcessingFinished);
+	connect(&processor, &Processor::signalFirstPassFinished, this, &BatchRunner::slotFirstPassFinished);
+	connect(&scanWatcher, &QFutureWatcher<ScanResult>::finished, this, &BatchRunner::slotScanFinished);
+}
+
+BatchRunner::~BatchRunner()
+{
+	// The scan uses the settings and references of the runner.
+	scanWatcher.waitForFinished();
+}
+
+bool BatchRunner::loadReferences(bool rebuild)
+{
+	return setReferences(loadReferenceFiles(settings.referenceMatcherOptions.referenceFilesRoot, rebuild));
+}
+
+bool BatchRunner::setReferences(const QSharedPointer<ReferenceFiles>& referenceFiles)
+{
+	this->referenceFiles = referenceFiles;
+	return referenceFiles->getCount() > 0;
+}
+
+QSharedPointer<ReferenceFiles> BatchRunner::loadReferenceFiles(const QString& referenceFilesRoot, bool rebuild)
+{
+	const QSharedPointer<ReferenceFiles> referenceFiles(new ReferenceFiles());
+	if (!rebuild)
+	{
+		referenceFiles->load(referenceFilesRoot);
+	}
+
+	if (rebuild || referenceFiles->getCount() == 0)
+	{
+		referenceFiles->createDB(referenceFilesRoot);
+	}
+
+	return referenceFiles;
+}
+
+bool BatchRunner::setShardPass(GlobalProcessingOptions::BatchPassEnum batchPass, const QString& statisticsFilePath)
+{
+	this->batchPass = batchPass;
+	this->statisticsFilePath = statisticsFilePath;
+	if (batchPass != GlobalProcessingOptions::BatchPassEnum::SecondPass)
+	{
+		return true;
+	}
+
+	// Scale calculated with other options would not give the same files as a single run.
+	return statistics.read(statisticsFilePath) &&
+		(statistics.filesCount == 0 || statistics.options == BatchStatistics::getOptions(settings.defaultFileProcessingOptions, settings.globalProcessingOptions));
+}
+
+void BatchRunner::setMemoryReport(const QString& filePath)
+{
+	memoryReportFilePath = filePath;
+}
+
+void BatchRunner::setTrace(const QString& filePath, int interval)
+{
+	traceFilePath = filePath;
+	traceInterval = qMax(1, interval);
+}
+
+bool BatchRunner::startWorkers(const QJsonObject& job, int workersCount)
+{
+	// Pool may report from inside of process(), e.g. when all files are up to date, so results are queued as they are from the processor thread.
+	workerPool = new WorkerPool(job, workersCount, this);
+	connect(workerPool, &WorkerPool::signalItemProcessed, this, &BatchRunner::slotItemProcessed, Qt::QueuedConnection);
+	connect(workerPool, &WorkerPool::signalItemUpToDate, this, &BatchRunner::slotItemUpToDate, Qt::QueuedConnection);
+	connect(workerPool, &WorkerPool::signalProcessingFinished, this, &BatchRunner::slotProcessingFinished, Qt::QueuedConnection);
+	connect(workerPool, &WorkerPool::signalFirstPassFinished, this, &BatchRunner::slotFirstPassFinished, Qt::QueuedConnection);
+
+	return workerPool->start();
+}
+
+QStringList BatchRunner::findSourceFiles(const QString& sourceFilesRoot, bool recurseSubfolders)
+{
+	QStringList files;
+
+	QDirIterator iterator(sourceFilesRoot, { "*.dng" }, QDir::Files, recurseSubfolders ? QDirIterator::Subdirectories : QDirIterator::NoIteratorFlags);
+	while (iterator.hasNext())
+	{
+		files.append(iterator.next());
+	}
+
+	return files;
+}
+
+void BatchRunner::start(const QStringList& files)
+{
+	startScan(files, false);
+}
+
+void BatchRunner::start()
+{
+	startScan({}, true);
+}
+
+void BatchRunner::startScan(const QStringList& files, bool findFiles)
+{
+	timer.start();
+	items.clear();
+	isProcessing = true;
+	MemoryProfiler::reset();
+
+	// Sampled batches are traced from the scan on, the others run without spans.
+	isTraced = !traceFilePath.isEmpty() && batchesCount++ % traceInterval == 0;
+	Tracer::clear();
+	Tracer::setEnabled(isTraced);
+
+	// Reading metadata of a large folder takes seconds, the event loop keeps serving clients and watched folders meanwhile.
+	scanWatcher.setFuture(QtConcurrent::run([this, files, findFiles]() { return scan(files, findFiles); }));
+}
+
+BatchRunner::ScanResult BatchRunner::scan(const QStringList& files, bool findFiles) const
+{
+	ScanResult result;
+	const QStringList sourceFiles = findFiles ? findSourceFiles(settings.sourceFilesRoot, settings.sourceFilesRecurseSubfolders) : files;
+	for (int i = 0; i < sourceFiles.size(); i++)
+	{
+		const QString& filePath = sourceFiles[i];
+
+		// Results of previous runs are not sources.
+		if (isOutputFile(filePath))
+		{
+			continue;
+		}
+
+		result.filesCount++;
+		const QSharedPointer<Metadata> metadata = MetadataReader::readMetadata(filePath);
+		if (metadata == nullptr)
+		{
+			result.skippedFiles.append({ filePath, "unsupported" });
+			continue;
+		}
+
+		// Files with several matching references need a manual choice, as in the UI.
+		const QList<QSharedPointer<FileInfo>> matchingReferenceFiles = referenceFiles->findMatchingReferenceFiles(metadata, settings.referenceMatcherOptions);
+		if (matchingReferenceFiles.size() != 1)
+		{
+			result.skippedFiles.append({ filePath, matchingReferenceFiles.isEmpty() ? "noReference" : "ambiguousReference" });
+			continue;
+		}
+
+		result.items.append(ProcessingItem(QSharedPointer<FileInfo>(new FileInfo(filePath, metadata)), matchingReferenceFiles[0], settings.defaultFileProcessingOptions));
+	}
+
+	return result;
+}
+
+void BatchRunner::slotScanFinished()
+{
+	const ScanResult result = scanWatcher.result();
+	filesCount += result.filesCount;
+	for (const QPair<QString, QString>& skippedFile : result.skippedFiles)
+	{
+		writeSkipped(skippedFile.first, skippedFile.second);
+	}
+
+	// Stopped during the scan, the empty batch only reports the summary.
+	if (!isStopped)
+	{
+		items = result.items;
+	}
+
+	scanTime = timer.restart();
+	ProcessingParcel parcel(items, settings.sourceFilesRoot, settings.globalProcessingOptions, settings.savingOptions);
+	parcel.globalProcessingOptions.batchPass = batchPass;
+	parcel.globalProcessingOptions.mergedCommonScaleForBatch = statistics.commonScaleForBatch;
+	if (workerPool != nullptr)
+	{
+		workerPool->process(parcel);
+	}
+	else
+	{
+		processor.process(parcel);
+	}
+}
+
+void BatchRunner::slotItemProcessed(int index, bool isProcessed, qint64 elapsed)
+{
+	isProcessed ? processedCount++ : failedCount++;
+
+	QJsonObject result;
+	result["file"] = items[index].sourceFile->filePath;
+	result["reference"] = items[index].referenceFile->filePath;
+	result["status"] = isProcessed ? "processed" : "failed";
+	result["elapsedMs"] = elapsed;
+	writeResult(result);
+}
+
+void BatchRunner::slotItemUpToDate(int index)
+{
+	upToDateCount++;
+
+	QJsonObject result;
+	result["file"] = items[index].sourceFile->filePath;
+	result["reference"] = items[index].referenceFile->filePath;
+	result["status"] = "upToDate";
+	writeResult(result);
+}
+
+bool BatchRunner::watch(int settleTime)
+{
+	folderWatcher = new FolderWatcher(settings.sourceFilesRecurseSubfolders, settleTime, this);
+	connect(folderWatcher, &FolderWatcher::signalFileReady, this, &BatchRunner::slotFileReady);
+
+	return folderWatcher->watch(settings.sourceFilesRoot);
+}
+
+void BatchRunner::stop()
+{
+	isStopped = true;
+	pendingFiles.clear();
+	if (workerPool != nullptr)
+	{
+		workerPool->stop();
+	}
+	else
+	{
+		processor.stopProcessing();
+	}
+}
+
+void BatchRunner::slotFileReady(const QString& filePath)
+{
+	if (isOutputFile(filePath) || pendingFiles.contains(filePath))
+	{
+		return;
+	}
+
+	pendingFiles.append(filePath);
+	if (!isProcessing)
+	{
+		start(std::exchange(pendingFiles, {}));
+	}
+}
+
+void BatchRunner::slotFirstPassFinished(float commonScaleForBatch, int processedCount)
+{
+	if (batchPass != GlobalProcessingOptions::BatchPassEnum::FirstPass)
+	{
+		return;
+	}
+
+	// Items of the first pass are not reported one by one, the ones which could not be read are left out of the statistics.
+	failedCount += items.size() - processedCount;
+
+	statistics.commonScaleForBatch = commonScaleForBatch;
+	statistics.filesCount = processedCount;
+	statistics.options = BatchStatistics::getOptions(settings.defaultFileProcessingOptions, settings.globalProcessingOptions);
+	isStatisticsWritten = statistics.write(statisticsFilePath);
+}
+
+void BatchRunner::slotProcessingFinished()
+{
+	isProcessing = false;
+	const bool isMemoryReportWritten = !memoryReportFilePath.isEmpty() && MemoryProfiler::writeReport(memoryReportFilePath);
+	const bool isTraceWritten = isTraced && Tracer::writeTrace(traceFilePath);
+	Tracer::setEnabled(false);
+	if (folderWatcher != nullptr)
+	{
+		if (!pendingFiles.isEmpty())
+		{
+			start(std::exchange(pendingFiles, {}));
+		}
+		return;
+	}
+
+	QJsonObject summary;
+	summary["files"] = filesCount;
+	summary["processed"] = processedCount;
+	summary["failed"] = failedCount;
+	summary["skipped"] = skippedCount;
+	summary["upToDate"] = upToDateCount;
+	summary["stopped"] = isStopped;
+	if (batchPass == GlobalProcessingOptions::BatchPassEnum::FirstPass)
+	{
+		summary["commonScaleForBatch"] = statistics.commonScaleForBatch;
+		summary["statisticsWritten"] = isStatisticsWritten;
+	}
+	if (!memoryReportFilePath.isEmpty())
+	{
+		summary["memoryReportWritten"] = isMemoryReportWritten;
+	}
+	if (isTraced)
+	{
+		summary["traceWritten"] = isTraceWritten;
+	}
+	summary["scanMs"] = scanTime;
+	summary["processingMs"] = timer.elapsed();
+
+	QJsonObject result;
+	result["summary"] = summary;
+	writeResult(result);
+
+	const bool isStatisticsMissing = batchPass == GlobalProcessingOptions::BatchPassEnum::FirstPass && !isStatisticsWritten;
+	emit signalFinished(failedCount + skippedCount > 0 || isStatisticsMissing ? 2 : 0);
+}
+
+void BatchRunner::writeSkipped(const QString& filePath, const QString& reason)
+{
+	skippedCount++;
+
+	QJsonObject result;
+	result["file"] = filePath;
+	result["status"] = "skipped";
+	result["reason"] = reason;
+	writeResult(result);
+}
+
+bool BatchRunner::isOutputFile(const QString& filePath) const
+{
+	// Output folder inside of the source folder would be watched too.
+	if (settings.savingOptions.saveTo == SavingOptions::Folder)
+	{
+		return !settings.savingOptions.saveToFolderPath.isEmpty() && QDir::cleanPath(filePath).startsWith(QDir::cleanPath(settings.savingOptions.saveToFolderPath) + "/");
+	}
+
+	return FileUtils::isFileFromOutputSubfolder(filePath, settings.savingOptions);
+}
+
+void BatchRunner::writeResult(const QJsonObject& result)
+{
+	emit signalResult(result);
+	if (!writeToStdout)
+	{
+		return;
+	}
+
+	// One compact object per line, flushed right away so the output can be consumed while the batch is running.
+	const QByteArray line = QJsonDocument(result).toJson(QJsonDocument::Compact) + '\n';
+	std::fwrite(line.constData(), 1, static_cast<size_t>(line.size()), stdout);
+	std::fflush(stdout);
+}
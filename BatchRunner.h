@@ -0,0 +1,107 @@
+#pragma once
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QJsonObject>
+#include <QObject>
+#include <QPair>
+
+#include "BatchStatistics.h"
+#include "FolderWatcher.h"
+#include "Processor.h"
+#include "ReferenceFiles.h"
+#include "Settings.h"
+#include "WorkerPool.h"
+
+// Processing without UI: source files are matched to references with the same rules as in the UI, files with exactly one matching
+// reference are processed, and the result of every file is written to stdout as one JSON line and emitted with signalResult.
+class BatchRunner : public QObject
+{
+	Q_OBJECT
+
+		const Settings& settings;
+
+	// Files read and matched to references outside of the event loop.
+	struct ScanResult
+	{
+		int filesCount = 0;
+		QList<ProcessingItem> items;
+		// File paths with the reason they are skipped.
+		QList<QPair<QString, QString>> skippedFiles;
+	};
+
+	QSharedPointer<ReferenceFiles> referenceFiles;
+	Processor processor;
+	QList<ProcessingItem> items;
+	QFutureWatcher<ScanResult> scanWatcher;
+	QElapsedTimer timer;
+	FolderWatcher* folderWatcher = nullptr;
+	WorkerPool* workerPool = nullptr;
+	GlobalProcessingOptions::BatchPassEnum batchPass = GlobalProcessingOptions::BatchPassEnum::BothPasses;
+	QString statisticsFilePath;
+	BatchStatistics statistics;
+	bool isStatisticsWritten = false;
+	QString memoryReportFilePath;
+	QString traceFilePath;
+	int traceInterval = 1;
+	int batchesCount = 0;
+	bool isTraced = false;
+	bool writeToStdout = true;
+	bool isStopped = false;
+	QStringList pendingFiles;
+	bool isProcessing = false;
+	qint64 scanTime = 0;
+	int filesCount = 0;
+	int processedCount = 0;
+	int failedCount = 0;
+	int skippedCount = 0;
+	int upToDateCount = 0;
+
+	void writeResult(const QJsonObject& result);
+	void writeSkipped(const QString& filePath, const QString& reason);
+	bool isOutputFile(const QString& filePath) const;
+	ScanResult scan(const QStringList& files, bool findFiles) const;
+	void startScan(const QStringList& files, bool findFiles);
+
+private slots:
+	void slotItemProcessed(int index, bool isProcessed, qint64 elapsed);
+	void slotItemUpToDate(int index);
+	void slotProcessingFinished();
+	void slotFirstPassFinished(float commonScaleForBatch, int processedCount);
+	void slotFileReady(const QString& filePath);
+	void slotScanFinished();
+
+signals:
+	// Exit code of the batch: 0 if all found files were processed, 2 if some of them were skipped or failed.
+	void signalFinished(int exitCode);
+	// Result of a file, or the summary of the batch.
+	void signalResult(const QJsonObject& result);
+
+public:
+	explicit BatchRunner(const Settings& settings, bool writeToStdout = true);
+	~BatchRunner() override;
+
+	// Loads the reference files DB, it is created if it does not exist yet. Returns false if there are no reference files.
+	bool loadReferences(bool rebuild);
+	// Uses the already loaded reference files DB, e.g. one shared by the runs of a server. Returns false if there are no reference files.
+	bool setReferences(const QSharedPointer<ReferenceFiles>& referenceFiles);
+	static QSharedPointer<ReferenceFiles> loadReferenceFiles(const QString& referenceFilesRoot, bool rebuild);
+	static QStringList findSourceFiles(const QString& sourceFilesRoot, bool recurseSubfolders);
+	// Runs one pass of a shard of a batch split across nodes. The first pass writes the statistics of the shard to the file, the second
+	// pass processes the files with the statistics merged from all shards. Returns false if the merged statistics can't be used.
+	bool setShardPass(GlobalProcessingOptions::BatchPassEnum batchPass, const QString& statisticsFilePath);
+	// Writes the memory report of every batch to the file, the memory profiler must be enabled.
+	void setMemoryReport(const QString& filePath);
+	// Writes the trace of every batch whose number is a multiple of the interval to the file, the previous trace is replaced.
+	void setTrace(const QString& filePath, int interval);
+	// Items are processed in worker processes instead of threads of this process.
+	bool startWorkers(const QJsonObject& job, int workersCount);
+	// Reads and matches the files in a pool thread, and starts processing when they are scanned. signalFinished is emitted when it is done.
+	void start(const QStringList& files);
+	// Same as start with the files found in the source folder of the settings, the folder is searched in the pool thread too.
+	void start();
+	// Processes new files of the source folder as soon as they are completely written, files which are ready while a batch is running
+	// go to the next batch. Runs until the process is stopped, signalFinished is never emitted.
+	bool watch(int settleTime);
+	// Stops after the file which is being processed, the summary is reported as usual.
+	void stop();
+};
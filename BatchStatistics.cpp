@@ -0,0 +1,58 @@
+#include <QFile>
+#include <QJsonDocument>
+#include <QSaveFile>
+#include "BatchStatistics.h"
+
+QJsonObject BatchStatistics::getOptions(const ProcessingOptions& processingOptions, const GlobalProcessingOptions& globalProcessingOptions)
+{
+	QJsonObject options;
+	options["luminanceCorrectionIntensity"] = processingOptions.luminanceCorrectionIntensity;
+	options["colorCorrectionIntensity"] = processingOptions.colorCorrectionIntensity;
+	options["gaussianBlurSigma"] = processingOptions.gaussianBlurSigma;
+	options["limitToWhiteLevel"] = globalProcessingOptions.limitToWhiteLevel;
+	return options;
+}
+
+bool BatchStatistics::merge(const BatchStatistics& statistics)
+{
+	// Shards without files don't restrict the options.
+	if (filesCount > 0 && statistics.filesCount > 0 && options != statistics.options)
+	{
+		return false;
+	}
+
+	if (statistics.filesCount > 0)
+	{
+		commonScaleForBatch = qMin(commonScaleForBatch, statistics.commonScaleForBatch);
+		options = statistics.options;
+	}
+	filesCount += statistics.filesCount;
+	return true;
+}
+
+bool BatchStatistics::read(const QString& filePath)
+{
+	QFile file(filePath);
+	const QJsonDocument jsonDocument = file.open(QIODevice::ReadOnly) ? QJsonDocument::fromJson(file.readAll()) : QJsonDocument();
+	const QJsonObject jsonObject = jsonDocument.object();
+	if (!jsonObject.contains("commonScaleForBatch"))
+	{
+		return false;
+	}
+
+	commonScaleForBatch = jsonObject["commonScaleForBatch"].toDouble(1);
+	filesCount = jsonObject["files"].toInt();
+	options = jsonObject["options"].toObject();
+	return true;
+}
+
+bool BatchStatistics::write(const QString& filePath) const
+{
+	QJsonObject jsonObject;
+	jsonObject["commonScaleForBatch"] = commonScaleForBatch;
+	jsonObject["files"] = filesCount;
+	jsonObject["options"] = options;
+
+	QSaveFile file(filePath);
+	return file.open(QIODevice::WriteOnly) && file.write(QJsonDocument(jsonObject).toJson()) >= 0 && file.commit();
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <QJsonObject>
+#include <QString>
+
+#include "DataStructs.h"
+
+// First pass result of a shard of a batch. The common scale of a batch is the minimum of the scales of its images, so statistics of the
+// shards merge into the statistics of the whole batch, and the second pass with the merged scale gives the same files as a single run.
+struct BatchStatistics
+{
+	float commonScaleForBatch = 1;
+	int filesCount = 0;
+	// Options which the scale depends on, shards processed with different options can't be merged.
+	QJsonObject options;
+
+	static QJsonObject getOptions(const ProcessingOptions& processingOptions, const GlobalProcessingOptions& globalProcessingOptions);
+	// Returns false if the options of the statistics differ.
+	bool merge(const BatchStatistics& statistics);
+	bool read(const QString& filePath);
+	bool write(const QString& filePath) const;
+};
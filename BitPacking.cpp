@@ -0,0 +1,149 @@
+#include <numeric>
+#include "BitPacking.h"
+
+qint64 BitPacking::getPackedSize(qint64 samplesCount, int bitsPerSample)
+{
+	return (samplesCount * bitsPerSample + 7) / 8;
+}
+
+void BitPacking::unpack(const char* source, uint16_t* destination, qint64 samplesCount, int bitsPerSample)
+{
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(source);
+	qint64 unpacked = 0;
+	switch (bitsPerSample)
+	{
+		case 10:
+			unpacked = unpackGroups<10>(bytes, destination, samplesCount);
+			break;
+		case 12:
+			unpacked = unpackGroups<12>(bytes, destination, samplesCount);
+			break;
+		case 14:
+			unpacked = unpackGroups<14>(bytes, destination, samplesCount);
+			break;
+	}
+
+	// Groups always end at a byte boundary, so the tail continues from a whole byte.
+	unpackGeneric(bytes + unpacked * bitsPerSample / 8, destination + unpacked, samplesCount - unpacked, bitsPerSample);
+}
+
+void BitPacking::pack(const uint16_t* source, char* destination, qint64 samplesCount, int bitsPerSample)
+{
+	uint8_t* bytes = reinterpret_cast<uint8_t*>(destination);
+	qint64 packed = 0;
+	switch (bitsPerSample)
+	{
+		case 10:
+			packed = packGroups<10>(source, bytes, samplesCount);
+			break;
+		case 12:
+			packed = packGroups<12>(source, bytes, samplesCount);
+			break;
+		case 14:
+			packed = packGroups<14>(source, bytes, samplesCount);
+			break;
+	}
+
+	packGeneric(source + packed, bytes + packed * bitsPerSample / 8, samplesCount - packed, bitsPerSample);
+}
+
+// Fixed size groups of samples which fill whole bytes, e.g. 2 samples in 3 bytes for 12 bit. Constant shifts let the compiler unroll and vectorize the loop.
+template<int bitsPerSample>
+qint64 BitPacking::unpackGroups(const uint8_t* source, uint16_t* destination, qint64 samplesCount)
+{
+	constexpr int groupSamples = 8 / std::gcd(bitsPerSample, 8);
+	constexpr int groupBytes = groupSamples * bitsPerSample / 8;
+	constexpr uint64_t mask = (1 << bitsPerSample) - 1;
+
+	const qint64 groupsCount = samplesCount / groupSamples;
+	for (qint64 group = 0; group < groupsCount; group++)
+	{
+		const uint8_t* groupSource = source + group * groupBytes;
+		uint16_t* groupDestination = destination + group * groupSamples;
+
+		uint64_t value = 0;
+		for (int i = 0; i < groupBytes; i++)
+		{
+			value = value << 8 | groupSource[i];
+		}
+
+		for (int i = 0; i < groupSamples; i++)
+		{
+			groupDestination[i] = static_cast<uint16_t>(value >> (groupBytes * 8 - bitsPerSample * (i + 1)) & mask);
+		}
+	}
+
+	return groupsCount * groupSamples;
+}
+
+template<int bitsPerSample>
+qint64 BitPacking::packGroups(const uint16_t* source, uint8_t* destination, qint64 samplesCount)
+{
+	constexpr int groupSamples = 8 / std::gcd(bitsPerSample, 8);
+	constexpr int groupBytes = groupSamples * bitsPerSample / 8;
+	constexpr uint16_t maxValue = (1 << bitsPerSample) - 1;
+
+	const qint64 groupsCount = samplesCount / groupSamples;
+	for (qint64 group = 0; group < groupsCount; group++)
+	{
+		const uint16_t* groupSource = source + group * groupSamples;
+		uint8_t* groupDestination = destination + group * groupBytes;
+
+		uint64_t value = 0;
+		for (int i = 0; i < groupSamples; i++)
+		{
+			value = value << bitsPerSample | qMin(groupSource[i], maxValue);
+		}
+
+		for (int i = 0; i < groupBytes; i++)
+		{
+			groupDestination[i] = static_cast<uint8_t>(value >> (8 * (groupBytes - 1 - i)));
+		}
+	}
+
+	return groupsCount * groupSamples;
+}
+
+void BitPacking::unpackGeneric(const uint8_t* source, uint16_t* destination, qint64 samplesCount, int bitsPerSample)
+{
+	const uint32_t mask = (1u << bitsPerSample) - 1;
+	uint32_t buffer = 0;
+	int bufferBits = 0;
+
+	for (qint64 i = 0; i < samplesCount; i++)
+	{
+		while (bufferBits < bitsPerSample)
+		{
+			buffer = buffer << 8 | *source++;
+			bufferBits += 8;
+		}
+
+		bufferBits -= bitsPerSample;
+		destination[i] = static_cast<uint16_t>(buffer >> bufferBits & mask);
+	}
+}
+
+void BitPacking::packGeneric(const uint16_t* source, uint8_t* destination, qint64 samplesCount, int bitsPerSample)
+{
+	const uint32_t maxValue = (1u << bitsPerSample) - 1;
+	uint32_t buffer = 0;
+	int bufferBits = 0;
+
+	for (qint64 i = 0; i < samplesCount; i++)
+	{
+		buffer = buffer << bitsPerSample | qMin<uint32_t>(source[i], maxValue);
+		bufferBits += bitsPerSample;
+
+		while (bufferBits >= 8)
+		{
+			bufferBits -= 8;
+			*destination++ = static_cast<uint8_t>(buffer >> bufferBits);
+		}
+	}
+
+	// Last byte of the row is padded with zero bits.
+	if (bufferBits > 0)
+	{
+		*destination = static_cast<uint8_t>(buffer << (8 - bufferBits));
+	}
+}
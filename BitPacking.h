@@ -0,0 +1,19 @@
+#pragma once
+#include <QtGlobal>
+
+// TIFF bit packing: samples are stored MSB first without gaps, every row starts at a byte boundary.
+class BitPacking
+{
+	template<int bitsPerSample>
+	static qint64 unpackGroups(const uint8_t* source, uint16_t* destination, qint64 samplesCount);
+	template<int bitsPerSample>
+	static qint64 packGroups(const uint16_t* source, uint8_t* destination, qint64 samplesCount);
+	static void unpackGeneric(const uint8_t* source, uint16_t* destination, qint64 samplesCount, int bitsPerSample);
+	static void packGeneric(const uint16_t* source, uint8_t* destination, qint64 samplesCount, int bitsPerSample);
+
+public:
+	static qint64 getPackedSize(qint64 samplesCount, int bitsPerSample);
+	static void unpack(const char* source, uint16_t* destination, qint64 samplesCount, int bitsPerSample);
+	// Values above the sample range are clamped, processed data may exceed the white level.
+	static void pack(const uint16_t* source, char* destination, qint64 samplesCount, int bitsPerSample);
+};
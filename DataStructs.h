@@ -19,6 +19,24 @@ struct Metadata
 		Blue
 	};
 
+	enum CompressionEnum
+	{
+		Uncompressed = 1,
+		LosslessJPEG = 7
+	};
+
+	enum SampleFormatEnum
+	{
+		UnsignedInteger = 1,
+		FloatingPoint = 3
+	};
+
+	struct FrameLayout
+	{
+		QList<qint64> dataOffsets;
+		QList<qint64> dataByteCounts;
+	};
+
 	QString cameraMaker = "";
 	QString cameraModel = "";
 	QString lens = "";
@@ -33,12 +51,92 @@ struct Metadata
 	QList<CFAPatternEnum> cfaColorPattern;
 	int dataOffset = 0;
 	int dataSize = 0;
+	CompressionEnum compression = CompressionEnum::Uncompressed;
+	// Uncompressed samples with less than 16 bits are bit packed in the file.
+	int bitsPerSample = 16;
+	// Byte order of 16 bit samples, taken from the TIFF header.
+	bool bigEndian = false;
+	// Floating point samples are 16, 24 or 32 bit, and are processed as float without conversion to integers.
+	SampleFormatEnum sampleFormat = SampleFormatEnum::UnsignedInteger;
+	// Raw data is described as a grid of tiles. Strips are stored as tiles with full image width and RowsPerStrip height.
+	int tileWidth = 0;
+	int tileHeight = 0;
+	// Set from StripOffsets when the file is parsed, a single column of tiles has the image width too but is not a strip layout.
+	bool stripLayout = false;
+	QList<qint64> dataOffsets;
+	QList<qint64> dataByteCounts;
+	// Multi frame (pixel shift) files have further raw IFDs with the same layout, the first frame is described above.
+	QList<FrameLayout> additionalFrames;
 
 	int getChannelsCount() const
 	{
 		return rawType;
 	}
 
+	int getSamplesPerPixel() const
+	{
+		return rawType == RGB ? 3 : 1;
+	}
+
+	int getTilesAcross() const
+	{
+		return (imageWidth + tileWidth - 1) / tileWidth;
+	}
+
+	int getTilesDown() const
+	{
+		return (imageHeight + tileHeight - 1) / tileHeight;
+	}
+
+	bool isStripLayout() const
+	{
+		return stripLayout;
+	}
+
+	int getFramesCount() const
+	{
+		return additionalFrames.size() + 1;
+	}
+
+	// Metadata of a single frame, so frames can be read and written as separate images.
+	QSharedPointer<Metadata> getFrame(int frame) const
+	{
+		QSharedPointer<Metadata> frameMetadata = QSharedPointer<Metadata>(new Metadata(*this));
+		frameMetadata->additionalFrames.clear();
+		if (frame > 0)
+		{
+			frameMetadata->dataOffsets = additionalFrames[frame - 1].dataOffsets;
+			frameMetadata->dataByteCounts = additionalFrames[frame - 1].dataByteCounts;
+			frameMetadata->dataOffset = static_cast<int>(frameMetadata->dataOffsets[0]);
+		}
+		return frameMetadata;
+	}
+
+	bool isFloatingPoint() const
+	{
+		return sampleFormat == SampleFormatEnum::FloatingPoint;
+	}
+
+	bool isBitPacked() const
+	{
+		return compression == CompressionEnum::Uncompressed && !isFloatingPoint() && bitsPerSample != 16;
+	}
+
+	// Largest integer sample the raw data can hold, packed samples have less than 16 bits.
+	uint16_t getMaxValue() const
+	{
+		return static_cast<uint16_t>((1 << bitsPerSample) - 1);
+	}
+
+	bool isSampleFormatSupported() const
+	{
+		if (isFloatingPoint())
+		{
+			return compression == CompressionEnum::Uncompressed && (bitsPerSample == 16 || bitsPerSample == 24 || bitsPerSample == 32);
+		}
+		return bitsPerSample >= 8 && bitsPerSample <= 16;
+	}
+
 	bool isValid() const
 	{
 		return !cameraMaker.isEmpty() &&
@@ -48,7 +146,13 @@ struct Metadata
 			imageWidth != 0 &&
 			!activeArea.isEmpty() &&
 			dataOffset != 0 &&
-			dataSize != 0;
+			dataSize != 0 &&
+			isSampleFormatSupported() &&
+			tileWidth > 0 &&
+			tileHeight > 0 &&
+			!dataOffsets.isEmpty() &&
+			dataOffsets.size() == dataByteCounts.size() &&
+			dataOffsets.size() == getTilesAcross() * getTilesDown();
 	}
 
 	static bool isCompatible(const QSharedPointer<Metadata>& firstMetadata, const QSharedPointer<Metadata>& secondMetadata)
@@ -56,6 +160,7 @@ struct Metadata
 		return firstMetadata->cameraMaker == secondMetadata->cameraMaker &&
 			firstMetadata->cameraModel == secondMetadata->cameraModel &&
 			firstMetadata->rawType == secondMetadata->rawType &&
+			firstMetadata->sampleFormat == secondMetadata->sampleFormat &&
 			firstMetadata->imageHeight == secondMetadata->imageHeight &&
 			firstMetadata->imageWidth == secondMetadata->imageWidth &&
 			firstMetadata->activeArea[2] - firstMetadata->activeArea[0] == secondMetadata->activeArea[2] - secondMetadata->activeArea[0] &&
@@ -93,9 +198,20 @@ struct FileInfo
 
 struct GlobalProcessingOptions
 {
+	enum BatchPassEnum
+	{
+		BothPasses,
+		// Shard of a batch split across nodes, only the common scale of the shard is calculated and nothing is saved.
+		FirstPass,
+		// Shard of a batch split across nodes, processed with the common scale merged from the first passes of all shards.
+		SecondPass
+	};
+
 	bool limitToWhiteLevel = false;
 	bool scaleChannelsToAvoidClipping = false;
 	bool calculateCommonScaleForBatch = false;
+	BatchPassEnum batchPass = BatchPassEnum::BothPasses;
+	float mergedCommonScaleForBatch = 1;
 };
 
 struct ProcessingOptions
@@ -118,9 +234,33 @@ struct SavingOptions
 		Subfolder
 	};
 
+	enum OutputFormatEnum
+	{
+		SameAsSource,
+		LosslessJPEG,
+		GainMap
+	};
+
+	enum OutputSyncEnum
+	{
+		// Written data is left to the OS.
+		NoSync,
+		// Writeback is started, but not waited for.
+		AsyncSync,
+		// Data is on the device before the next file is processed.
+		FullSync
+	};
+
 	SaveToEnum saveTo = SaveToEnum::Subfolder;
 	QString saveToFolderPath;
 	QString saveToSubfolderFolderName = "out";
+	OutputFormatEnum outputFormat = OutputFormatEnum::SameAsSource;
+	// Corrected samples are assembled straight into the memory mapped output file when its raw data is stored as the image buffer.
+	bool mapOutputFile = false;
+	// Durability of the mapped output, msync or FlushViewOfFile is used when the mapping is released.
+	OutputSyncEnum outputSync = OutputSyncEnum::NoSync;
+	// Items recorded in the manifest of the output root with the same source, reference, options and output are not processed again.
+	bool skipUpToDate = true;
 };
 
 struct ProcessingItem
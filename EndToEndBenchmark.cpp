@@ -0,0 +1,299 @@
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QtEndian>
+#include "EndToEndBenchmark.h"
+#include "KernelBenchmark.h"
+#include "MetadataReader.h"
+#include "Metrics.h"
+#include "Processor.h"
+#include "ReferenceFiles.h"
+#include "Settings.h"
+#include "TiffFile.h"
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+bool EndToEndBenchmark::writeFile(const QString& filePath, int width, int height, bool isReference, int seed)
+{
+	QFile file(filePath);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+	{
+		return false;
+	}
+
+	// Raw data follows the header, IFD0 follows the data, so its offset is known before anything is written.
+	const qint64 dataOffset = 8;
+	const qint64 dataSize = static_cast<qint64>(width) * height * sizeof(uint16_t);
+	char header[8] = { 'I', 'I', 42, 0 };
+	qToLittleEndian<quint32>(static_cast<quint32>(dataOffset + dataSize), header + 4);
+	if (file.write(header, sizeof(header)) != sizeof(header))
+	{
+		return false;
+	}
+
+	// Channel gains of the RGGB pattern tint the vignette, a small pattern noise keeps the blur from working on flat values.
+	const float gains[4] = { 0.75f, 1, 1, 0.6f };
+	const float range = whiteLevel - blackLevel;
+	const float centerX = width / 2.0f;
+	const float centerY = height / 2.0f;
+	const float maxRadius2 = centerX * centerX + centerY * centerY;
+	QList<uint16_t> row(width);
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			const float dx = x - centerX;
+			const float dy = y - centerY;
+			const float vignette = 1 - 0.5f * (dx * dx + dy * dy) / maxRadius2;
+			const float scene = isReference ? 0.8f : 0.2f + 0.7f * ((x + seed * 97) % width) / width;
+			const int noise = (x * 7919 + y * 104729 + seed) % 64 - 32;
+			const float value = blackLevel + range * scene * vignette * gains[(y & 1) * 2 + (x & 1)] + noise;
+			row[x] = static_cast<uint16_t>(qBound<float>(blackLevel, value, whiteLevel));
+		}
+		qToLittleEndian<uint16_t>(row.constData(), width, row.data());
+		if (file.write(reinterpret_cast<const char*>(row.constData()), width * sizeof(uint16_t)) != static_cast<qint64>(width * sizeof(uint16_t)))
+		{
+			return false;
+		}
+	}
+
+	const TiffFile tiffFile(&file);
+	const auto toAscii = [](const QByteArray& text)
+	{
+		QList<quint64> values(text.begin(), text.end());
+		values.append(0);
+		return values;
+	};
+
+	// Tags missing in TiffFile::TagEnum are the values of MetadataReader::ExifTagsEnum.
+	TiffFile::Directory directory;
+	directory.entries = {
+		tiffFile.createEntry(0x0100, TiffFile::Long, { static_cast<quint64>(width) }),
+		tiffFile.createEntry(0x0101, TiffFile::Long, { static_cast<quint64>(height) }),
+		tiffFile.createEntry(TiffFile::BitsPerSample, TiffFile::Short, { 16 }),
+		tiffFile.createEntry(TiffFile::Compression, TiffFile::Short, { Metadata::CompressionEnum::Uncompressed }),
+		// Color filter array.
+		tiffFile.createEntry(0x0106, TiffFile::Short, { 32803 }),
+		tiffFile.createEntry(0x010f, TiffFile::Ascii, toAscii("Flatfield")),
+		tiffFile.createEntry(0x0110, TiffFile::Ascii, toAscii("Benchmark")),
+		tiffFile.createEntry(TiffFile::StripOffsets, TiffFile::Long, { static_cast<quint64>(dataOffset) }),
+		tiffFile.createEntry(0x0115, TiffFile::Short, { 1 }),
+		tiffFile.createEntry(TiffFile::RowsPerStrip, TiffFile::Long, { static_cast<quint64>(height) }),
+		tiffFile.createEntry(TiffFile::StripByteCounts, TiffFile::Long, { static_cast<quint64>(dataSize) }),
+		tiffFile.createEntry(0x828e, TiffFile::Byte, { Metadata::Red, Metadata::Green, Metadata::Green, Metadata::Blue }),
+		// Same lens settings for all files, so every source matches the reference.
+		tiffFile.createEntry(0x829d, TiffFile::Short, { 4 }),
+		tiffFile.createEntry(0x920a, TiffFile::Short, { 50 }),
+		tiffFile.createEntry(0xc61a, TiffFile::Short, { blackLevel }),
+		tiffFile.createEntry(0xc61d, TiffFile::Short, { whiteLevel }),
+		tiffFile.createEntry(0xc68d, TiffFile::Long, { 0, 0, static_cast<quint64>(height), static_cast<quint64>(width) })
+	};
+
+	return tiffFile.writeDirectory(dataOffset + dataSize, directory) >= 0;
+}
+
+bool EndToEndBenchmark::createBatch(const QString& workFolder, const Options& options)
+{
+	const QSize frameSize = KernelBenchmark::getFrameSize(options.megapixels);
+	const int width = frameSize.width();
+	const int height = frameSize.height();
+
+	const QDir folder(workFolder);
+	if (!folder.mkpath("references") || !folder.mkpath("sources") || !writeFile(folder.filePath("references/reference.dng"), width, height, true, 0))
+	{
+		return false;
+	}
+
+	for (int i = 0; i < options.filesCount; i++)
+	{
+		if (!writeFile(folder.filePath(QString("sources/source_%1.dng").arg(i)), width, height, false, i + 1))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+QJsonObject EndToEndBenchmark::runMode(const QString& workFolder, bool calculateCommonScaleForBatch)
+{
+	const QString mode = calculateCommonScaleForBatch ? "commonScale" : "single";
+	const QDir folder(workFolder);
+	const QString outputFolderPath = folder.filePath("out-" + mode);
+
+	// Outputs of the previous run are removed, so every file is saved again.
+	QDir(outputFolderPath).removeRecursively();
+	folder.mkpath(outputFolderPath);
+
+	QJsonObject job;
+	job["referenceFilesRoot"] = folder.filePath("references");
+	job["sourceFilesRoot"] = folder.filePath("sources");
+	job["processingScaleChannelsToAvoidClipping"] = true;
+	job["processingCalculateCommonScaleForBatch"] = calculateCommonScaleForBatch;
+	job["saveTo"] = SavingOptions::SaveToEnum::Folder;
+	job["saveProcessedFilesToFolderPath"] = outputFolderPath;
+	job["saveSkipUpToDate"] = false;
+	const Settings settings(job);
+
+	const QJsonObject stagesBefore = Metrics::getSnapshot()["stages"].toObject();
+	QElapsedTimer wallTimer;
+	wallTimer.start();
+	QElapsedTimer timer;
+	timer.start();
+
+	QStringList files = QDir(settings.sourceFilesRoot).entryList({ "*.dng" }, QDir::Files, QDir::Name);
+	QList<QSharedPointer<Metadata>> metadata;
+	for (QString& filePath : files)
+	{
+		filePath = QDir(settings.sourceFilesRoot).filePath(filePath);
+		metadata.append(MetadataReader::readMetadata(filePath));
+	}
+	const qint64 scanTime = timer.restart();
+
+	ReferenceFiles referenceFiles;
+	referenceFiles.createDB(settings.referenceMatcherOptions.referenceFilesRoot);
+	QList<ProcessingItem> items;
+	for (int i = 0; i < files.size(); i++)
+	{
+		const QList<QSharedPointer<FileInfo>> matchingReferenceFiles = metadata[i] != nullptr ? referenceFiles.findMatchingReferenceFiles(metadata[i], settings.referenceMatcherOptions) : QList<QSharedPointer<FileInfo>>();
+		if (matchingReferenceFiles.size() == 1)
+		{
+			items.append(ProcessingItem(QSharedPointer<FileInfo>(new FileInfo(files[i], metadata[i])), matchingReferenceFiles[0], settings.defaultFileProcessingOptions));
+		}
+	}
+	const qint64 matchTime = timer.restart();
+
+	int processedCount = 0;
+	ProcessingCallbacks callbacks;
+	callbacks.itemProcessed = [&processedCount](int, bool isProcessed, qint64) { processedCount += isProcessed ? 1 : 0; };
+	Processor::run(ProcessingParcel(items, settings.sourceFilesRoot, settings.globalProcessingOptions, settings.savingOptions), callbacks);
+	const qint64 processingTime = timer.elapsed();
+	const qint64 wallTime = wallTimer.elapsed();
+
+	// Stage times are summed over the threads which ran them, so with parallel stages they add up to more than the wall time.
+	const QJsonObject stagesAfter = Metrics::getSnapshot()["stages"].toObject();
+	QJsonObject stagesTime;
+	for (const QString& stage : stagesAfter.keys())
+	{
+		stagesTime[stage] = stagesAfter[stage].toObject()["sumMs"].toDouble() - stagesBefore[stage].toObject()["sumMs"].toDouble();
+	}
+
+	QJsonObject result;
+	result["type"] = "endToEnd";
+	result["mode"] = mode;
+	result["files"] = files.size();
+	result["processed"] = processedCount;
+	result["filesPerSecond"] = wallTime > 0 ? processedCount * 1000.0 / wallTime : 0;
+	result["wallMs"] = wallTime;
+	result["scanMs"] = scanTime;
+	result["matchMs"] = matchTime;
+	result["processingMs"] = processingTime;
+	result["stagesMs"] = stagesTime;
+	result["peakResidentBytes"] = getPeakResidentSize();
+	return result;
+}
+
+qint64 EndToEndBenchmark::getPeakResidentSize()
+{
+#ifdef Q_OS_WIN
+	PROCESS_MEMORY_COUNTERS counters;
+	return GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) ? static_cast<qint64>(counters.PeakWorkingSetSize) : 0;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+	{
+		return 0;
+	}
+	// Linux reports kilobytes, macOS bytes.
+#ifdef Q_OS_MACOS
+	return usage.ru_maxrss;
+#else
+	return usage.ru_maxrss * 1024LL;
+#endif
+#endif
+}
+
+QJsonObject EndToEndBenchmark::run(const Options& options, const std::function<void(const QJsonObject&)>& report)
+{
+	QTemporaryDir temporaryFolder;
+	const QString workFolder = options.workFolder.isEmpty() ? temporaryFolder.path() : options.workFolder;
+	if ((options.workFolder.isEmpty() && !temporaryFolder.isValid()) || !createBatch(workFolder, options))
+	{
+		return {};
+	}
+
+	// Peak resident size only grows, so the modes are run from the smaller footprint to the larger one.
+	QJsonObject results;
+	for (const bool calculateCommonScaleForBatch : { false, true })
+	{
+		const QJsonObject result = runMode(workFolder, calculateCommonScaleForBatch);
+		report(result);
+		results[result["mode"].toString()] = result;
+	}
+	return results;
+}
+
+bool EndToEndBenchmark::isComplete(const QJsonObject& results)
+{
+	for (const QString& mode : results.keys())
+	{
+		const QJsonObject result = results[mode].toObject();
+		if (result["files"].toInt() <= 0 || result["processed"].toInt() != result["files"].toInt() || result["filesPerSecond"].toDouble() <= 0)
+		{
+			return false;
+		}
+	}
+	return !results.isEmpty();
+}
+
+QJsonObject EndToEndBenchmark::createBaseline(const Options& options, const QJsonObject& results)
+{
+	QJsonObject modes;
+	for (const QString& mode : results.keys())
+	{
+		QJsonObject values;
+		values["filesPerSecond"] = results[mode].toObject()["filesPerSecond"];
+		values["wallMs"] = results[mode].toObject()["wallMs"];
+		modes[mode] = values;
+	}
+
+	QJsonObject baseline;
+	baseline["files"] = options.filesCount;
+	baseline["megapixels"] = options.megapixels;
+	baseline["modes"] = modes;
+	return baseline;
+}
+
+bool EndToEndBenchmark::compare(const QJsonObject& results, const QJsonObject& baseline, double maxRegression, const std::function<void(const QJsonObject&)>& report)
+{
+	bool isPassed = true;
+	const QJsonObject modes = baseline["modes"].toObject();
+	for (const QString& mode : results.keys())
+	{
+		if (!modes.contains(mode))
+		{
+			continue;
+		}
+
+		const double baselineFilesPerSecond = modes[mode].toObject()["filesPerSecond"].toDouble();
+		const double filesPerSecond = results[mode].toObject()["filesPerSecond"].toDouble();
+		const double change = baselineFilesPerSecond > 0 ? filesPerSecond / baselineFilesPerSecond - 1 : 0;
+		const bool isRegressed = baselineFilesPerSecond <= 0 || change < -maxRegression;
+		isPassed = isPassed && !isRegressed;
+
+		QJsonObject comparison;
+		comparison["type"] = "comparison";
+		comparison["mode"] = mode;
+		comparison["baselineFilesPerSecond"] = baselineFilesPerSecond;
+		comparison["filesPerSecond"] = filesPerSecond;
+		comparison["change"] = change;
+		comparison["regressed"] = isRegressed;
+		report(comparison);
+	}
+	return isPassed;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <functional>
+#include <QJsonObject>
+#include <QString>
+
+// Runs a fixed synthetic batch through scan, reference matching, read, correction and save, the same way flatfield-cli does, once with
+// every file scaled on its own and once with the common scale for batch. Results can be stored as a baseline, later runs are compared
+// with it and fail when the throughput drops more than the allowed fraction.
+class EndToEndBenchmark
+{
+public:
+	struct Options
+	{
+		int filesCount = 8;
+		int megapixels = 24;
+		// Batch is created in a temporary folder when it is empty.
+		QString workFolder;
+	};
+
+private:
+	static constexpr uint16_t blackLevel = 512;
+	static constexpr uint16_t whiteLevel = 16383;
+
+	// Uncompressed 16 bit Bayer DNG with the tags which the metadata reader needs. References are a smooth vignette, sources a gradient
+	// with the same vignette, so correction and scaling work with realistic values.
+	static bool writeFile(const QString& filePath, int width, int height, bool isReference, int seed);
+	static bool createBatch(const QString& workFolder, const Options& options);
+	static QJsonObject runMode(const QString& workFolder, bool calculateCommonScaleForBatch);
+	// Peak resident set size of the process in bytes, 0 where it is not known.
+	static qint64 getPeakResidentSize();
+
+public:
+	// Results of the modes by name, an empty object if the batch can't be created.
+	static QJsonObject run(const Options& options, const std::function<void(const QJsonObject&)>& report);
+	// Throughput of a batch with failed or skipped files is not comparable, so results are used only when every file of every mode was
+	// processed.
+	static bool isComplete(const QJsonObject& results);
+	static QJsonObject createBaseline(const Options& options, const QJsonObject& results);
+	// Reports the change of every mode, returns false if a mode is slower than the baseline by more than the allowed fraction, or if the
+	// baseline of a mode has no throughput.
+	static bool compare(const QJsonObject& results, const QJsonObject& baseline, double maxRegression, const std::function<void(const QJsonObject&)>& report);
+};
@@ -1,5 +1,6 @@
 #include <QDir>
 #include "FileUtils.h"
+#include "Tracer.h"
 
 QString FileUtils::getRelativePath(const QString& rootFolder, const QString& absolutePath)
 {
@@ -11,6 +12,17 @@ QString FileUtils::getAbsolutePath(const QString& rootFolder, const QString& rel
 	return QDir(rootFolder).filePath(relativePath);
 }
 
+QString FileUtils::getDestinationFilePathInDestinationFolder(const QString& sourceFilePath, const QString& sourceFilesRoot, const SavingOptions& savingOptions)
+{
+	return QDir(savingOptions.saveToFolderPath).absolutePath() + QDir::separator() + getRelativePath(sourceFilesRoot, sourceFilePath);
+}
+
+QString FileUtils::getDestinationFilePathInSubfolder(const QString& sourceFilePath, const SavingOptions& savingOptions)
+{
+	const QFileInfo fileInfo(sourceFilePath);
+	return fileInfo.dir().path() + QDir::separator() + savingOptions.saveToSubfolderFolderName + QDir::separator() + fileInfo.fileName();
+}
+
 QString FileUtils::createDestinationFileInDestinationFolder(const QString& sourceFilePath, const QString& sourceFilesRoot, const SavingOptions& savingOptions)
 {
 	const QDir destinationFolder(savingOptions.saveToFolderPath);
@@ -19,13 +31,14 @@ QString FileUtils::createDestinationFileInDestinationFolder(const QString& sourc
 		return "";
 	}
 
-	QString destinationFilePath = destinationFolder.absolutePath() + QDir::separator() + getRelativePath(sourceFilesRoot, sourceFilePath);
+	QString destinationFilePath = getDestinationFilePathInDestinationFolder(sourceFilePath, sourceFilesRoot, savingOptions);
 
 	if (QFileInfo(destinationFilePath).exists())
 	{
 		QFile::remove(destinationFilePath);
 	}
 
+	const Tracer::Span span("copy", "save", sourceFilePath);
 	if (QFile::copy(sourceFilePath, destinationFilePath))
 	{
 		return destinationFilePath;
@@ -36,17 +49,16 @@ QString FileUtils::createDestinationFileInDestinationFolder(const QString& sourc
 
 QString FileUtils::createDestinationFileInSubfolder(const QString& sourceFilePath, const SavingOptions& savingOptions)
 {
-	const QFileInfo fileInfo(sourceFilePath);
-	const QString destinationFolder = fileInfo.dir().path() + QDir::separator() + savingOptions.saveToSubfolderFolderName;
-	QString destinationFilePath = destinationFolder + QDir::separator() + fileInfo.fileName();
+	QString destinationFilePath = getDestinationFilePathInSubfolder(sourceFilePath, savingOptions);
 
-	QDir().mkdir(destinationFolder);
+	QDir().mkdir(QFileInfo(destinationFilePath).dir().path());
 
 	if (QFileInfo(destinationFilePath).exists())
 	{
 		QFile::remove(destinationFilePath);
 	}
 
+	const Tracer::Span span("copy", "save", sourceFilePath);
 	if (QFile::copy(sourceFilePath, destinationFilePath))
 	{
 		return destinationFilePath;
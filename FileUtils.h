@@ -7,6 +7,9 @@ class FileUtils
 public:
 	static QString getRelativePath(const QString& rootFolder, const QString& absolutePath);
 	static QString getAbsolutePath(const QString& rootFolder, const QString& relativePath);
+	// Path of the processed file, without creating it.
+	static QString getDestinationFilePathInDestinationFolder(const QString& sourceFilePath, const QString& sourceFilesRoot, const SavingOptions& savingOptions);
+	static QString getDestinationFilePathInSubfolder(const QString& sourceFilePath, const SavingOptions& savingOptions);
 	static QString createDestinationFileInDestinationFolder(const QString& sourceFilePath, const QString& sourceFilesRoot, const SavingOptions& savingOptions);
 	static QString createDestinationFileInSubfolder(const QString& sourceFilePath, const SavingOptions& savingOptions);
 	static bool isFileFromOutputSubfolder(const QString& sourceFilePath, const SavingOptions& savingOptions);
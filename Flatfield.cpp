@@ -12,6 +12,10 @@
 Flatfield::Flatfield(QWidget* parent) : QMainWindow(parent)
 {
 	processor = new Processor();
+	AsyncFileIO::setQueueDepth(settings.ioQueueDepth);
+	AsyncFileIO::setCachePolicy(settings.ioCachePolicy);
+	Prefetcher::setLookahead(settings.prefetchItems);
+	Prefetcher::setMemoryLimit(settings.prefetchMemoryLimit);
 
 	ui.setupUi(this);
 
@@ -84,6 +88,7 @@ void Flatfield::setupUI()
 	ui.checkBoxProcessingCalculateCommonScale->setChecked(settings.globalProcessingOptions.calculateCommonScaleForBatch);
 	ui.lineEditSaveToFolderRoot->setText(settings.savingOptions.saveToFolderPath);
 	ui.lineEditSaveToSubfolderName->setText(settings.savingOptions.saveToSubfolderFolderName);
+	ui.comboBoxSaveOutputFormat->setCurrentIndex(settings.savingOptions.outputFormat);
 	ui.tableViewSourceFiles->setModel(sourceFilesModel);
 	ui.tableViewReferenceFiles->setModel(referenceFilesModel);
 
@@ -119,6 +124,7 @@ void Flatfield::connectSignalsToSlots()
 	connect(ui.radioButtonSaveToFolder, &QRadioButton::clicked, this, &Flatfield::slotSaveToFolderRadioButtonClicked);
 	connect(ui.radioButtonSaveToSubfolder, &QRadioButton::clicked, this, &Flatfield::slotSaveToSubfolderRadioButtonClicked);
 	connect(ui.pushButtonSaveToFolderSelectFolder, &QPushButton::clicked, this, &Flatfield::slotSaveToOutputFolderClicked);
+	connect(ui.comboBoxSaveOutputFormat, &QComboBox::currentIndexChanged, this, &Flatfield::slotSaveOutputFormatChanged);
 	connect(ui.pushButtonProcessReady, &QPushButton::clicked, this, &Flatfield::slotProcessAllReadyClicked);
 	connect(ui.pushButtonProcessReadySelected, &QPushButton::clicked, this, &Flatfield::slotProcessAllReadySelectedClicked);
 	connect(ui.pushButtonProcessWithOneReference, &QPushButton::clicked, this, &Flatfield::slotProcessSelectedWithOneReferenceClicked);
@@ -139,6 +145,8 @@ void Flatfield::connectSignalsToSlots()
 	connect(processor, &Processor::signalProcessingStarted, this, &Flatfield::slotProcessingStarted);
 	connect(processor, &Processor::signalProcessingFinished, this, &Flatfield::slotProcessingFinished);
 	connect(processor, &Processor::signalProcessingProgressChanged, this, &Flatfield::slotProcessingGlobalProgressChanged);
+	connect(processor, &Processor::signalItemProcessed, this, &Flatfield::slotItemProcessed);
+	connect(processor, &Processor::signalItemUpToDate, this, &Flatfield::slotItemUpToDate);
 
 	connect(this, &Flatfield::signalProcessingStarted, this, &Flatfield::slotFileScanStarted);
 	connect(this, &Flatfield::signalProcessingFinished, this, &Flatfield::slotFileScanFinished);
@@ -368,7 +376,7 @@ void Flatfield::start() const
 	{
 		processingItems.append(ProcessingItem(sourceFilesList[i]->sourceFile, sourceFilesList[i]->activeReferenceFile, sourceFilesList[i]->processingOptions));
 	}
-	processor->process(ProcessingParcel(processingItems, settings.sourceFilesRoot, settings.globalProcessingOptions, settings.savingOptions));
+	process(processingItems);
 }
 
 void Flatfield::fillSourceList() const
@@ -385,6 +393,7 @@ void Flatfield::fillSourceList() const
 
 		sourceFilesModel->setItem(i, 0, filePathItem);
 		sourceFilesModel->setItem(i, 1, metadataItem);
+		sourceFilesModel->setItem(i, 2, new QStandardItem());
 	}
 
 	colorSourceList();
@@ -522,9 +531,45 @@ void Flatfield::prepareProcessingParcel(const QList<QSharedPointer<SourceFileInf
 			processingItems.append(ProcessingItem(sourceFileInfo->sourceFile, sourceFileInfo->activeReferenceFile, sourceFileInfo->processingOptions));
 		}
 	}
+	process(processingItems);
+}
+
+void Flatfield::process(const QList<ProcessingItem>& processingItems) const
+{
+	processingFilePaths.clear();
+	for (int i = 0; i < processingItems.size(); i++)
+	{
+		processingFilePaths.append(processingItems[i].sourceFile->filePath);
+	}
+
+	// Status of the previous run is cleared, so only files of this parcel show one.
+	for (int i = 0; i < sourceFilesModel->rowCount(); i++)
+	{
+		sourceFilesModel->item(i, 2)->setText("");
+	}
+
 	processor->process(ProcessingParcel(processingItems, settings.sourceFilesRoot, settings.globalProcessingOptions, settings.savingOptions));
 }
 
+void Flatfield::setSourceFileStatus(int index, const QString& status, const QColor& color) const
+{
+	if (index < 0 || index >= processingFilePaths.size())
+	{
+		return;
+	}
+
+	for (int i = 0; i < sourceFiles.size() && i < sourceFilesModel->rowCount(); i++)
+	{
+		if (sourceFiles[i]->sourceFile->filePath == processingFilePaths[index])
+		{
+			QStandardItem* statusItem = sourceFilesModel->item(i, 2);
+			statusItem->setText(status);
+			statusItem->setForeground(QBrush(color));
+			return;
+		}
+	}
+}
+
 void Flatfield::colorCalculateCommonBatchScaleCheckbox() const
 {
 	ui.checkBoxProcessingCalculateCommonScale->setChecked(settings.globalProcessingOptions.scaleChannelsToAvoidClipping && settings.globalProcessingOptions.calculateCommonScaleForBatch);
@@ -694,7 +739,7 @@ void Flatfield::slotProcessSelectedWithOneReferenceClicked() const
 	{
 		processingItems.append(ProcessingItem(selectedSourceFiles[i]->sourceFile, QSharedPointer<FileInfo>(new FileInfo(referenceFileName, referenceFileMetadata)), selectedSourceFiles[i]->processingOptions));
 	}
-	processor->process(ProcessingParcel(processingItems, settings.sourceFilesRoot, settings.globalProcessingOptions, settings.savingOptions));
+	process(processingItems);
 }
 
 void Flatfield::slotCancelClicked() const
@@ -882,6 +927,11 @@ void Flatfield::slotSaveProcessedFilesToSubfolderFolderNameChanged(const QString
 	settings.savingOptions.saveToSubfolderFolderName = name;
 }
 
+void Flatfield::slotSaveOutputFormatChanged(int index)
+{
+	settings.savingOptions.outputFormat = (SavingOptions::OutputFormatEnum)index;
+}
+
 void Flatfield::slotProcessingStarted(int total) const
 {
 	ui.progressBarProcessing->setValue(0);
@@ -896,6 +946,23 @@ void Flatfield::slotProcessingGlobalProgressChanged(int progress) const
 	ui.progressBarProcessing->setValue(progress);
 }
 
+void Flatfield::slotItemProcessed(int index, bool isProcessed, qint64 elapsed) const
+{
+	if (isProcessed)
+	{
+		setSourceFileStatus(index, QString("Processed in %1 s").arg(elapsed / 1000.0, 0, 'f', 1), QColor(0, 127, 0, 255));
+	}
+	else
+	{
+		setSourceFileStatus(index, "Failed", QColor(255, 0, 0, 255));
+	}
+}
+
+void Flatfield::slotItemUpToDate(int index) const
+{
+	setSourceFileStatus(index, "Up to date", QColor(0, 0, 0, 255));
+}
+
 void Flatfield::slotProcessingFinished() const
 {
 	ui.progressBarProcessing->setValue(0);
@@ -13,11 +13,13 @@ class Flatfield : public QMainWindow
 
 	QList<QSharedPointer<SourceFileInfo>> sourceFiles;
 	QMap<QString, QSharedPointer<SourceFileInfo>> pathToSourceFileMap;
+	// Source files of the items of the last parcel, processor signals refer to items by their index.
+	mutable QList<QString> processingFilePaths;
 
 	Settings settings;
 	Processor* processor;
 	ReferenceFiles referenceFiles;
-	QStandardItemModel* sourceFilesModel = new QStandardItemModel(0, 2, this);
+	QStandardItemModel* sourceFilesModel = new QStandardItemModel(0, 3, this);
 	QStandardItemModel* referenceFilesModel = new QStandardItemModel(0, 3, this);
 
 	static QColor getSourceFileItemColor(const QSharedPointer<SourceFileInfo>& sourceFileInfo);
@@ -44,6 +46,8 @@ class Flatfield : public QMainWindow
 	static QSharedPointer<FileInfo> getCommonActiveReferenceFile(const QList<QSharedPointer<SourceFileInfo>>& selectedSourceFiles);
 	void setUIState(bool isEnabled) const;
 	void prepareProcessingParcel(const QList<QSharedPointer<SourceFileInfo>>& files) const;
+	void process(const QList<ProcessingItem>& processingItems) const;
+	void setSourceFileStatus(int index, const QString& status, const QColor& color) const;
 	void colorCalculateCommonBatchScaleCheckbox() const;
 
 signals:
@@ -85,6 +89,7 @@ private slots:
 	void slotSaveToOutputFolderClicked();
 	void slotSaveProcessedFilesToFolderPathChanged(const QString& path);
 	void slotSaveProcessedFilesToSubfolderFolderNameChanged(const QString& name);
+	void slotSaveOutputFormatChanged(int index);
 	void slotProcessAllReadyClicked() const;
 	void slotProcessAllReadySelectedClicked() const;
 	void slotProcessSelectedWithOneReferenceClicked() const;
@@ -93,6 +98,8 @@ private slots:
 	void slotProcessingStarted(int total) const;
 	void slotProcessingFinished() const;
 	void slotProcessingGlobalProgressChanged(int progress) const;
+	void slotItemProcessed(int index, bool isProcessed, qint64 elapsed) const;
+	void slotItemUpToDate(int index) const;
 	void slotFileScanStarted(int total) const;
 	void slotFileScanProgressChanged(int progress) const;
 	void slotFileScanFinished() const;
@@ -0,0 +1,21 @@
+# Microbenchmarks of the processing stages and an end-to-end batch benchmark on synthetic images, they need no sample files.
+QT = core concurrent
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = flatfield-bench
+
+include(FlatfieldCore.pri)
+
+SOURCES += \
+    EndToEndBenchmark.cpp \
+    KernelBenchmark.cpp \
+    mainBench.cpp
+
+HEADERS += \
+    EndToEndBenchmark.h \
+    KernelBenchmark.h
+
+# Peak working set of the end-to-end benchmark.
+win32: LIBS += -lpsapi
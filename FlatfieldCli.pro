@@ -0,0 +1,34 @@
+# Headless batch runner, it shares the processing code with the UI application but does not link Qt GUI or Widgets.
+QT = core concurrent network
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = flatfield-cli
+
+include(FlatfieldCore.pri)
+
+SOURCES += \
+    BatchRunner.cpp \
+    FolderWatcher.cpp \
+    JobServer.cpp \
+    MetricsServer.cpp \
+    SharedReference.cpp \
+    Worker.cpp \
+    WorkerPool.cpp \
+    mainCli.cpp
+
+HEADERS += \
+    BatchRunner.h \
+    FolderWatcher.h \
+    JobServer.h \
+    MetricsServer.h \
+    SharedReference.h \
+    Worker.h \
+    WorkerPool.h
+
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
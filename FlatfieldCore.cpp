@@ -0,0 +1,93 @@
+#include <QFileInfo>
+#include "FlatfieldCore.h"
+#include "MetadataReader.h"
+#include "RawDataIO.h"
+
+QMutex FlatfieldCore::runMutex;
+
+QSharedPointer<Metadata> FlatfieldCore::readMetadata(const QString& filePath)
+{
+	return MetadataReader::readMetadata(filePath);
+}
+
+bool FlatfieldCore::readRawData(const QString& filePath, const QSharedPointer<Metadata>& metadata, QList<uint16_t>& buffer)
+{
+	buffer.resize(static_cast<qsizetype>(metadata->imageHeight) * metadata->imageWidth * metadata->getSamplesPerPixel());
+	return RawDataIO::read(filePath, metadata, buffer);
+}
+
+bool FlatfieldCore::readRawData(const QString& filePath, const QSharedPointer<Metadata>& metadata, QList<float>& buffer)
+{
+	buffer.resize(static_cast<qsizetype>(metadata->imageHeight) * metadata->imageWidth * metadata->getSamplesPerPixel());
+	return RawDataIO::read(filePath, metadata, buffer);
+}
+
+bool FlatfieldCore::correct(QList<uint16_t>& imageBuffer, const QSharedPointer<Metadata>& imageMetadata, QList<uint16_t>& referenceBuffer, const QSharedPointer<Metadata>& referenceMetadata, const ProcessingOptions& processingOptions, const GlobalProcessingOptions& globalProcessingOptions)
+{
+	return correctBuffer(imageBuffer, imageMetadata, referenceBuffer, referenceMetadata, processingOptions, globalProcessingOptions);
+}
+
+bool FlatfieldCore::correct(QList<float>& imageBuffer, const QSharedPointer<Metadata>& imageMetadata, QList<float>& referenceBuffer, const QSharedPointer<Metadata>& referenceMetadata, const ProcessingOptions& processingOptions, const GlobalProcessingOptions& globalProcessingOptions)
+{
+	return correctBuffer(imageBuffer, imageMetadata, referenceBuffer, referenceMetadata, processingOptions, globalProcessingOptions);
+}
+
+template<typename T>
+bool FlatfieldCore::correctBuffer(QList<T>& imageBuffer, const QSharedPointer<Metadata>& imageMetadata, QList<T>& referenceBuffer, const QSharedPointer<Metadata>& referenceMetadata, const ProcessingOptions& processingOptions, const GlobalProcessingOptions& globalProcessingOptions)
+{
+	if (imageMetadata == nullptr || referenceMetadata == nullptr || imageMetadata->activeArea.size() != 4 || referenceMetadata->activeArea.size() != 4 ||
+		!Metadata::isCompatible(imageMetadata, referenceMetadata))
+	{
+		return false;
+	}
+
+	ImageProcessor* imageProcessor = Processor::getImageProcessor(imageMetadata->rawType);
+	const bool isSizeValid = imageBuffer.size() == imageProcessor->getImageDataSize(imageMetadata) && referenceBuffer.size() == imageProcessor->getImageDataSize(referenceMetadata);
+	if (!isSizeValid)
+	{
+		delete imageProcessor;
+		return false;
+	}
+
+	ProcessingItem item(QSharedPointer<FileInfo>(new FileInfo("", imageMetadata)), QSharedPointer<FileInfo>(new FileInfo("", referenceMetadata)), processingOptions);
+	ProcessingParcel parcel({ item }, "", globalProcessingOptions, SavingOptions());
+	parcel.globalProcessingOptions.calculateCommonScaleForBatch = false;
+	TwoPassProcessingState twoPassProcessingState;
+
+	QList<QList<T>> imageBuffers;
+	imageBuffers.append(std::move(imageBuffer));
+	imageProcessor->process(imageBuffers, referenceBuffer, parcel, 0, twoPassProcessingState);
+	imageBuffer = std::move(imageBuffers[0]);
+
+	delete imageProcessor;
+	return true;
+}
+
+bool FlatfieldCore::correctFile(const QString& sourceFilePath, const QString& referenceFilePath, const ProcessingOptions& processingOptions, const GlobalProcessingOptions& globalProcessingOptions, const SavingOptions& savingOptions)
+{
+	const QSharedPointer<Metadata> sourceMetadata = readMetadata(sourceFilePath);
+	const QSharedPointer<Metadata> referenceMetadata = readMetadata(referenceFilePath);
+	if (sourceMetadata == nullptr || referenceMetadata == nullptr)
+	{
+		return false;
+	}
+
+	const ProcessingItem item(QSharedPointer<FileInfo>(new FileInfo(sourceFilePath, sourceMetadata)), QSharedPointer<FileInfo>(new FileInfo(referenceFilePath, referenceMetadata)), processingOptions);
+	GlobalProcessingOptions singleFileOptions = globalProcessingOptions;
+	singleFileOptions.calculateCommonScaleForBatch = false;
+
+	const QMutexLocker locker(&runMutex);
+	bool isCorrected = false;
+	ProcessingCallbacks callbacks;
+	callbacks.itemProcessed = [&isCorrected](int, bool isProcessed, qint64) { isCorrected = isProcessed; };
+	callbacks.itemUpToDate = [&isCorrected](int) { isCorrected = true; };
+	Processor::run(ProcessingParcel({ item }, QFileInfo(sourceFilePath).path(), singleFileOptions, savingOptions), callbacks);
+
+	return isCorrected;
+}
+
+void FlatfieldCore::process(const ProcessingParcel& parcel, const ProcessingCallbacks& callbacks)
+{
+	const QMutexLocker locker(&runMutex);
+	Processor::run(parcel, callbacks);
+}
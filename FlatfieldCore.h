@@ -0,0 +1,38 @@
+#pragma once
+#include <QList>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QString>
+
+#include "DataStructs.h"
+#include "Processor.h"
+
+// Entry point of the flatfield library for embedding the correction into other applications. Everything runs synchronously in the
+// calling thread, without event loop or signals. Reading and correction of buffers may run in several threads at the same time. Runs of
+// files and batches share the page cache handling, the metrics and the processing manifests, so they are serialized, and callbacks must
+// not start another run.
+class FlatfieldCore
+{
+	static QMutex runMutex;
+
+	template<typename T>
+	static bool correctBuffer(QList<T>& imageBuffer, const QSharedPointer<Metadata>& imageMetadata, QList<T>& referenceBuffer, const QSharedPointer<Metadata>& referenceMetadata, const ProcessingOptions& processingOptions, const GlobalProcessingOptions& globalProcessingOptions);
+
+public:
+	// Returns nullptr if the file is not supported.
+	static QSharedPointer<Metadata> readMetadata(const QString& filePath);
+	// Buffers are resized to the image size of the metadata, samples are in the order of the raw data.
+	static bool readRawData(const QString& filePath, const QSharedPointer<Metadata>& metadata, QList<uint16_t>& buffer);
+	static bool readRawData(const QString& filePath, const QSharedPointer<Metadata>& metadata, QList<float>& buffer);
+
+	// Corrects raw samples of the image in place. Metadata describes the layout and levels of each buffer, e.g. as read from the files
+	// the data comes from, and sizes of the buffers must match it. The reference buffer is used as scratch space and changed.
+	// A single image has no batch, so the common scale for batch is not applied.
+	static bool correct(QList<uint16_t>& imageBuffer, const QSharedPointer<Metadata>& imageMetadata, QList<uint16_t>& referenceBuffer, const QSharedPointer<Metadata>& referenceMetadata, const ProcessingOptions& processingOptions, const GlobalProcessingOptions& globalProcessingOptions);
+	static bool correct(QList<float>& imageBuffer, const QSharedPointer<Metadata>& imageMetadata, QList<float>& referenceBuffer, const QSharedPointer<Metadata>& referenceMetadata, const ProcessingOptions& processingOptions, const GlobalProcessingOptions& globalProcessingOptions);
+
+	// Corrects one file and saves it as set by the saving options, the source folder is the root for the output folder mode.
+	static bool correctFile(const QString& sourceFilePath, const QString& referenceFilePath, const ProcessingOptions& processingOptions, const GlobalProcessingOptions& globalProcessingOptions, const SavingOptions& savingOptions);
+	// Processes a batch the same way as the application does, including the processing manifest.
+	static void process(const ProcessingParcel& parcel, const ProcessingCallbacks& callbacks = {});
+};
@@ -0,0 +1,79 @@
+# Correction engine shared by the flatfield library, the application and the command line runner. It uses only QtCore and QtConcurrent.
+QT += core concurrent
+
+CONFIG += c++17
+
+INCLUDEPATH += $$PWD
+DEPENDPATH += $$PWD
+
+SOURCES += \
+    $$PWD/AsyncFileIO.cpp \
+    $$PWD/BatchStatistics.cpp \
+    $$PWD/BitPacking.cpp \
+    $$PWD/FileUtils.cpp \
+    $$PWD/FlatfieldCore.cpp \
+    $$PWD/GainMap.cpp \
+    $$PWD/ImageProcessor.cpp \
+    $$PWD/ImageProcessorBayer.cpp \
+    $$PWD/ImageProcessorMono.cpp \
+    $$PWD/ImageProcessorRGB.cpp \
+    $$PWD/LosslessJpeg.cpp \
+    $$PWD/Manifest.cpp \
+    $$PWD/MemoryProfiler.cpp \
+    $$PWD/MetadataReader.cpp \
+    $$PWD/Metrics.cpp \
+    $$PWD/Prefetcher.cpp \
+    $$PWD/Processor.cpp \
+    $$PWD/RawDataIO.cpp \
+    $$PWD/ReferenceFiles.cpp \
+    $$PWD/Settings.cpp \
+    $$PWD/TiffFile.cpp \
+    $$PWD/Tracer.cpp
+
+HEADERS += \
+    $$PWD/AsyncFileIO.h \
+    $$PWD/BatchStatistics.h \
+    $$PWD/BitPacking.h \
+    $$PWD/DataStructs.h \
+    $$PWD/FileUtils.h \
+    $$PWD/FlatfieldCore.h \
+    $$PWD/GainMap.h \
+    $$PWD/ImageProcessor.h \
+    $$PWD/ImageProcessorBayer.h \
+    $$PWD/ImageProcessorMono.h \
+    $$PWD/ImageProcessorRGB.h \
+    $$PWD/LosslessJpeg.h \
+    $$PWD/Manifest.h \
+    $$PWD/MemoryProfiler.h \
+    $$PWD/MetadataReader.h \
+    $$PWD/Metrics.h \
+    $$PWD/Prefetcher.h \
+    $$PWD/Processor.h \
+    $$PWD/RawDataIO.h \
+    $$PWD/ReferenceFiles.h \
+    $$PWD/Settings.h \
+    $$PWD/TiffFile.h \
+    $$PWD/Tracer.h
+
+# Raw data I/O goes through io_uring when liburing is available, a thread pool is used otherwise.
+linux {
+    CONFIG += link_pkgconfig
+    packagesExist(liburing) {
+        PKGCONFIG += liburing
+        DEFINES += FLATFIELD_IO_URING
+    }
+}
+
+win32:CONFIG(release, debug|release): LIBS += -L$$PWD/../OpenCV/build/x64/vc16/lib/ -lopencv_world4100
+else:win32:CONFIG(debug, debug|release): LIBS += -L$$PWD/../OpenCV/build/x64/vc16/lib/ -lopencv_world4100d
+else:unix: LIBS += -L$$PWD/../OpenCV/build/x64/vc16/lib/ -lopencv_world4100
+
+INCLUDEPATH += $$PWD/../OpenCV/build/include
+DEPENDPATH += $$PWD/../OpenCV/build/include
+
+win32:CONFIG(release, debug|release): LIBS += -L$$PWD/../exiv2/lib/release/ -lexiv2
+else:win32:CONFIG(debug, debug|release): LIBS += -L$$PWD/../exiv2/lib/debug/ -lexiv2
+else:unix: LIBS += -L$$PWD/../exiv2/lib/ -lexiv2
+
+INCLUDEPATH += $$PWD/../exiv2/include $$PWD/../exiv2/build
+DEPENDPATH += $$PWD/../exiv2/include
@@ -0,0 +1,18 @@
+# Flatfield library, for embedding the correction into other applications through FlatfieldCore.h.
+# It is static, its headers don't export symbols for a shared library.
+TEMPLATE = lib
+QT = core concurrent
+
+TARGET = flatfield
+
+CONFIG += staticlib
+
+include(FlatfieldCore.pri)
+
+# Default rules for deployment.
+unix:!android {
+    target.path = /usr/local/lib
+    headers.path = /usr/local/include/flatfield
+    headers.files = $$HEADERS
+    INSTALLS += target headers
+}
@@ -0,0 +1,242 @@
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include "FolderWatcher.h"
+
+#ifdef Q_OS_LINUX
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+FolderWatcher::FolderWatcher(bool recurseSubfolders, int settleTime, QObject* parent) : QObject(parent), recurseSubfolders(recurseSubfolders), settleTime(qMax(0, settleTime))
+{
+	clock.start();
+	lastEventTime = QDateTime::currentMSecsSinceEpoch();
+	timer.setInterval(qMax(50, this->settleTime / 4));
+	connect(&timer, &QTimer::timeout, this, &FolderWatcher::checkCandidates);
+
+#ifdef Q_OS_LINUX
+	inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (inotifyFd >= 0)
+	{
+		notifier = new QSocketNotifier(inotifyFd, QSocketNotifier::Read, this);
+		connect(notifier, &QSocketNotifier::activated, this, &FolderWatcher::readInotifyEvents);
+		return;
+	}
+#endif
+
+	fileSystemWatcher = new QFileSystemWatcher(this);
+	connect(fileSystemWatcher, &QFileSystemWatcher::directoryChanged, this, &FolderWatcher::rescanFolder);
+}
+
+FolderWatcher::~FolderWatcher()
+{
+#ifdef Q_OS_LINUX
+	if (inotifyFd >= 0)
+	{
+		delete notifier;
+		::close(inotifyFd);
+	}
+#endif
+}
+
+bool FolderWatcher::watch(const QString& folderPath)
+{
+	if (!QDir(folderPath).exists())
+	{
+		return false;
+	}
+
+	addFolder(QDir::cleanPath(folderPath), false);
+	return true;
+}
+
+void FolderWatcher::addFolder(const QString& folderPath, bool addExistingFiles)
+{
+#ifdef Q_OS_LINUX
+	if (inotifyFd >= 0)
+	{
+		// Files still being written are skipped until they are closed, so IN_CREATE is only needed for folders.
+		const int wd = inotify_add_watch(inotifyFd, QFile::encodeName(folderPath).constData(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_ONLYDIR);
+		if (wd >= 0)
+		{
+			watchedFolders.insert(wd, folderPath);
+		}
+	}
+	else
+#endif
+	{
+		fileSystemWatcher->addPath(folderPath);
+		const QFileInfoList files = QDir(folderPath).entryInfoList({ "*.dng" }, QDir::Files);
+		for (int i = 0; i < files.size(); i++)
+		{
+			knownFiles.insert(files[i].filePath(), { files[i].size(), files[i].lastModified().toMSecsSinceEpoch() });
+		}
+	}
+
+	// Files could be written to a new folder before it was watched.
+	if (addExistingFiles)
+	{
+		this->addExistingFiles(folderPath);
+	}
+
+	if (recurseSubfolders)
+	{
+		const QStringList subfolders = QDir(folderPath).entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+		for (int i = 0; i < subfolders.size(); i++)
+		{
+			addFolder(folderPath + "/" + subfolders[i], addExistingFiles);
+		}
+	}
+}
+
+void FolderWatcher::addExistingFiles(const QString& folderPath, qint64 modifiedSince)
+{
+	const QFileInfoList files = QDir(folderPath).entryInfoList({ "*.dng" }, QDir::Files);
+	for (int i = 0; i < files.size(); i++)
+	{
+		if (files[i].lastModified().toMSecsSinceEpoch() >= modifiedSince)
+		{
+			addCandidate(files[i].filePath());
+		}
+	}
+}
+
+void FolderWatcher::addCandidate(const QString& filePath)
+{
+	candidates[filePath] = { QFileInfo(filePath).size(), clock.elapsed() };
+	if (!timer.isActive())
+	{
+		timer.start();
+	}
+}
+
+void FolderWatcher::checkCandidates()
+{
+	const qint64 now = clock.elapsed();
+	QStringList readyFiles;
+	for (auto iterator = candidates.begin(); iterator != candidates.end();)
+	{
+		const QFileInfo fileInfo(iterator.key());
+		if (!fileInfo.exists())
+		{
+			iterator = candidates.erase(iterator);
+		}
+		else if (fileInfo.size() != iterator->size)
+		{
+			iterator->size = fileInfo.size();
+			iterator->lastChange = now;
+			++iterator;
+		}
+		else if (now - iterator->lastChange >= settleTime)
+		{
+			readyFiles.append(iterator.key());
+			iterator = candidates.erase(iterator);
+		}
+		else
+		{
+			++iterator;
+		}
+	}
+
+	if (candidates.isEmpty())
+	{
+		timer.stop();
+	}
+
+	for (int i = 0; i < readyFiles.size(); i++)
+	{
+		emit signalFileReady(readyFiles[i]);
+	}
+}
+
+void FolderWatcher::readInotifyEvents()
+{
+#ifdef Q_OS_LINUX
+	alignas(inotify_event) char buffer[64 * 1024];
+	ssize_t length;
+	while ((length = ::read(inotifyFd, buffer, sizeof(buffer))) > 0)
+	{
+		// Lost events are newer than the received ones. Modification times have a coarse resolution on some file systems, so a second
+		// is left as a margin.
+		const qint64 modifiedSince = lastEventTime - 1000;
+		lastEventTime = QDateTime::currentMSecsSinceEpoch();
+
+		for (const char* pointer = buffer; pointer < buffer + length;)
+		{
+			const inotify_event* event = reinterpret_cast<const inotify_event*>(pointer);
+			pointer += sizeof(inotify_event) + event->len;
+
+			// Events were lost, so watched folders are checked again for files written since the previous events.
+			if (event->mask & IN_Q_OVERFLOW)
+			{
+				const QList<QString> folders = watchedFolders.values();
+				for (int i = 0; i < folders.size(); i++)
+				{
+					addExistingFiles(folders[i], modifiedSince);
+				}
+				continue;
+			}
+
+			if (event->mask & IN_IGNORED)
+			{
+				watchedFolders.remove(event->wd);
+				continue;
+			}
+
+			const QString folderPath = watchedFolders.value(event->wd);
+			if (folderPath.isEmpty() || event->len == 0)
+			{
+				continue;
+			}
+
+			const QString path = folderPath + "/" + QFile::decodeName(event->name);
+			if (event->mask & IN_ISDIR)
+			{
+				if (recurseSubfolders && (event->mask & (IN_CREATE | IN_MOVED_TO)))
+				{
+					addFolder(path, true);
+				}
+			}
+			else if ((event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) && isSupportedFile(path))
+			{
+				addCandidate(path);
+			}
+		}
+	}
+#endif
+}
+
+void FolderWatcher::rescanFolder(const QString& folderPath)
+{
+	const QFileInfoList files = QDir(folderPath).entryInfoList({ "*.dng" }, QDir::Files);
+	for (int i = 0; i < files.size(); i++)
+	{
+		const KnownFile knownFile = { files[i].size(), files[i].lastModified().toMSecsSinceEpoch() };
+		auto iterator = knownFiles.find(files[i].filePath());
+		if (iterator == knownFiles.end() || iterator->size != knownFile.size || iterator->lastModified != knownFile.lastModified)
+		{
+			knownFiles.insert(files[i].filePath(), knownFile);
+			addCandidate(files[i].filePath());
+		}
+	}
+
+	if (recurseSubfolders)
+	{
+		const QStringList watchedDirectories = fileSystemWatcher->directories();
+		const QStringList subfolders = QDir(folderPath).entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+		for (int i = 0; i < subfolders.size(); i++)
+		{
+			const QString subfolderPath = folderPath + "/" + subfolders[i];
+			if (!watchedDirectories.contains(subfolderPath))
+			{
+				addFolder(subfolderPath, true);
+			}
+		}
+	}
+}
+
+bool FolderWatcher::isSupportedFile(const QString& filePath)
+{
+	return filePath.endsWith(".dng", Qt::CaseInsensitive);
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <QElapsedTimer>
+#include <QFileSystemWatcher>
+#include <QHash>
+#include <QObject>
+#include <QSocketNotifier>
+#include <QTimer>
+
+// Reports DNG files which appear in the watched folders once they are completely written. On Linux inotify reports files which were
+// closed after writing or moved in, other platforms, and Linux when inotify is not available, rescan changed folders with QFileSystemWatcher.
+// In both cases a file is ready when its size has not changed for the settle time.
+class FolderWatcher : public QObject
+{
+	Q_OBJECT
+
+		struct Candidate
+	{
+		qint64 size;
+		qint64 lastChange;
+	};
+
+	struct KnownFile
+	{
+		qint64 size;
+		qint64 lastModified;
+	};
+
+	bool recurseSubfolders;
+	int settleTime;
+	QHash<QString, Candidate> candidates;
+	QTimer timer;
+	QElapsedTimer clock;
+
+	int inotifyFd = -1;
+	QSocketNotifier* notifier = nullptr;
+	QHash<int, QString> watchedFolders;
+	// Wall clock time of the last received events, files modified before it were already reported.
+	qint64 lastEventTime;
+
+	QFileSystemWatcher* fileSystemWatcher = nullptr;
+	QHash<QString, KnownFile> knownFiles;
+
+	void addFolder(const QString& folderPath, bool addExistingFiles);
+	void addExistingFiles(const QString& folderPath, qint64 modifiedSince = 0);
+	void addCandidate(const QString& filePath);
+	void checkCandidates();
+	void readInotifyEvents();
+	void rescanFolder(const QString& folderPath);
+	static bool isSupportedFile(const QString& filePath);
+
+signals:
+	void signalFileReady(const QString& filePath);
+
+public:
+	static constexpr int defaultSettleTime = 1000;
+
+	explicit FolderWatcher(bool recurseSubfolders, int settleTime = defaultSettleTime, QObject* parent = nullptr);
+	~FolderWatcher() override;
+
+	// Files which already exist in the folder are not reported.
+	bool watch(const QString& folderPath);
+};
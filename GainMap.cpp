@@ -0,0 +1,161 @@
+#include <cstring>
+#include <QFile>
+#include <QtEndian>
+#include "GainMap.h"
+#include "TiffFile.h"
+
+QList<QByteArray> GainMap::createOpcodes(const QSharedPointer<Metadata>& metadata, const QList<QList<float>>& gains)
+{
+	QList<QByteArray> opcodes;
+	for (int channel = 0; channel < gains.size(); channel++)
+	{
+		opcodes.append(createOpcode(metadata, gains[channel], channel));
+	}
+	return opcodes;
+}
+
+bool GainMap::write(const QString& filePath, const QSharedPointer<Metadata>& metadata, const QList<QByteArray>& opcodes)
+{
+	QFile file(filePath);
+	if (filePath.isEmpty() || !file.open(QIODevice::ReadWrite))
+	{
+		return false;
+	}
+
+	TiffFile tiffFile(&file);
+	if (!tiffFile.read())
+	{
+		return false;
+	}
+
+	for (int frame = 0; frame < metadata->getFramesCount(); frame++)
+	{
+		const TiffFile::Directory* rawDirectory = tiffFile.findDirectoryByDataOffset(metadata->getFrame(frame)->dataOffset);
+		if (rawDirectory == nullptr)
+		{
+			return false;
+		}
+
+		// Opcode lists are always big endian, regardless of the file byte order.
+		quint32 opcodesCount = opcodes.size();
+		QByteArray opcodeList(4, 0);
+		const TiffFile::Entry* existingOpcodeList = rawDirectory->findEntry(TiffFile::TagEnum::OpcodeList2);
+		if (existingOpcodeList != nullptr && existingOpcodeList->data.size() >= 4)
+		{
+			opcodesCount += qFromBigEndian<quint32>(existingOpcodeList->data.constData());
+			opcodeList.append(existingOpcodeList->data.mid(4));
+		}
+
+		for (int i = 0; i < opcodes.size(); i++)
+		{
+			opcodeList.append(opcodes[i]);
+		}
+		qToBigEndian<quint32>(opcodesCount, opcodeList.data());
+
+		TiffFile::Directory directory = *rawDirectory;
+		TiffFile::Entry entry;
+		entry.tag = TiffFile::TagEnum::OpcodeList2;
+		entry.type = TiffFile::TypeEnum::Undefined;
+		entry.count = opcodeList.size();
+		entry.data = opcodeList;
+		directory.setEntry(entry);
+
+		// The new directory is appended, the old one is left unreferenced.
+		const qint64 position = file.size() + file.size() % 2;
+		const qint64 end = tiffFile.writeDirectory(position, directory);
+		if (end < 0 || !tiffFile.writePointer(rawDirectory->pointerPosition, static_cast<quint32>(position)) || !tiffFile.read())
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+QByteArray GainMap::createOpcode(const QSharedPointer<Metadata>& metadata, const QList<float>& gains, int channel)
+{
+	// Bayer channels are interleaved with pitch 2, other types have one channel per plane.
+	const bool isBayer = metadata->rawType == Metadata::RawTypeEnum::Bayer;
+	const int pitch = isBayer ? 2 : 1;
+	const int rowOffset = isBayer ? channel / 2 : 0;
+	const int columnOffset = isBayer ? channel % 2 : 0;
+	const int plane = metadata->rawType == Metadata::RawTypeEnum::RGB ? channel : 0;
+
+	const int areaHeight = metadata->activeArea[2] - metadata->activeArea[0];
+	const int areaWidth = metadata->activeArea[3] - metadata->activeArea[1];
+	const int channelHeight = areaHeight / pitch;
+	const int channelWidth = areaWidth / pitch;
+
+	// Reference is blurred and smooth, so one map point per block of channel pixels is enough.
+	const int blockSize = qMax(1, (qMax(channelHeight, channelWidth) + maxMapPoints - 1) / maxMapPoints);
+	const int mapPointsV = (channelHeight + blockSize - 1) / blockSize;
+	const int mapPointsH = (channelWidth + blockSize - 1) / blockSize;
+
+	QByteArray parameters;
+	appendUint32(parameters, rowOffset);
+	appendUint32(parameters, columnOffset);
+	appendUint32(parameters, areaHeight);
+	appendUint32(parameters, areaWidth);
+	appendUint32(parameters, plane);
+	appendUint32(parameters, 1);
+	appendUint32(parameters, pitch);
+	appendUint32(parameters, pitch);
+	appendUint32(parameters, mapPointsV);
+	appendUint32(parameters, mapPointsH);
+
+	// Map positions are relative to the active area, points are placed at the block centers.
+	appendDouble(parameters, static_cast<double>(blockSize * pitch) / areaHeight);
+	appendDouble(parameters, static_cast<double>(blockSize * pitch) / areaWidth);
+	appendDouble(parameters, (rowOffset + (blockSize - 1) / 2.0 * pitch) / areaHeight);
+	appendDouble(parameters, (columnOffset + (blockSize - 1) / 2.0 * pitch) / areaWidth);
+	appendUint32(parameters, 1);
+
+	for (int mapRow = 0; mapRow < mapPointsV; mapRow++)
+	{
+		for (int mapColumn = 0; mapColumn < mapPointsH; mapColumn++)
+		{
+			const int lastRow = qMin((mapRow + 1) * blockSize, channelHeight);
+			const int lastColumn = qMin((mapColumn + 1) * blockSize, channelWidth);
+			double sum = 0;
+			for (int row = mapRow * blockSize; row < lastRow; row++)
+			{
+				for (int column = mapColumn * blockSize; column < lastColumn; column++)
+				{
+					sum += gains[row * channelWidth + column];
+				}
+			}
+			appendFloat(parameters, static_cast<float>(sum / ((lastRow - mapRow * blockSize) * (lastColumn - mapColumn * blockSize))));
+		}
+	}
+
+	QByteArray opcode;
+	appendUint32(opcode, gainMapOpcodeId);
+	appendUint32(opcode, dngVersion);
+	appendUint32(opcode, 0);
+	appendUint32(opcode, parameters.size());
+	opcode.append(parameters);
+	return opcode;
+}
+
+void GainMap::appendUint32(QByteArray& data, quint32 value)
+{
+	char bytes[4];
+	qToBigEndian<quint32>(value, bytes);
+	data.append(bytes, 4);
+}
+
+void GainMap::appendDouble(QByteArray& data, double value)
+{
+	quint64 bits;
+	memcpy(&bits, &value, sizeof(bits));
+	char bytes[8];
+	qToBigEndian<quint64>(bits, bytes);
+	data.append(bytes, 8);
+}
+
+void GainMap::appendFloat(QByteArray& data, float value)
+{
+	quint32 bits;
+	memcpy(&bits, &value, sizeof(bits));
+	appendUint32(data, bits);
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <QByteArray>
+
+#include "DataStructs.h"
+
+// DNG GainMap opcodes written to OpcodeList2 of the raw IFD, so raw converters apply the correction instead of rewriting pixels.
+class GainMap
+{
+	static constexpr quint32 gainMapOpcodeId = 9;
+	static constexpr quint32 dngVersion = 0x01030000;
+	static constexpr int maxMapPoints = 128;
+
+	static QByteArray createOpcode(const QSharedPointer<Metadata>& metadata, const QList<float>& gains, int channel);
+	static void appendUint32(QByteArray& data, quint32 value);
+	static void appendDouble(QByteArray& data, double value);
+	static void appendFloat(QByteArray& data, float value);
+
+public:
+	// Gains are full resolution channels in the layout used by image processors, they are averaged down to the map grid.
+	static QList<QByteArray> createOpcodes(const QSharedPointer<Metadata>& metadata, const QList<QList<float>>& gains);
+	// Opcodes are appended to the existing OpcodeList2 of every frame, raw data is not touched.
+	static bool write(const QString& filePath, const QSharedPointer<Metadata>& metadata, const QList<QByteArray>& opcodes);
+};
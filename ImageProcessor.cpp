@@ -1,13 +1,18 @@
 ﻿#include "ImageProcessor.h"
 
+#include <numeric>
 #include <QtConcurrent/QtConcurrentMap>
 #include <opencv2/imgproc.hpp>
 #include <opencv2/core/types.hpp>
+#include "MemoryProfiler.h"
+#include "Metrics.h"
+#include "Tracer.h"
 
 
 
 void ImageProcessor::blurChannel(OpenCVParcel parcel)
 {
+	const Tracer::Span span("blurChannel", "stage");
 	cv::Mat mat = cv::Mat(parcel.height, parcel.width, CV_32F, parcel.channel);
 	cv::GaussianBlur(mat, mat, cv::Size(0, 0), parcel.gaussianBlurSigma, parcel.gaussianBlurSigma);
 }
@@ -94,34 +99,161 @@ int ImageProcessor::getActiveAreaWidth(const QSharedPointer<Metadata>& metadata)
 	return metadata->activeArea[3] - metadata->activeArea[1];
 }
 
-void ImageProcessor::process(QList<uint16_t>& imageBuffer, QList<uint16_t>& referenceBuffer, const ProcessingParcel& parcel, int index, TwoPassProcessingState& twoPassProcessingState)
+void ImageProcessor::process(QList<QList<uint16_t>>& imageBuffers, QList<uint16_t>& referenceBuffer, const ProcessingParcel& parcel, int index, TwoPassProcessingState& twoPassProcessingState, const QList<uint16_t*>& outputBuffers)
 {
-	const ProcessingItem item = parcel.items[index];
+	const QList<QList<float>> referenceChannels = createReferenceChannels(referenceBuffer, parcel.items[index]);
+	processImage(imageBuffers, getChannelViews(referenceChannels), parcel, index, twoPassProcessingState, outputBuffers);
+}
+
+void ImageProcessor::process(QList<QList<float>>& imageBuffers, QList<float>& referenceBuffer, const ProcessingParcel& parcel, int index, TwoPassProcessingState& twoPassProcessingState, const QList<float*>& outputBuffers)
+{
+	const QList<QList<float>> referenceChannels = createReferenceChannels(referenceBuffer, parcel.items[index]);
+	processImage(imageBuffers, getChannelViews(referenceChannels), parcel, index, twoPassProcessingState, outputBuffers);
+}
+
+QList<QList<float>> ImageProcessor::prepareReference(QList<uint16_t>& referenceBuffer, const ProcessingItem& item)
+{
+	return createReferenceChannels(referenceBuffer, item);
+}
 
-	QList<QList<float>> imageChannels(item.sourceFile->metadata->getChannelsCount());
-	QList<QList<float>> referenceChannels(item.referenceFile->metadata->getChannelsCount());
+QList<QList<float>> ImageProcessor::prepareReference(QList<float>& referenceBuffer, const ProcessingItem& item)
+{
+	return createReferenceChannels(referenceBuffer, item);
+}
+
+void ImageProcessor::process(QList<QList<uint16_t>>& imageBuffers, const QList<const float*>& referenceChannels, const ProcessingParcel& parcel, int index, TwoPassProcessingState& twoPassProcessingState, const QList<uint16_t*>& outputBuffers)
+{
+	processImage(imageBuffers, referenceChannels, parcel, index, twoPassProcessingState, outputBuffers);
+}
+
+void ImageProcessor::process(QList<QList<float>>& imageBuffers, const QList<const float*>& referenceChannels, const ProcessingParcel& parcel, int index, TwoPassProcessingState& twoPassProcessingState, const QList<float*>& outputBuffers)
+{
+	processImage(imageBuffers, referenceChannels, parcel, index, twoPassProcessingState, outputBuffers);
+}
 
-	int channelSize = getChannelSize(item.sourceFile->metadata);
-	for (int channel = 0; channel < item.sourceFile->metadata->getChannelsCount(); channel++)
+QList<const float*> ImageProcessor::getChannelViews(const QList<QList<float>>& channels)
+{
+	QList<const float*> views(channels.size());
+	for (int channel = 0; channel < channels.size(); channel++)
+	{
+		views[channel] = channels[channel].constData();
+	}
+	return views;
+}
+
+QList<QList<float>> ImageProcessor::createChannels(const QSharedPointer<Metadata>& metadata)
+{
+	QList<QList<float>> channels(metadata->getChannelsCount());
+	for (int channel = 0; channel < channels.size(); channel++)
 	{
-		imageChannels[channel] = QList<float>(channelSize);
-		referenceChannels[channel] = QList<float>(channelSize);
+		channels[channel] = QList<float>(getChannelSize(metadata));
 	}
+	return channels;
+}
 
-	splitImage(imageBuffer, imageChannels, item.sourceFile->metadata);
+QList<QList<float>> ImageProcessor::calculateGains(QList<uint16_t>& referenceBuffer, const ProcessingItem& item)
+{
+	return calculateReferenceGains(referenceBuffer, item);
+}
+
+QList<QList<float>> ImageProcessor::calculateGains(QList<float>& referenceBuffer, const ProcessingItem& item)
+{
+	return calculateReferenceGains(referenceBuffer, item);
+}
+
+template<typename T>
+QList<QList<float>> ImageProcessor::createReferenceChannels(QList<T>& referenceBuffer, const ProcessingItem& item)
+{
+	QList<QList<float>> referenceChannels = createChannels(item.sourceFile->metadata);
 	splitImage(referenceBuffer, referenceChannels, item.referenceFile->metadata);
 
-	blurChannels(referenceChannels, item.referenceFile->metadata, item.processingOptions.gaussianBlurSigma);
+	{
+		const Metrics::StageTimer stageTimer(Metrics::Blur);
+		blurChannels(referenceChannels, item.referenceFile->metadata, item.processingOptions.gaussianBlurSigma);
+	}
+
+	const Metrics::StageTimer stageTimer(Metrics::Correct);
+	normalizeReference(referenceChannels, item);
+	return referenceChannels;
+}
+
+template<typename T>
+QList<QList<float>> ImageProcessor::calculateReferenceGains(QList<T>& referenceBuffer, const ProcessingItem& item)
+{
+	QList<QList<float>> referenceChannels = createReferenceChannels(referenceBuffer, item);
+
+	// Correcting an image of ones gives the multiplier of every pixel.
+	QList<QList<float>> gains = createChannels(item.sourceFile->metadata);
+	for (int channel = 0; channel < gains.size(); channel++)
+	{
+		gains[channel].fill(1);
+	}
+
+	correct(gains, getChannelViews(referenceChannels), item);
+	return gains;
+}
+
+template<typename T>
+void ImageProcessor::processImage(QList<QList<T>>& imageBuffers, const QList<const float*>& referenceChannels, const ProcessingParcel& parcel, int index, TwoPassProcessingState& twoPassProcessingState, const QList<T*>& outputBuffers)
+{
+	const ProcessingItem item = parcel.items[index];
 
-	correct(imageChannels, referenceChannels, item);
+	QList<int> frames(imageBuffers.size());
+	std::iota(frames.begin(), frames.end(), 0);
+	QList<QList<QList<float>>> frameChannels(imageBuffers.size());
+	const qint64 channelsSize = static_cast<qint64>(getChannelSize(item.sourceFile->metadata)) * item.sourceFile->metadata->getChannelsCount() * sizeof(float);
+	const MemoryProfiler::Allocation channelsAllocation(Metrics::Split, channelsSize * frames.size());
 
-	scale(imageChannels, parcel, index, twoPassProcessingState);
+	// Reference channels are normalized when they are prepared, so all frames read the same ones.
+	QtConcurrent::blockingMap(frames, [this, &imageBuffers, &frameChannels, &referenceChannels, &item](int frame)
+		{
+			frameChannels[frame] = createChannels(item.sourceFile->metadata);
+			{
+				const Metrics::StageTimer stageTimer(Metrics::Split);
+				splitImage(imageBuffers[frame], frameChannels[frame], item.sourceFile->metadata);
+			}
 
-	assembleImage(imageChannels, imageBuffer, item.sourceFile->metadata);
+			const Metrics::StageTimer stageTimer(Metrics::Correct);
+			correct(frameChannels[frame], referenceChannels, item);
+		});
+
+	// Float output has no integer range, so there is nothing to clip or scale into.
+	if (!item.sourceFile->metadata->isFloatingPoint())
+	{
+		// Frames are scaled together, otherwise they won't match when merged. Channels are moved to avoid copying them on write.
+		QList<QList<float>> imageChannels;
+		for (int frame = 0; frame < frameChannels.size(); frame++)
+		{
+			for (int channel = 0; channel < frameChannels[frame].size(); channel++)
+			{
+				imageChannels.append(std::move(frameChannels[frame][channel]));
+			}
+		}
+
+		{
+			const Metrics::StageTimer stageTimer(Metrics::Scale);
+			scale(imageChannels, parcel, index, twoPassProcessingState);
+		}
+
+		const int channelsCount = item.sourceFile->metadata->getChannelsCount();
+		for (int i = 0; i < imageChannels.size(); i++)
+		{
+			frameChannels[i / channelsCount][i % channelsCount] = std::move(imageChannels[i]);
+		}
+	}
+
+	QtConcurrent::blockingMap(frames, [this, &imageBuffers, &outputBuffers, &frameChannels, &item](int frame)
+		{
+			const Metrics::StageTimer stageTimer(Metrics::Assemble);
+			assembleImage(frameChannels[frame], outputBuffers.isEmpty() ? imageBuffers[frame].data() : outputBuffers[frame], item.sourceFile->metadata);
+		});
 }
 
+// Channels of several frames can be passed one after another, white levels are taken per channel of a frame. Without the white level limit
+// the range is the full range of the source samples, packed samples can't hold more when they are saved.
 void ImageProcessor::scale(QList<QList<float>>& channels, const ProcessingParcel& parcel, int index, TwoPassProcessingState& twoPassProcessingState)
 {
+	const QSharedPointer<Metadata>& metadata = parcel.items[index].sourceFile->metadata;
 	if (parcel.globalProcessingOptions.scaleChannelsToAvoidClipping)
 	{
 		float imageScale = 1;
@@ -134,7 +266,7 @@ void ImageProcessor::scale(QList<QList<float>>& channels, const ProcessingParcel
 		{
 			for (int i = 0; i < channels.size(); i++)
 			{
-				const float currentChannelScale = calculateScale(channels[i], parcel.globalProcessingOptions.limitToWhiteLevel ? parcel.items[index].sourceFile->metadata->whiteLevels[i] : 0xffff);
+				const float currentChannelScale = calculateScale(channels[i], parcel.globalProcessingOptions.limitToWhiteLevel ? metadata->whiteLevels[i % metadata->getChannelsCount()] : metadata->getMaxValue());
 				if (currentChannelScale < imageScale)
 				{
 					imageScale = currentChannelScale;
@@ -161,7 +293,7 @@ void ImageProcessor::scale(QList<QList<float>>& channels, const ProcessingParcel
 	{
 		for (int i = 0; i < channels.size(); i++)
 		{
-			clipChannel(channels[i], parcel.globalProcessingOptions.limitToWhiteLevel ? parcel.items[index].sourceFile->metadata->whiteLevels[i] : 0xffff);
+			clipChannel(channels[i], parcel.globalProcessingOptions.limitToWhiteLevel ? metadata->whiteLevels[i % metadata->getChannelsCount()] : metadata->getMaxValue());
 		}
 	}
 }
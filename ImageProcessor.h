@@ -20,15 +20,10 @@ class ImageProcessor
 	};
 
 protected:
-	virtual void splitImage(QList<uint16_t>& imageBuffer, QList<QList<float>>& channels, const QSharedPointer<Metadata>& metadata) = 0;
-	virtual void assembleImage(QList<QList<float>>& channels, QList<uint16_t>& imageBuffer, const QSharedPointer<Metadata>& metadata) = 0;
-	virtual void correct(QList<QList<float>>& imageChannels, QList<QList<float>>& referenceChannels, const ProcessingItem& item) = 0;
 	virtual int getChannelHeight(const QSharedPointer<Metadata>& metadata) = 0;
 	virtual int getChannelWidth(const QSharedPointer<Metadata>& metadata) = 0;
 
-	void blurChannels(QList<QList<float>>& channels, const QSharedPointer<Metadata>& metadata, float gaussianBlurSigma);
 	static void blurChannel(OpenCVParcel parcel);
-	static void normalizeChannel(QList<float>& channel);
 	static void scaleChannel(QList<float>& channel, float scale);
 	static void clipChannel(QList<float>& channel, uint16_t maxValue);
 	static float calculateMax(QList<float>& channel);
@@ -36,12 +31,46 @@ protected:
 	static int getActiveAreaHeight(const QSharedPointer<Metadata>& metadata);
 	static int getActiveAreaWidth(const QSharedPointer<Metadata>& metadata);
 
+	template<typename T>
+	QList<QList<float>> createReferenceChannels(QList<T>& referenceBuffer, const ProcessingItem& item);
+	template<typename T>
+	QList<QList<float>> calculateReferenceGains(QList<T>& referenceBuffer, const ProcessingItem& item);
+	template<typename T>
+	void processImage(QList<QList<T>>& imageBuffers, const QList<const float*>& referenceChannels, const ProcessingParcel& parcel, int index, TwoPassProcessingState& twoPassProcessingState, const QList<T*>& outputBuffers);
+
 public:
 	virtual ~ImageProcessor() = default;
 	virtual int getImageDataSize(const QSharedPointer<Metadata>& metadata) = 0;
 
-	void process(QList<uint16_t>& imageBuffer, QList<uint16_t>& referenceBuffer, const ProcessingParcel& parcel, int index, TwoPassProcessingState & twoPassProcessingState);
+	// Every image buffer is one frame of the source file, all frames are corrected with the same reference.
+	// Frames are assembled into the output buffers when they are given, e.g. into the mapped output file, otherwise back into the image buffers.
+	void process(QList<QList<uint16_t>>& imageBuffers, QList<uint16_t>& referenceBuffer, const ProcessingParcel& parcel, int index, TwoPassProcessingState & twoPassProcessingState, const QList<uint16_t*>& outputBuffers = {});
+	void process(QList<QList<float>>& imageBuffers, QList<float>& referenceBuffer, const ProcessingParcel& parcel, int index, TwoPassProcessingState& twoPassProcessingState, const QList<float*>& outputBuffers = {});
+	// Blurred and normalized reference channels which the correction reads. They depend only on the reference, the blur sigma and the source layout,
+	// so they can be prepared once and used for all items with the same reference.
+	QList<QList<float>> prepareReference(QList<uint16_t>& referenceBuffer, const ProcessingItem& item);
+	QList<QList<float>> prepareReference(QList<float>& referenceBuffer, const ProcessingItem& item);
+	// Prepared reference channels are only read, e.g. straight from shared memory. Every one has the channel size of the source.
+	void process(QList<QList<uint16_t>>& imageBuffers, const QList<const float*>& referenceChannels, const ProcessingParcel& parcel, int index, TwoPassProcessingState& twoPassProcessingState, const QList<uint16_t*>& outputBuffers = {});
+	void process(QList<QList<float>>& imageBuffers, const QList<const float*>& referenceChannels, const ProcessingParcel& parcel, int index, TwoPassProcessingState& twoPassProcessingState, const QList<float*>& outputBuffers = {});
+	// Per pixel multipliers which the correction applies to the image channels, used to create gain maps.
+	QList<QList<float>> calculateGains(QList<uint16_t>& referenceBuffer, const ProcessingItem& item);
+	QList<QList<float>> calculateGains(QList<float>& referenceBuffer, const ProcessingItem& item);
 	static void scale(QList<QList<float>>& channels, const ProcessingParcel& parcel, int index, TwoPassProcessingState&
 	                  twoPassProcessingState);
 	int getChannelSize(const QSharedPointer<Metadata>& metadata);
+	static QList<const float*> getChannelViews(const QList<QList<float>>& channels);
+
+	// Stages of process, e.g. for microbenchmarks which run them one by one.
+	QList<QList<float>> createChannels(const QSharedPointer<Metadata>& metadata);
+	virtual void splitImage(QList<uint16_t>& imageBuffer, QList<QList<float>>& channels, const QSharedPointer<Metadata>& metadata) = 0;
+	virtual void assembleImage(QList<QList<float>>& channels, uint16_t* imageBuffer, const QSharedPointer<Metadata>& metadata) = 0;
+	virtual void splitImage(QList<float>& imageBuffer, QList<QList<float>>& channels, const QSharedPointer<Metadata>& metadata) = 0;
+	virtual void assembleImage(QList<QList<float>>& channels, float* imageBuffer, const QSharedPointer<Metadata>& metadata) = 0;
+	// Scales blurred reference channels to 0..1 in the form the correction reads them.
+	virtual void normalizeReference(QList<QList<float>>& referenceChannels, const ProcessingItem& item) = 0;
+	// Reference channels are normalized and only read, so the same ones are used for all frames and items.
+	virtual void correct(QList<QList<float>>& imageChannels, const QList<const float*>& referenceChannels, const ProcessingItem& item) = 0;
+	void blurChannels(QList<QList<float>>& channels, const QSharedPointer<Metadata>& metadata, float gaussianBlurSigma);
+	static void normalizeChannel(QList<float>& channel);
 };
@@ -1,6 +1,27 @@
 ﻿#include "ImageProcessorBayer.h"
 
 void ImageProcessorBayer::splitImage(QList<uint16_t>& imageBuffer, QList<QList<float>>& channels, const QSharedPointer<Metadata>& metadata)
+{
+	splitImageBuffer(imageBuffer, channels, metadata);
+}
+
+void ImageProcessorBayer::assembleImage(QList<QList<float>>& channels, uint16_t* imageBuffer, const QSharedPointer<Metadata>& metadata)
+{
+	assembleImageBuffer(channels, imageBuffer, metadata);
+}
+
+void ImageProcessorBayer::splitImage(QList<float>& imageBuffer, QList<QList<float>>& channels, const QSharedPointer<Metadata>& metadata)
+{
+	splitImageBuffer(imageBuffer, channels, metadata);
+}
+
+void ImageProcessorBayer::assembleImage(QList<QList<float>>& channels, float* imageBuffer, const QSharedPointer<Metadata>& metadata)
+{
+	assembleImageBuffer(channels, imageBuffer, metadata);
+}
+
+template<typename T>
+void ImageProcessorBayer::splitImageBuffer(const QList<T>& imageBuffer, QList<QList<float>>& channels, const QSharedPointer<Metadata>& metadata)
 {
 	const int imageWidth = metadata->imageWidth;
 	const int topOffset = metadata->activeArea[0];
@@ -24,7 +45,8 @@ void ImageProcessorBayer::splitImage(QList<uint16_t>& imageBuffer, QList<QList<f
 	}
 }
 
-void ImageProcessorBayer::assembleImage(QList<QList<float>>& channels, QList<uint16_t>& imageBuffer, const QSharedPointer<Metadata>& metadata)
+template<typename T>
+void ImageProcessorBayer::assembleImageBuffer(QList<QList<float>>& channels, T* imageBuffer, const QSharedPointer<Metadata>& metadata)
 {
 	const int imageWidth = metadata->imageWidth;
 	const int topOffset = metadata->activeArea[0];
@@ -37,22 +59,22 @@ void ImageProcessorBayer::assembleImage(QList<QList<float>>& channels, QList<uin
 	{
 		for (int channelColumn = 0; channelColumn < getChannelWidth(metadata); channelColumn++)
 		{
-			imageBuffer[dataPointer + channelColumn * 2] = (uint16_t)channels[0][channelOffset] + metadata->blackLevels[0];
-			imageBuffer[dataPointer + channelColumn * 2 + 1] = (uint16_t)channels[1][channelOffset] + metadata->blackLevels[1];
-			imageBuffer[dataPointer + imageWidth + channelColumn * 2] = (uint16_t)channels[2][channelOffset] + metadata->blackLevels[2];
-			imageBuffer[dataPointer + imageWidth + channelColumn * 2 + 1] = (uint16_t)channels[3][channelOffset] + metadata->blackLevels[3];
+			imageBuffer[dataPointer + channelColumn * 2] = static_cast<T>(channels[0][channelOffset]) + metadata->blackLevels[0];
+			imageBuffer[dataPointer + channelColumn * 2 + 1] = static_cast<T>(channels[1][channelOffset]) + metadata->blackLevels[1];
+			imageBuffer[dataPointer + imageWidth + channelColumn * 2] = static_cast<T>(channels[2][channelOffset]) + metadata->blackLevels[2];
+			imageBuffer[dataPointer + imageWidth + channelColumn * 2 + 1] = static_cast<T>(channels[3][channelOffset]) + metadata->blackLevels[3];
 			channelOffset++;
 		}
 		dataPointer += imageWidth * 2;
 	}
 }
 
-void ImageProcessorBayer::correct(QList<QList<float>>& imageChannels, QList<QList<float>>& referenceChannels, const ProcessingItem& item)
+void ImageProcessorBayer::normalizeReference(QList<QList<float>>& referenceChannels, const ProcessingItem& item)
 {
 	// Averaging reference green channels, scaling R/B channels to 0..1
 	QList<float> averagedGreenReferenceChannels(getChannelSize(item.sourceFile->metadata));
 	int greenChannels = 0;
-	for (int channel = 0; channel < imageChannels.size(); channel++)
+	for (int channel = 0; channel < referenceChannels.size(); channel++)
 	{
 		if (item.sourceFile->metadata->cfaColorPattern[channel] == Metadata::CFAPatternEnum::Green)
 		{
@@ -77,6 +99,20 @@ void ImageProcessorBayer::correct(QList<QList<float>>& imageChannels, QList<QLis
 
 	normalizeChannel(averagedGreenReferenceChannels);
 
+	// Every green channel shares the data of the average.
+	for (int channel = 0; channel < referenceChannels.size(); channel++)
+	{
+		if (item.sourceFile->metadata->cfaColorPattern[channel] == Metadata::CFAPatternEnum::Green)
+		{
+			referenceChannels[channel] = averagedGreenReferenceChannels;
+		}
+	}
+}
+
+void ImageProcessorBayer::correct(QList<QList<float>>& imageChannels, const QList<const float*>& referenceChannels, const ProcessingItem& item)
+{
+	const float* averagedGreenReferenceChannels = referenceChannels[item.sourceFile->metadata->cfaColorPattern.indexOf(Metadata::CFAPatternEnum::Green)];
+
 	for (int channel = 0; channel < imageChannels.size(); channel++)
 	{
 		//	Correcting luminance.
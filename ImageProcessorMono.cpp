@@ -1,6 +1,27 @@
 ﻿#include "ImageProcessorMono.h"
 
 void ImageProcessorMono::splitImage(QList<uint16_t>& imageBuffer, QList<QList<float>>& channels, const QSharedPointer<Metadata>& metadata)
+{
+	splitImageBuffer(imageBuffer, channels, metadata);
+}
+
+void ImageProcessorMono::assembleImage(QList<QList<float>>& channels, uint16_t* imageBuffer, const QSharedPointer<Metadata>& metadata)
+{
+	assembleImageBuffer(channels, imageBuffer, metadata);
+}
+
+void ImageProcessorMono::splitImage(QList<float>& imageBuffer, QList<QList<float>>& channels, const QSharedPointer<Metadata>& metadata)
+{
+	splitImageBuffer(imageBuffer, channels, metadata);
+}
+
+void ImageProcessorMono::assembleImage(QList<QList<float>>& channels, float* imageBuffer, const QSharedPointer<Metadata>& metadata)
+{
+	assembleImageBuffer(channels, imageBuffer, metadata);
+}
+
+template<typename T>
+void ImageProcessorMono::splitImageBuffer(const QList<T>& imageBuffer, QList<QList<float>>& channels, const QSharedPointer<Metadata>& metadata)
 {
 	const int imageWidth = metadata->imageWidth;
 	const int topOffset = metadata->activeArea[0];
@@ -21,7 +42,8 @@ void ImageProcessorMono::splitImage(QList<uint16_t>& imageBuffer, QList<QList<fl
 	}
 }
 
-void ImageProcessorMono::assembleImage(QList<QList<float>>& channels, QList<uint16_t>& imageBuffer, const QSharedPointer<Metadata>& metadata)
+template<typename T>
+void ImageProcessorMono::assembleImageBuffer(QList<QList<float>>& channels, T* imageBuffer, const QSharedPointer<Metadata>& metadata)
 {
 	const int imageWidth = metadata->imageWidth;
 	const int topOffset = metadata->activeArea[0];
@@ -34,7 +56,7 @@ void ImageProcessorMono::assembleImage(QList<QList<float>>& channels, QList<uint
 	{
 		for (int channelColumn = 0; channelColumn < getChannelWidth(metadata); channelColumn++)
 		{
-			imageBuffer[dataPointer + channelColumn] = (uint16_t)channels[0][channelOffset] + metadata->blackLevels[0];
+			imageBuffer[dataPointer + channelColumn] = static_cast<T>(channels[0][channelOffset]) + metadata->blackLevels[0];
 
 			channelOffset++;
 		}
@@ -42,10 +64,13 @@ void ImageProcessorMono::assembleImage(QList<QList<float>>& channels, QList<uint
 	}
 }
 
-void ImageProcessorMono::correct(QList<QList<float>>& imageChannels, QList<QList<float>>& referenceChannels, const ProcessingItem& item)
+void ImageProcessorMono::normalizeReference(QList<QList<float>>& referenceChannels, const ProcessingItem& item)
 {
 	normalizeChannel(referenceChannels[0]);
+}
 
+void ImageProcessorMono::correct(QList<QList<float>>& imageChannels, const QList<const float*>& referenceChannels, const ProcessingItem& item)
+{
 	if (item.processingOptions.luminanceCorrectionIntensity > 0.0f)
 	{
 		for (int i = 0; i < imageChannels[0].size(); i++)
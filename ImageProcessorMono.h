@@ -3,10 +3,18 @@
 
 class ImageProcessorMono : public ImageProcessor
 {
+	template<typename T>
+	void splitImageBuffer(const QList<T>& imageBuffer, QList<QList<float>>& channels, const QSharedPointer<Metadata>& metadata);
+	template<typename T>
+	void assembleImageBuffer(QList<QList<float>>& channels, T* imageBuffer, const QSharedPointer<Metadata>& metadata);
+
 protected:
 	void splitImage(QList<uint16_t>& imageBuffer, QList<QList<float>>& channels, const QSharedPointer<Metadata>& metadata) override;
-	void assembleImage(QList<QList<float>>& channels, QList<uint16_t>& imageBuffer, const QSharedPointer<Metadata>& metadata) override;
-	void correct(QList<QList<float>>& imageChannels, QList<QList<float>>& referenceChannels, const ProcessingItem& item) override;
+	void assembleImage(QList<QList<float>>& channels, uint16_t* imageBuffer, const QSharedPointer<Metadata>& metadata) override;
+	void splitImage(QList<float>& imageBuffer, QList<QList<float>>& channels, const QSharedPointer<Metadata>& metadata) override;
+	void assembleImage(QList<QList<float>>& channels, float* imageBuffer, const QSharedPointer<Metadata>& metadata) override;
+	void normalizeReference(QList<QList<float>>& referenceChannels, const ProcessingItem& item) override;
+	void correct(QList<QList<float>>& imageChannels, const QList<const float*>& referenceChannels, const ProcessingItem& item) override;
 	int getChannelHeight(const QSharedPointer<Metadata>& metadata) override;
 	int getChannelWidth(const QSharedPointer<Metadata>& metadata) override;
 
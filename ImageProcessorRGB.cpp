@@ -1,6 +1,27 @@
 ﻿#include "ImageProcessorRGB.h"
 
 void ImageProcessorRGB::splitImage(QList<uint16_t>& imageBuffer, QList<QList<float>>& channels, const QSharedPointer<Metadata>& metadata)
+{
+	splitImageBuffer(imageBuffer, channels, metadata);
+}
+
+void ImageProcessorRGB::assembleImage(QList<QList<float>>& channels, uint16_t* imageBuffer, const QSharedPointer<Metadata>& metadata)
+{
+	assembleImageBuffer(channels, imageBuffer, metadata);
+}
+
+void ImageProcessorRGB::splitImage(QList<float>& imageBuffer, QList<QList<float>>& channels, const QSharedPointer<Metadata>& metadata)
+{
+	splitImageBuffer(imageBuffer, channels, metadata);
+}
+
+void ImageProcessorRGB::assembleImage(QList<QList<float>>& channels, float* imageBuffer, const QSharedPointer<Metadata>& metadata)
+{
+	assembleImageBuffer(channels, imageBuffer, metadata);
+}
+
+template<typename T>
+void ImageProcessorRGB::splitImageBuffer(const QList<T>& imageBuffer, QList<QList<float>>& channels, const QSharedPointer<Metadata>& metadata)
 {
 	const int imageWidth = metadata->imageWidth;
 	const int topOffset = metadata->activeArea[0];
@@ -23,7 +44,8 @@ void ImageProcessorRGB::splitImage(QList<uint16_t>& imageBuffer, QList<QList<flo
 	}
 }
 
-void ImageProcessorRGB::assembleImage(QList<QList<float>>& channels, QList<uint16_t>& imageBuffer, const QSharedPointer<Metadata>& metadata)
+template<typename T>
+void ImageProcessorRGB::assembleImageBuffer(QList<QList<float>>& channels, T* imageBuffer, const QSharedPointer<Metadata>& metadata)
 {
 	const int imageWidth = metadata->imageWidth;
 	const int topOffset = metadata->activeArea[0];
@@ -36,9 +58,9 @@ void ImageProcessorRGB::assembleImage(QList<QList<float>>& channels, QList<uint1
 	{
 		for (int channelColumn = 0; channelColumn < getChannelWidth(metadata); channelColumn++)
 		{
-			imageBuffer[dataPointer + channelColumn * 3] = (uint16_t)channels[0][channelOffset] + metadata->blackLevels[0];
-			imageBuffer[dataPointer + channelColumn * 3 + 1] = (uint16_t)channels[1][channelOffset] + metadata->blackLevels[1];
-			imageBuffer[dataPointer + channelColumn * 3 + 2] = (uint16_t)channels[2][channelOffset] + metadata->blackLevels[2];
+			imageBuffer[dataPointer + channelColumn * 3] = static_cast<T>(channels[0][channelOffset]) + metadata->blackLevels[0];
+			imageBuffer[dataPointer + channelColumn * 3 + 1] = static_cast<T>(channels[1][channelOffset]) + metadata->blackLevels[1];
+			imageBuffer[dataPointer + channelColumn * 3 + 2] = static_cast<T>(channels[2][channelOffset]) + metadata->blackLevels[2];
 
 			channelOffset++;
 		}
@@ -46,13 +68,16 @@ void ImageProcessorRGB::assembleImage(QList<QList<float>>& channels, QList<uint1
 	}
 }
 
-void ImageProcessorRGB::correct(QList<QList<float>>& imageChannels, QList<QList<float>>& referenceChannels, const ProcessingItem& item)
+void ImageProcessorRGB::normalizeReference(QList<QList<float>>& referenceChannels, const ProcessingItem& item)
 {
 	for (int i = 0; i < referenceChannels.size(); i++)
 	{
 		normalizeChannel(referenceChannels[i]);
 	}
+}
 
+void ImageProcessorRGB::correct(QList<QList<float>>& imageChannels, const QList<const float*>& referenceChannels, const ProcessingItem& item)
+{
 	for (int channel = 0; channel < imageChannels.size(); channel++)
 	{
 		//	Correcting luminance.
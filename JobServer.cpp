@@ -0,0 +1,288 @@
+#include <QJsonArray>
+#include <QJsonDocument>
+#include "JobServer.h"
+#include "Metrics.h"
+
+JobServer::JobServer(QObject* parent) : QObject(parent)
+{
+	connect(&server, &QLocalServer::newConnection, this, &JobServer::slotNewConnection);
+}
+
+bool JobServer::listen(const QString& serverName)
+{
+	// Server of a crashed previous run would block the name.
+	QLocalServer::removeServer(serverName);
+	return server.listen(serverName);
+}
+
+QString JobServer::getServerName() const
+{
+	return server.fullServerName();
+}
+
+void JobServer::slotNewConnection()
+{
+	while (server.hasPendingConnections())
+	{
+		QLocalSocket* client = server.nextPendingConnection();
+		connect(client, &QLocalSocket::readyRead, this, [this, client]()
+		{
+			// Data without a line end would be buffered without limit, so too long lines are not waited for.
+			while (client->canReadLine() || client->bytesAvailable() > maxRequestSize)
+			{
+				const QByteArray line = client->readLine(maxRequestSize + 1);
+				if (line.size() > maxRequestSize)
+				{
+					QJsonObject reply;
+					reply["type"] = "error";
+					reply["message"] = "Request is too long";
+					send(client, reply);
+					client->abort();
+					return;
+				}
+
+				handle(client, QJsonDocument::fromJson(line).object());
+			}
+		});
+		connect(client, &QLocalSocket::disconnected, this, [this, client]()
+		{
+			// Jobs of a disconnected client keep running, their state can be requested from another connection.
+			for (const QSharedPointer<Job>& job : jobs)
+			{
+				if (job->client == client)
+				{
+					job->client = nullptr;
+				}
+			}
+			client->deleteLater();
+		});
+	}
+}
+
+void JobServer::handle(QLocalSocket* client, const QJsonObject& request)
+{
+	const QString type = request["type"].toString();
+	QJsonObject reply;
+	if (type == "submit")
+	{
+		reply = submit(client, request);
+	}
+	else if (type == "status" || type == "cancel")
+	{
+		const QSharedPointer<Job> job = findJob(request);
+		if (job == nullptr)
+		{
+			reply["type"] = "error";
+			reply["message"] = "Unknown job";
+		}
+		else
+		{
+			reply = type == "status" ? getStatus(job) : cancel(job);
+		}
+	}
+	else if (type == "metrics")
+	{
+		reply["type"] = "metrics";
+		reply["metrics"] = Metrics::getSnapshot();
+	}
+	else
+	{
+		reply["type"] = "error";
+		reply["message"] = "Unknown request type";
+	}
+
+	send(client, reply);
+
+	if (type == "submit" && runningJob == nullptr)
+	{
+		startNextJob();
+	}
+}
+
+QJsonObject JobServer::submit(QLocalSocket* client, const QJsonObject& request)
+{
+	QJsonObject reply;
+	reply["type"] = "error";
+
+	const QSharedPointer<Job> job(new Job());
+	job->settings.reset(new Settings(request["job"].toObject()));
+	if (job->settings->sourceFilesRoot.isEmpty() || job->settings->referenceMatcherOptions.referenceFilesRoot.isEmpty())
+	{
+		reply["message"] = "Source and reference folders must be set";
+		return reply;
+	}
+	if (job->settings->savingOptions.saveTo == SavingOptions::SaveToEnum::Folder && job->settings->savingOptions.saveToFolderPath.isEmpty())
+	{
+		reply["message"] = "Output folder must be set";
+		return reply;
+	}
+
+	for (const QJsonValue& file : request["files"].toArray())
+	{
+		job->files.append(file.toString());
+	}
+	job->rebuildReferences = request["rebuildReferences"].toBool();
+	job->id = nextId++;
+	job->client = client;
+	jobs.append(job);
+
+	reply["type"] = "accepted";
+	reply["job"] = job->id;
+	return reply;
+}
+
+QJsonObject JobServer::getStatus(const QSharedPointer<Job>& job) const
+{
+	QJsonObject status = job->counts;
+	status["type"] = "status";
+	status["job"] = job->id;
+	status["state"] = job->state;
+	return status;
+}
+
+QJsonObject JobServer::cancel(const QSharedPointer<Job>& job)
+{
+	if (job->state == "queued")
+	{
+		job->state = "cancelled";
+	}
+	else if (job == runningJob && job->state == "running")
+	{
+		// Final state is set when the current file is done.
+		job->state = "cancelling";
+		runner->stop();
+	}
+
+	return getStatus(job);
+}
+
+QSharedPointer<JobServer::Job> JobServer::findJob(const QJsonObject& request) const
+{
+	const int id = request["job"].toInt();
+	for (const QSharedPointer<Job>& job : jobs)
+	{
+		if (job->id == id)
+		{
+			return job;
+		}
+	}
+
+	return nullptr;
+}
+
+void JobServer::startNextJob()
+{
+	// Finishing a job drops old ones from the list, so the next queued job is searched from the start every time.
+	while (true)
+	{
+		QSharedPointer<Job> job;
+		for (int i = 0; i < jobs.size() && job == nullptr; i++)
+		{
+			if (jobs[i]->state == "queued")
+			{
+				job = jobs[i];
+			}
+		}
+		if (job == nullptr)
+		{
+			return;
+		}
+
+		runningJob = job;
+		job->state = "running";
+		runner = new BatchRunner(*job->settings, false);
+		connect(runner, &BatchRunner::signalResult, this, &JobServer::slotResult);
+		connect(runner, &BatchRunner::signalFinished, this, &JobServer::slotFinished);
+
+		QSharedPointer<ReferenceFiles>& jobReferenceFiles = referenceFiles[job->settings->referenceMatcherOptions.referenceFilesRoot];
+		if (jobReferenceFiles == nullptr || job->rebuildReferences)
+		{
+			jobReferenceFiles = BatchRunner::loadReferenceFiles(job->settings->referenceMatcherOptions.referenceFilesRoot, job->rebuildReferences);
+		}
+
+		if (!runner->setReferences(jobReferenceFiles))
+		{
+			QJsonObject message;
+			message["type"] = "error";
+			message["job"] = job->id;
+			message["message"] = "No reference files found";
+			if (job->client != nullptr)
+			{
+				send(job->client, message);
+			}
+			finishJob("failed");
+			continue;
+		}
+
+		// Files are scanned in a pool thread, the job is processed once the scan finishes.
+		if (job->files.isEmpty())
+		{
+			runner->start();
+		}
+		else
+		{
+			runner->start(job->files);
+		}
+		return;
+	}
+}
+
+void JobServer::slotResult(const QJsonObject& result)
+{
+	if (runningJob == nullptr)
+	{
+		return;
+	}
+
+	QJsonObject message = result;
+	message["type"] = result.contains("summary") ? "summary" : "result";
+	message["job"] = runningJob->id;
+
+	const QString status = result["status"].toString();
+	if (!status.isEmpty())
+	{
+		runningJob->counts[status] = runningJob->counts[status].toInt() + 1;
+	}
+
+	if (runningJob->client != nullptr)
+	{
+		send(runningJob->client, message);
+	}
+}
+
+void JobServer::slotFinished()
+{
+	finishJob(runningJob->state == "cancelling" ? "cancelled" : "finished");
+	startNextJob();
+}
+
+void JobServer::finishJob(const QString& state)
+{
+	const QSharedPointer<Job> job = runningJob;
+	job->state = state;
+	runningJob.reset();
+	runner->deleteLater();
+	runner = nullptr;
+
+	QJsonObject message = getStatus(job);
+	message["type"] = "finished";
+	if (job->client != nullptr)
+	{
+		send(job->client, message);
+	}
+
+	int finishedJobsCount = 0;
+	for (int i = jobs.size() - 1; i >= 0; i--)
+	{
+		if (jobs[i]->state != "queued" && jobs[i] != runningJob && ++finishedJobsCount > maxFinishedJobs)
+		{
+			jobs.removeAt(i);
+		}
+	}
+}
+
+void JobServer::send(QLocalSocket* client, const QJsonObject& message)
+{
+	client->write(QJsonDocument(message).toJson(QJsonDocument::Compact) + '\n');
+	client->flush();
+}
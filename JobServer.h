@@ -0,0 +1,68 @@
+#pragma once
+#include <QHash>
+#include <QJsonObject>
+#include <QList>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QObject>
+#include <QSharedPointer>
+
+#include "BatchRunner.h"
+#include "Settings.h"
+
+// Job submission server of the command line runner, for applications which queue corrections without the UI. Clients connect to a
+// local socket and exchange JSON objects, one per line:
+// - submit queues a job with the same values as a job file, optionally with the list of files instead of the whole source folder,
+// - status returns the state and counts of a job,
+// - cancel removes a queued job or stops a running one after its current file.
+// - metrics returns the snapshot of the engine metrics.
+// Results of the files and the summary of a job are streamed to the connection which submitted it. Jobs run one after another in this
+// process, so they share its thread pool and caches. Reference DBs are loaded once per reference folder, rebuildReferences reloads it.
+// Clients which send a line longer than the limit are disconnected.
+class JobServer : public QObject
+{
+	Q_OBJECT
+
+	struct Job
+	{
+		int id = 0;
+		QSharedPointer<Settings> settings;
+		QStringList files;
+		bool rebuildReferences = false;
+		QString state = "queued";
+		QJsonObject counts;
+		QLocalSocket* client = nullptr;
+	};
+
+	// Finished jobs are kept for status requests, the oldest ones are dropped.
+	static constexpr int maxFinishedJobs = 100;
+	// Requests list the files of a job, so the limit leaves room for large batches.
+	static constexpr qint64 maxRequestSize = 16 * 1024 * 1024;
+
+	QLocalServer server;
+	QList<QSharedPointer<Job>> jobs;
+	QSharedPointer<Job> runningJob;
+	BatchRunner* runner = nullptr;
+	QHash<QString, QSharedPointer<ReferenceFiles>> referenceFiles;
+	int nextId = 1;
+
+	void handle(QLocalSocket* client, const QJsonObject& request);
+	QJsonObject submit(QLocalSocket* client, const QJsonObject& request);
+	QJsonObject getStatus(const QSharedPointer<Job>& job) const;
+	QJsonObject cancel(const QSharedPointer<Job>& job);
+	QSharedPointer<Job> findJob(const QJsonObject& request) const;
+	void startNextJob();
+	void finishJob(const QString& state);
+	static void send(QLocalSocket* client, const QJsonObject& message);
+
+private slots:
+	void slotNewConnection();
+	void slotResult(const QJsonObject& result);
+	void slotFinished();
+
+public:
+	explicit JobServer(QObject* parent = nullptr);
+
+	bool listen(const QString& serverName);
+	QString getServerName() const;
+};
@@ -0,0 +1,260 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <QElapsedTimer>
+#include "KernelBenchmark.h"
+#include "ImageProcessor.h"
+#include "Processor.h"
+
+const char* KernelBenchmark::getName(KernelEnum kernel)
+{
+	static const char* names[KernelsCount] = { "split", "normalize", "correct", "blur", "scale", "assemble" };
+	return names[kernel];
+}
+
+const char* KernelBenchmark::getName(Metadata::RawTypeEnum layout)
+{
+	switch (layout)
+	{
+	case Metadata::Mono:
+		return "mono";
+	case Metadata::RGB:
+		return "rgb";
+	case Metadata::Bayer:
+		return "bayer";
+	default:
+		return "unknown";
+	}
+}
+
+double KernelBenchmark::getBytesPerSample(KernelEnum kernel)
+{
+	switch (kernel)
+	{
+	case Split:
+		// 16 bit sample read, float channel value written.
+		return 6;
+	case Normalize:
+		// Maximum of the channel is found in one pass, then every value is divided by it.
+		return 12;
+	case Correct:
+		// Image values are read with the normalized reference and written.
+		return 12;
+	case Blur:
+		// Rows of the separable filter stay in cache, so every value is read and written once.
+		return 8;
+	case Scale:
+		// Channel maximums give the scale to the white level, then every value is multiplied by it.
+		return 12;
+	case Assemble:
+		// Float channel value read, 16 bit sample written.
+		return 6;
+	default:
+		return 0;
+	}
+}
+
+QSize KernelBenchmark::getFrameSize(int megapixels)
+{
+	// 3:2 frame with even sides, so Bayer channels cover the whole image.
+	const double pixels = megapixels * 1000000.0;
+	const int width = qRound(std::sqrt(pixels * 3 / 2)) & ~1;
+	return QSize(width, qRound(pixels / width) & ~1);
+}
+
+QSharedPointer<Metadata> KernelBenchmark::createMetadata(Metadata::RawTypeEnum layout, int megapixels)
+{
+	const QSize frameSize = getFrameSize(megapixels);
+	const int width = frameSize.width();
+	const int height = frameSize.height();
+
+	QSharedPointer<Metadata> metadata(new Metadata());
+	metadata->cameraMaker = "Benchmark";
+	metadata->cameraModel = "Synthetic";
+	metadata->rawType = layout;
+	metadata->imageWidth = width;
+	metadata->imageHeight = height;
+	metadata->activeArea = { 0, 0, height, width };
+	metadata->blackLevels = { 512, 512, 512, 512 };
+	metadata->whiteLevels = { 16383, 16383, 16383, 16383 };
+	metadata->cfaColorPattern = { Metadata::Red, Metadata::Green, Metadata::Green, Metadata::Blue };
+	metadata->bitsPerSample = 14;
+	return metadata;
+}
+
+QList<QList<float>> KernelBenchmark::copyChannels(const QList<QList<float>>& channels)
+{
+	QList<QList<float>> copy = channels;
+	for (QList<float>& channel : copy)
+	{
+		channel.detach();
+	}
+	return copy;
+}
+
+QList<qint64> KernelBenchmark::measure(int repeats, const std::function<void()>& setup, const std::function<void()>& kernel)
+{
+	QList<qint64> durations;
+	for (int repeat = 0; repeat < repeats; repeat++)
+	{
+		setup();
+
+		QElapsedTimer timer;
+		timer.start();
+		kernel();
+		durations.append(timer.nsecsElapsed());
+	}
+	return durations;
+}
+
+double KernelBenchmark::measureMemoryBandwidth()
+{
+	const qsizetype size = bandwidthBufferSize / sizeof(float);
+	QList<float> source(size, 1);
+	QList<float> destination(size, 0);
+
+	// First copy faults the pages in, the best of the following ones is taken.
+	qint64 bestDuration = 0;
+	for (int repeat = 0; repeat < 4; repeat++)
+	{
+		QElapsedTimer timer;
+		timer.start();
+		std::memcpy(destination.data(), source.constData(), size * sizeof(float));
+		const qint64 duration = timer.nsecsElapsed();
+		if (repeat > 0 && (bestDuration == 0 || duration < bestDuration))
+		{
+			bestDuration = duration;
+		}
+	}
+
+	return bestDuration > 0 ? 2.0 * bandwidthBufferSize / bestDuration : 0;
+}
+
+void KernelBenchmark::run(const Options& options, double memoryBandwidth, const std::function<void(const QJsonObject&)>& report)
+{
+	for (const Metadata::RawTypeEnum layout : options.layouts)
+	{
+		for (const int megapixels : options.megapixels)
+		{
+			const QSharedPointer<Metadata> metadata = createMetadata(layout, megapixels);
+			ImageProcessor* imageProcessor = Processor::getImageProcessor(layout);
+
+			// Values vary from sample to sample, so no kernel can take a shortcut on flat data.
+			QList<uint16_t> imageBuffer(imageProcessor->getImageDataSize(metadata));
+			for (qsizetype i = 0; i < imageBuffer.size(); i++)
+			{
+				imageBuffer[i] = static_cast<uint16_t>(metadata->blackLevels[0] + 1 + (i * 7919) % 12000);
+			}
+			QList<uint16_t> outputBuffer(imageBuffer.size());
+
+			QList<QList<float>> channels = imageProcessor->createChannels(metadata);
+			imageProcessor->splitImage(imageBuffer, channels, metadata);
+			QList<QList<float>> referenceChannels = imageProcessor->createChannels(metadata);
+			for (QList<float>& channel : referenceChannels)
+			{
+				for (qsizetype i = 0; i < channel.size(); i++)
+				{
+					channel[i] = 4000 + static_cast<float>(i % 4096);
+				}
+			}
+
+			ProcessingOptions processingOptions;
+			processingOptions.luminanceCorrectionIntensity = 1;
+			processingOptions.colorCorrectionIntensity = 1;
+			const ProcessingItem item(QSharedPointer<FileInfo>(new FileInfo("", metadata)), QSharedPointer<FileInfo>(new FileInfo("", metadata)), processingOptions);
+			GlobalProcessingOptions globalProcessingOptions;
+			globalProcessingOptions.scaleChannelsToAvoidClipping = true;
+			globalProcessingOptions.calculateCommonScaleForBatch = false;
+			const ProcessingParcel parcel({ item }, "", globalProcessingOptions, SavingOptions());
+
+			const qint64 pixels = static_cast<qint64>(metadata->imageWidth) * metadata->imageHeight;
+			const qint64 samples = pixels * metadata->getSamplesPerPixel();
+			QList<QList<float>> workChannels;
+			// Reference is normalized once when it is prepared, the correction only reads it.
+			QList<QList<float>> normalizedReferenceChannels = copyChannels(referenceChannels);
+			imageProcessor->normalizeReference(normalizedReferenceChannels, item);
+			const QList<const float*> normalizedReferenceViews = ImageProcessor::getChannelViews(normalizedReferenceChannels);
+
+			for (const KernelEnum kernel : options.kernels)
+			{
+				const QList<float> sigmas = kernel == Blur ? options.sigmas : QList<float>({ 0 });
+				for (const float sigma : sigmas)
+				{
+					QList<qint64> durations;
+					switch (kernel)
+					{
+					case Split:
+						durations = measure(options.repeats, []() {}, [&]() { imageProcessor->splitImage(imageBuffer, channels, metadata); });
+						break;
+					case Normalize:
+						durations = measure(options.repeats, [&]() { workChannels = copyChannels(channels); }, [&]()
+							{
+								for (QList<float>& channel : workChannels)
+								{
+									ImageProcessor::normalizeChannel(channel);
+								}
+							});
+						break;
+					case Correct:
+						durations = measure(options.repeats, [&]() { workChannels = copyChannels(channels); }, [&]() { imageProcessor->correct(workChannels, normalizedReferenceViews, item); });
+						break;
+					case Blur:
+						durations = measure(options.repeats, [&]() { workChannels = copyChannels(referenceChannels); }, [&]() { imageProcessor->blurChannels(workChannels, metadata, sigma); });
+						break;
+					case Scale:
+						durations = measure(options.repeats, [&]() { workChannels = copyChannels(channels); }, [&]()
+							{
+								TwoPassProcessingState twoPassProcessingState;
+								ImageProcessor::scale(workChannels, parcel, 0, twoPassProcessingState);
+							});
+						break;
+					case Assemble:
+						durations = measure(options.repeats, []() {}, [&]() { imageProcessor->assembleImage(channels, outputBuffer.data(), metadata); });
+						break;
+					default:
+						break;
+					}
+					workChannels.clear();
+
+					if (durations.isEmpty())
+					{
+						continue;
+					}
+
+					const qint64 bestDuration = qMax<qint64>(1, *std::min_element(durations.begin(), durations.end()));
+					qint64 totalDuration = 0;
+					for (const qint64 duration : durations)
+					{
+						totalDuration += duration;
+					}
+
+					// Bytes per nanosecond are gigabytes per second.
+					const double gigabytesPerSecond = samples * getBytesPerSample(kernel) / bestDuration;
+					QJsonObject result;
+					result["type"] = "kernel";
+					result["kernel"] = getName(kernel);
+					result["layout"] = getName(layout);
+					result["megapixels"] = megapixels;
+					result["width"] = metadata->imageWidth;
+					result["height"] = metadata->imageHeight;
+					if (kernel == Blur)
+					{
+						result["sigma"] = sigma;
+					}
+					result["repeats"] = durations.size();
+					result["bestMs"] = bestDuration / 1000000.0;
+					result["meanMs"] = totalDuration / 1000000.0 / durations.size();
+					result["mpixPerSecond"] = pixels * 1000.0 / bestDuration;
+					result["gbPerSecond"] = gigabytesPerSecond;
+					if (memoryBandwidth > 0)
+					{
+						result["bandwidthFraction"] = gigabytesPerSecond / memoryBandwidth;
+					}
+					report(result);
+				}
+			}
+
+			delete imageProcessor;
+		}
+	}
+}
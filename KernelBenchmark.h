@@ -0,0 +1,56 @@
+#pragma once
+#include <functional>
+#include <QJsonObject>
+#include <QList>
+#include <QSize>
+
+#include "DataStructs.h"
+
+// Microbenchmarks of the pixel processing stages of ImageProcessor on synthetic images. Every kernel runs on the full image of the
+// layout and size, the best of the repeats is reported as throughput in megapixels and gigabytes per second. Bytes are the minimal
+// memory traffic of the kernel, so the fraction of the memory bandwidth shows how far a kernel is from being memory bound.
+class KernelBenchmark
+{
+public:
+	enum KernelEnum
+	{
+		Split,
+		Normalize,
+		Correct,
+		Blur,
+		Scale,
+		Assemble,
+		KernelsCount
+	};
+
+	struct Options
+	{
+		QList<Metadata::RawTypeEnum> layouts = { Metadata::Mono, Metadata::RGB, Metadata::Bayer };
+		QList<int> megapixels = { 12, 24, 45, 61, 102, 150 };
+		// Only the blur depends on the sigma, other kernels run once per image.
+		QList<float> sigmas = { 1, 10, 100, 1000 };
+		QList<KernelEnum> kernels = { Split, Normalize, Correct, Blur, Scale, Assemble };
+		int repeats = 3;
+	};
+
+private:
+	// Memory bandwidth is measured on buffers much larger than the last level cache.
+	static constexpr qint64 bandwidthBufferSize = 512 * 1024 * 1024;
+
+	static QSharedPointer<Metadata> createMetadata(Metadata::RawTypeEnum layout, int megapixels);
+	static double getBytesPerSample(KernelEnum kernel);
+	// Kernels work in place, so every repeat starts from a fresh copy which is not measured.
+	static QList<QList<float>> copyChannels(const QList<QList<float>>& channels);
+	// Durations of the kernel in nanoseconds, the setup runs before every repeat and is not measured.
+	static QList<qint64> measure(int repeats, const std::function<void()>& setup, const std::function<void()>& kernel);
+
+public:
+	static const char* getName(KernelEnum kernel);
+	static const char* getName(Metadata::RawTypeEnum layout);
+	// Synthetic images of all benchmarks have the same frame for the same size in megapixels.
+	static QSize getFrameSize(int megapixels);
+	// Copy bandwidth of the main memory in GB/s, bytes read and written are both counted.
+	static double measureMemoryBandwidth();
+	// Results are reported one by one as they are measured, sweeps over large images take a while.
+	static void run(const Options& options, double memoryBandwidth, const std::function<void(const QJsonObject&)>& report);
+};
@@ -0,0 +1,797 @@
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include "LosslessJpeg.h"
+
+namespace
+{
+	enum MarkerEnum
+	{
+		SOF3 = 0xffc3,
+		DHT = 0xffc4,
+		RST0 = 0xffd0,
+		RST7 = 0xffd7,
+		SOI = 0xffd8,
+		EOI = 0xffd9,
+		SOS = 0xffda,
+		DRI = 0xffdd
+	};
+}
+
+LosslessJpeg::LosslessJpeg(const char* data, qint64 size)
+{
+	this->data = reinterpret_cast<const uint8_t*>(data);
+	this->size = size;
+}
+
+bool LosslessJpeg::decode(const char* data, qint64 size, const OutputTile& tile)
+{
+	LosslessJpeg decoder(data, size);
+
+	int marker = 0;
+	if (!decoder.readMarker(&marker) || marker != MarkerEnum::SOI)
+	{
+		return false;
+	}
+
+	while (decoder.readMarker(&marker))
+	{
+		switch (marker)
+		{
+			case MarkerEnum::SOF3:
+				if (!decoder.readFrameHeader())
+				{
+					return false;
+				}
+				break;
+			case MarkerEnum::DHT:
+				if (!decoder.readHuffmanTables())
+				{
+					return false;
+				}
+				break;
+			case MarkerEnum::DRI:
+				if (!decoder.readRestartInterval())
+				{
+					return false;
+				}
+				break;
+			case MarkerEnum::SOS:
+				return decoder.readScan(tile);
+			case MarkerEnum::EOI:
+				return false;
+			default:
+				// Other frame types are not lossless huffman coded, everything else (APPn, COM) is skipped.
+				if (marker >= 0xffc0 && marker <= 0xffcf)
+				{
+					return false;
+				}
+
+				const int length = decoder.readUint16();
+				if (length < 2 || decoder.position + length - 2 > decoder.size)
+				{
+					return false;
+				}
+				decoder.position += length - 2;
+		}
+	}
+
+	return false;
+}
+
+bool LosslessJpeg::readMarker(int* marker)
+{
+	if (position + 1 >= size || data[position] != 0xff)
+	{
+		return false;
+	}
+
+	while (position < size && data[position] == 0xff)
+	{
+		position++;
+	}
+
+	if (position >= size)
+	{
+		return false;
+	}
+
+	*marker = 0xff00 | data[position++];
+	return true;
+}
+
+int LosslessJpeg::readUint16()
+{
+	if (position + 2 > size)
+	{
+		return -1;
+	}
+
+	const int value = data[position] << 8 | data[position + 1];
+	position += 2;
+	return value;
+}
+
+bool LosslessJpeg::readFrameHeader()
+{
+	const int length = readUint16();
+	if (length < 8 || position + length - 2 > size)
+	{
+		return false;
+	}
+
+	precision = data[position];
+	height = data[position + 1] << 8 | data[position + 2];
+	width = data[position + 3] << 8 | data[position + 4];
+	const int componentsCount = data[position + 5];
+	position += 6;
+
+	if (precision < 2 || precision > 16 || height == 0 || width == 0 || componentsCount == 0 || length != 8 + componentsCount * 3)
+	{
+		return false;
+	}
+
+	components.resize(componentsCount);
+	for (int i = 0; i < componentsCount; i++)
+	{
+		// Subsampled components are not used in DNG.
+		if (data[position + 1] != 0x11)
+		{
+			return false;
+		}
+
+		components[i].id = data[position];
+		position += 3;
+	}
+
+	return true;
+}
+
+bool LosslessJpeg::readHuffmanTables()
+{
+	const int length = readUint16();
+	if (length < 2 || position + length - 2 > size)
+	{
+		return false;
+	}
+
+	const qint64 end = position + length - 2;
+	while (position < end)
+	{
+		const int tableId = data[position] & 0x0f;
+		if (data[position] >> 4 != 0 || tableId > 3 || position + 17 > end)
+		{
+			return false;
+		}
+
+		HuffmanTable& table = huffmanTables[tableId];
+		table = HuffmanTable();
+		const uint8_t* counts = data + position + 1;
+		position += 17;
+
+		int valuesCount = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			valuesCount += counts[i];
+		}
+
+		if (valuesCount > 256 || position + valuesCount > end)
+		{
+			return false;
+		}
+
+		memcpy(table.values, data + position, valuesCount);
+		table.valuesCount = valuesCount;
+		position += valuesCount;
+
+		// Canonical code assignment from ITU T.81 Annex C.
+		int code = 0;
+		int valueIndex = 0;
+		for (int length = 1; length <= 16; length++)
+		{
+			table.valueOffset[length] = valueIndex - code;
+			for (int i = 0; i < counts[length - 1]; i++)
+			{
+				// Malformed tables have more codes than fit into the length, they would be written out of the lookup.
+				if (code >= 1 << length)
+				{
+					return false;
+				}
+
+				if (length <= 8)
+				{
+					const int shift = 8 - length;
+					for (int suffix = 0; suffix < 1 << shift; suffix++)
+					{
+						table.lookupLength[code << shift | suffix] = length;
+						table.lookupValue[code << shift | suffix] = table.values[valueIndex];
+					}
+				}
+				code++;
+				valueIndex++;
+			}
+			table.maxCode[length] = counts[length - 1] != 0 ? code - 1 : -1;
+			code <<= 1;
+		}
+
+		table.isDefined = true;
+	}
+
+	return true;
+}
+
+bool LosslessJpeg::readRestartInterval()
+{
+	if (readUint16() != 4)
+	{
+		return false;
+	}
+
+	restartInterval = readUint16();
+	return restartInterval >= 0;
+}
+
+bool LosslessJpeg::readScan(const OutputTile& tile)
+{
+	const int length = readUint16();
+	if (length < 6 || position + length - 2 > size || components.isEmpty())
+	{
+		return false;
+	}
+
+	const int componentsCount = data[position++];
+	if (componentsCount != components.size() || length != 6 + componentsCount * 2)
+	{
+		return false;
+	}
+
+	for (int i = 0; i < componentsCount; i++)
+	{
+		const int tableId = data[position + 1] >> 4;
+		if (data[position] != components[i].id || tableId > 3 || !huffmanTables[tableId].isDefined)
+		{
+			return false;
+		}
+
+		components[i].huffmanTable = tableId;
+		position += 2;
+	}
+
+	const int predictor = data[position];
+	const int pointTransform = data[position + 2] & 0x0f;
+	position += 3;
+
+	if (predictor < 1 || predictor > 7 || pointTransform >= precision)
+	{
+		return false;
+	}
+
+	const int lineSamples = width * componentsCount;
+	QList<uint16_t> previousLine(lineSamples);
+	QList<uint16_t> currentLine(lineSamples);
+	const int initialPrediction = 1 << (precision - pointTransform - 1);
+	const uint16_t mask = static_cast<uint16_t>((1 << (precision - pointTransform)) - 1);
+
+	bool isFirstLine = true;
+	bool isRestarted = true;
+	int unitsToRestart = restartInterval;
+	int outputRow = 0;
+	int outputColumn = 0;
+
+	for (int row = 0; row < height; row++)
+	{
+		uint16_t* current = currentLine.data();
+		const uint16_t* previous = previousLine.constData();
+
+		for (int column = 0; column < width; column++)
+		{
+			if (restartInterval != 0)
+			{
+				if (unitsToRestart == 0)
+				{
+					if (!skipRestartMarker())
+					{
+						return false;
+					}
+					unitsToRestart = restartInterval;
+					isFirstLine = true;
+					isRestarted = true;
+				}
+				unitsToRestart--;
+			}
+
+			for (int component = 0; component < componentsCount; component++)
+			{
+				const int difference = decodeDifference(huffmanTables[components[component].huffmanTable]);
+				if (difference == INT_MIN)
+				{
+					return false;
+				}
+
+				const int index = column * componentsCount + component;
+				int prediction;
+				if (isRestarted)
+				{
+					prediction = initialPrediction;
+				}
+				else if (isFirstLine)
+				{
+					prediction = current[index - componentsCount];
+				}
+				else if (column == 0)
+				{
+					prediction = previous[index];
+				}
+				else
+				{
+					const int left = current[index - componentsCount];
+					const int above = previous[index];
+					const int aboveLeft = previous[index - componentsCount];
+					switch (predictor)
+					{
+						case 1:
+							prediction = left;
+							break;
+						case 2:
+							prediction = above;
+							break;
+						case 3:
+							prediction = aboveLeft;
+							break;
+						case 4:
+							prediction = left + above - aboveLeft;
+							break;
+						case 5:
+							prediction = left + ((above - aboveLeft) >> 1);
+							break;
+						case 6:
+							prediction = above + ((left - aboveLeft) >> 1);
+							break;
+						default:
+							prediction = (left + above) >> 1;
+					}
+				}
+
+				current[index] = static_cast<uint16_t>(prediction + difference) & mask;
+			}
+
+			isRestarted = false;
+		}
+
+		isFirstLine = false;
+
+		// Wrapping the decoded line into output rows, DNG allows JPEG line width to differ from tile width.
+		int lineOffset = 0;
+		while (lineOffset < lineSamples)
+		{
+			const int count = qMin(lineSamples - lineOffset, tile.rowSamples - outputColumn);
+			if (outputRow < tile.rows && outputColumn < tile.keepSamples)
+			{
+				uint16_t* destination = tile.destination + outputRow * tile.stride + outputColumn;
+				const int keepCount = qMin(count, tile.keepSamples - outputColumn);
+				for (int i = 0; i < keepCount; i++)
+				{
+					destination[i] = static_cast<uint16_t>(current[lineOffset + i] << pointTransform);
+				}
+			}
+
+			lineOffset += count;
+			outputColumn += count;
+			if (outputColumn == tile.rowSamples)
+			{
+				outputColumn = 0;
+				outputRow++;
+			}
+		}
+
+		previousLine.swap(currentLine);
+	}
+
+	return true;
+}
+
+bool LosslessJpeg::skipRestartMarker()
+{
+	// Bits left in the buffer are padding, the marker follows the last consumed byte.
+	bitBuffer = 0;
+	bitCount = 0;
+	isMarkerReached = false;
+
+	int marker = 0;
+	return readMarker(&marker) && marker >= MarkerEnum::RST0 && marker <= MarkerEnum::RST7;
+}
+
+void LosslessJpeg::fillBitBuffer()
+{
+	while (bitCount <= 56)
+	{
+		uint8_t byte = 0;
+		if (!isMarkerReached && position < size)
+		{
+			byte = data[position];
+			if (byte != 0xff)
+			{
+				position++;
+			}
+			else if (position + 1 < size && data[position + 1] == 0x00)
+			{
+				position += 2;
+			}
+			else
+			{
+				// Marker is left unconsumed, entropy coded data is padded with zeros up to it.
+				isMarkerReached = true;
+				byte = 0;
+			}
+		}
+
+		bitBuffer |= static_cast<uint64_t>(byte) << (56 - bitCount);
+		bitCount += 8;
+	}
+}
+
+int LosslessJpeg::readBits(int count)
+{
+	if (bitCount < count)
+	{
+		fillBitBuffer();
+	}
+
+	const int value = static_cast<int>(bitBuffer >> (64 - count));
+	bitBuffer <<= count;
+	bitCount -= count;
+	return value;
+}
+
+int LosslessJpeg::decodeHuffman(const HuffmanTable& table)
+{
+	if (bitCount < 16)
+	{
+		fillBitBuffer();
+	}
+
+	const int lookupIndex = static_cast<int>(bitBuffer >> 56);
+	if (table.lookupLength[lookupIndex] != 0)
+	{
+		const int length = table.lookupLength[lookupIndex];
+		bitBuffer <<= length;
+		bitCount -= length;
+		return table.lookupValue[lookupIndex];
+	}
+
+	for (int length = 9; length <= 16; length++)
+	{
+		const int code = static_cast<int>(bitBuffer >> (64 - length));
+		if (code <= table.maxCode[length])
+		{
+			const int valueIndex = table.valueOffset[length] + code;
+			if (valueIndex < 0 || valueIndex >= table.valuesCount)
+			{
+				return -1;
+			}
+
+			bitBuffer <<= length;
+			bitCount -= length;
+			return table.values[valueIndex];
+		}
+	}
+
+	return -1;
+}
+
+int LosslessJpeg::decodeDifference(const HuffmanTable& table)
+{
+	const int category = decodeHuffman(table);
+	if (category < 0 || category > 16)
+	{
+		return INT_MIN;
+	}
+
+	if (category == 0)
+	{
+		return 0;
+	}
+
+	// Category 16 has no additional bits and always means 32768.
+	if (category == 16)
+	{
+		return 32768;
+	}
+
+	const int bits = readBits(category);
+	return bits < 1 << (category - 1) ? bits - (1 << category) + 1 : bits;
+}
+
+QByteArray LosslessJpeg::encode(const uint16_t* source, qint64 stride, int width, int height, int componentsCount, int precision)
+{
+	const int lineSamples = width * componentsCount;
+	const int initialPrediction = 1 << (precision - 1);
+
+	// First pass collects differences and their statistics for the huffman table.
+	QList<int> differences(static_cast<qsizetype>(lineSamples) * height);
+	QList<int> frequencies(17);
+	int index = 0;
+	for (int row = 0; row < height; row++)
+	{
+		const uint16_t* current = source + row * stride;
+		const uint16_t* previous = current - stride;
+		for (int i = 0; i < lineSamples; i++)
+		{
+			int prediction;
+			if (row == 0)
+			{
+				prediction = i < componentsCount ? initialPrediction : current[i - componentsCount];
+			}
+			else
+			{
+				prediction = i < componentsCount ? previous[i] : current[i - componentsCount];
+			}
+
+			int difference = (current[i] - prediction) & 0xffff;
+			if (difference >= 32768)
+			{
+				difference -= 65536;
+			}
+
+			differences[index++] = difference;
+			frequencies[getDifferenceCategory(difference)]++;
+		}
+	}
+
+	QList<int> codeLengths;
+	buildCodeLengths(frequencies, codeLengths);
+
+	QList<uint8_t> counts(16);
+	QList<uint8_t> values;
+	for (int length = 1; length <= 16; length++)
+	{
+		for (int category = 0; category <= 16; category++)
+		{
+			if (codeLengths[category] == length)
+			{
+				counts[length - 1]++;
+				values.append(category);
+			}
+		}
+	}
+
+	QList<int> codes(17);
+	int code = 0;
+	int valueIndex = 0;
+	for (int length = 1; length <= 16; length++)
+	{
+		for (int i = 0; i < counts[length - 1]; i++)
+		{
+			codes[values[valueIndex++]] = code++;
+		}
+		code <<= 1;
+	}
+
+	QByteArray result;
+	result.reserve(differences.size() + 256);
+	auto appendUint16 = [&result](int value)
+		{
+			result.append(static_cast<char>(value >> 8));
+			result.append(static_cast<char>(value & 0xff));
+		};
+
+	appendUint16(MarkerEnum::SOI);
+
+	appendUint16(MarkerEnum::SOF3);
+	appendUint16(8 + componentsCount * 3);
+	result.append(static_cast<char>(precision));
+	appendUint16(height);
+	appendUint16(width);
+	result.append(static_cast<char>(componentsCount));
+	for (int i = 0; i < componentsCount; i++)
+	{
+		result.append(static_cast<char>(i));
+		result.append(static_cast<char>(0x11));
+		result.append(static_cast<char>(0));
+	}
+
+	appendUint16(MarkerEnum::DHT);
+	appendUint16(2 + 17 + values.size());
+	result.append(static_cast<char>(0));
+	for (int i = 0; i < 16; i++)
+	{
+		result.append(static_cast<char>(counts[i]));
+	}
+	for (int i = 0; i < values.size(); i++)
+	{
+		result.append(static_cast<char>(values[i]));
+	}
+
+	appendUint16(MarkerEnum::SOS);
+	appendUint16(6 + componentsCount * 2);
+	result.append(static_cast<char>(componentsCount));
+	for (int i = 0; i < componentsCount; i++)
+	{
+		result.append(static_cast<char>(i));
+		result.append(static_cast<char>(0));
+	}
+	result.append(static_cast<char>(1));
+	result.append(static_cast<char>(0));
+	result.append(static_cast<char>(0));
+
+	uint64_t bits = 0;
+	int bitsCount = 0;
+	auto flushBytes = [&result, &bits, &bitsCount]()
+		{
+			while (bitsCount >= 8)
+			{
+				const char byte = static_cast<char>(bits >> (bitsCount - 8));
+				result.append(byte);
+				if (byte == static_cast<char>(0xff))
+				{
+					result.append(static_cast<char>(0));
+				}
+				bitsCount -= 8;
+			}
+		};
+
+	for (int i = 0; i < differences.size(); i++)
+	{
+		const int difference = differences[i];
+		const int category = getDifferenceCategory(difference);
+
+		bits = bits << codeLengths[category] | codes[category];
+		bitsCount += codeLengths[category];
+
+		if (category != 0 && category != 16)
+		{
+			bits = bits << category | ((difference < 0 ? difference - 1 : difference) & ((1 << category) - 1));
+			bitsCount += category;
+		}
+
+		flushBytes();
+	}
+
+	// Padding the last byte with ones.
+	if (bitsCount > 0)
+	{
+		bits = bits << (8 - bitsCount) | ((1 << (8 - bitsCount)) - 1);
+		bitsCount = 8;
+		flushBytes();
+	}
+
+	appendUint16(MarkerEnum::EOI);
+	return result;
+}
+
+int LosslessJpeg::getDifferenceCategory(int difference)
+{
+	if (difference == -32768)
+	{
+		return 16;
+	}
+
+	int magnitude = difference < 0 ? -difference : difference;
+	int category = 0;
+	while (magnitude != 0)
+	{
+		magnitude >>= 1;
+		category++;
+	}
+	return category;
+}
+
+void LosslessJpeg::buildCodeLengths(const QList<int>& frequencies, QList<int>& codeLengths)
+{
+	// Code lengths from ITU T.81 Annex K.2. One reserved symbol guarantees that no code consists of ones only.
+	const int symbolsCount = frequencies.size() + 1;
+	QList<qint64> weights(symbolsCount);
+	QList<int> sizes(symbolsCount);
+	QList<int> others(symbolsCount, -1);
+	for (int i = 0; i < frequencies.size(); i++)
+	{
+		weights[i] = frequencies[i];
+	}
+	weights[symbolsCount - 1] = 1;
+
+	while (true)
+	{
+		int first = -1;
+		int second = -1;
+		for (int i = 0; i < symbolsCount; i++)
+		{
+			if (weights[i] == 0)
+			{
+				continue;
+			}
+
+			if (first < 0 || weights[i] <= weights[first])
+			{
+				second = first;
+				first = i;
+			}
+			else if (second < 0 || weights[i] <= weights[second])
+			{
+				second = i;
+			}
+		}
+
+		if (second < 0)
+		{
+			break;
+		}
+
+		weights[first] += weights[second];
+		weights[second] = 0;
+
+		sizes[first]++;
+		while (others[first] >= 0)
+		{
+			first = others[first];
+			sizes[first]++;
+		}
+		others[first] = second;
+
+		sizes[second]++;
+		while (others[second] >= 0)
+		{
+			second = others[second];
+			sizes[second]++;
+		}
+	}
+
+	QList<int> lengthCounts(qMax(33, symbolsCount + 1));
+	for (int i = 0; i < symbolsCount; i++)
+	{
+		if (sizes[i] > 0)
+		{
+			lengthCounts[sizes[i]]++;
+		}
+	}
+
+	for (int length = lengthCounts.size() - 1; length > 16; length--)
+	{
+		while (lengthCounts[length] > 0)
+		{
+			int shorter = length - 2;
+			while (lengthCounts[shorter] == 0)
+			{
+				shorter--;
+			}
+
+			lengthCounts[length] -= 2;
+			lengthCounts[length - 1]++;
+			lengthCounts[shorter + 1] += 2;
+			lengthCounts[shorter]--;
+		}
+	}
+
+	// Removing the reserved symbol, it has one of the longest codes.
+	int longest = 16;
+	while (lengthCounts[longest] == 0)
+	{
+		longest--;
+	}
+	lengthCounts[longest]--;
+
+	// Assigning lengths in order of decreasing frequency, as Annex K.2 sorts symbols by code size.
+	QList<int> order;
+	for (int i = 0; i < frequencies.size(); i++)
+	{
+		if (frequencies[i] > 0)
+		{
+			order.append(i);
+		}
+	}
+	std::stable_sort(order.begin(), order.end(), [&sizes](int first, int second)
+		{
+			return sizes[first] < sizes[second];
+		});
+
+	codeLengths = QList<int>(frequencies.size());
+	int length = 1;
+	for (int i = 0; i < order.size(); i++)
+	{
+		while (lengthCounts[length] == 0)
+		{
+			length++;
+		}
+		codeLengths[order[i]] = length;
+		lengthCounts[length]--;
+	}
+}
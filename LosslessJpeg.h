@@ -0,0 +1,74 @@
+#pragma once
+#include <QByteArray>
+#include <QList>
+
+// Lossless JPEG (ITU T.81 process 14, SOF3) codec for DNG tiles and strips.
+class LosslessJpeg
+{
+public:
+	// Decoded samples form one stream that is wrapped into rows of rowSamples, only the first rows x keepSamples part is stored.
+	struct OutputTile
+	{
+		uint16_t* destination;
+		qint64 stride;
+		int rowSamples;
+		int rows;
+		int keepSamples;
+	};
+
+private:
+	struct HuffmanTable
+	{
+		bool isDefined = false;
+		// Codes up to 8 bits long are decoded with one lookup, longer codes fall back to the canonical code ranges.
+		uint8_t lookupLength[256] = {};
+		uint8_t lookupValue[256] = {};
+		int maxCode[17] = {};
+		int valueOffset[17] = {};
+		uint8_t values[256] = {};
+		int valuesCount = 0;
+	};
+
+	struct Component
+	{
+		int id = 0;
+		int huffmanTable = 0;
+	};
+
+	const uint8_t* data;
+	qint64 size;
+	qint64 position = 0;
+	uint64_t bitBuffer = 0;
+	int bitCount = 0;
+	bool isMarkerReached = false;
+
+	HuffmanTable huffmanTables[4];
+	QList<Component> components;
+	int precision = 0;
+	int width = 0;
+	int height = 0;
+	int restartInterval = 0;
+
+	LosslessJpeg(const char* data, qint64 size);
+
+	bool readMarker(int* marker);
+	int readUint16();
+	bool readFrameHeader();
+	bool readHuffmanTables();
+	bool readRestartInterval();
+	bool readScan(const OutputTile& tile);
+	bool skipRestartMarker();
+
+	void fillBitBuffer();
+	int readBits(int count);
+	int decodeHuffman(const HuffmanTable& table);
+	int decodeDifference(const HuffmanTable& table);
+
+	static int getDifferenceCategory(int difference);
+	static void buildCodeLengths(const QList<int>& frequencies, QList<int>& codeLengths);
+
+public:
+	static bool decode(const char* data, qint64 size, const OutputTile& tile);
+	// Source rows contain width * componentsCount interleaved samples, predictor 1 with one optimized huffman table is used.
+	static QByteArray encode(const uint16_t* source, qint64 stride, int width, int height, int componentsCount, int precision);
+};
@@ -0,0 +1,225 @@
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QSaveFile>
+#include "Manifest.h"
+#include "FileUtils.h"
+
+Manifest::Manifest(const ProcessingParcel& parcel)
+{
+	sourceFilesRoot = parcel.sourceFileRoot;
+	outputRoot = getOutputRoot(parcel.sourceFileRoot, parcel.savingOptions);
+	globalProcessingOptions = parcel.globalProcessingOptions;
+	savingOptions = parcel.savingOptions;
+
+	if (outputRoot.isEmpty())
+	{
+		return;
+	}
+
+	QFile manifestFile(getFilePath());
+	if (!manifestFile.open(QIODevice::ReadOnly))
+	{
+		return;
+	}
+
+	// Later lines replace earlier entries of the same source, a line cut by an interrupted write is skipped.
+	while (!manifestFile.atEnd())
+	{
+		const QJsonObject jsonObject = QJsonDocument::fromJson(manifestFile.readLine()).object();
+		const QString source = jsonObject["source"].toString();
+		if (source.isEmpty())
+		{
+			continue;
+		}
+
+		Entry entry;
+		entry.source = readIdentity(jsonObject, "source");
+		entry.referenceFilePath = jsonObject["reference"].toString();
+		entry.reference = readIdentity(jsonObject, "reference");
+		entry.options = jsonObject["options"].toObject();
+		entry.outputFilePath = jsonObject["output"].toString();
+		entry.output = readIdentity(jsonObject, "output");
+		entries.insert(source, entry);
+		linesCount++;
+	}
+}
+
+Manifest::~Manifest()
+{
+	if (!isModified || linesCount == entries.size())
+	{
+		return;
+	}
+
+	QSaveFile manifestFile(getFilePath());
+	if (!manifestFile.open(QIODevice::WriteOnly))
+	{
+		return;
+	}
+
+	for (auto [source, entry] : entries.asKeyValueRange())
+	{
+		manifestFile.write(QJsonDocument(toJson(source, entry)).toJson(QJsonDocument::Compact) + '\n');
+	}
+	manifestFile.commit();
+}
+
+QString Manifest::getOutputRoot(const QString& sourceFilesRoot, const SavingOptions& savingOptions)
+{
+	// Outputs of the subfolder mode are spread over the source tree, so its manifest is kept in the source root.
+	const QString outputRoot = savingOptions.saveTo == SavingOptions::SaveToEnum::Folder ? savingOptions.saveToFolderPath : sourceFilesRoot;
+	return !outputRoot.isEmpty() && QDir(outputRoot).exists() ? outputRoot : "";
+}
+
+bool Manifest::isUpToDate(const ProcessingItem& item, const QString& destinationFilePath) const
+{
+	if (outputRoot.isEmpty() || !savingOptions.skipUpToDate)
+	{
+		return false;
+	}
+
+	const QString source = FileUtils::getRelativePath(sourceFilesRoot, item.sourceFile->filePath);
+	if (!entries.contains(source))
+	{
+		return false;
+	}
+
+	const Entry entry = entries.value(source);
+	return entry.options == getOptions(item) &&
+		entry.referenceFilePath == item.referenceFile->filePath &&
+		entry.outputFilePath == FileUtils::getRelativePath(outputRoot, destinationFilePath) &&
+		isSameFile(item.sourceFile->filePath, entry.source) &&
+		isSameFile(item.referenceFile->filePath, entry.reference) &&
+		isSameFile(destinationFilePath, entry.output);
+}
+
+void Manifest::update(const ProcessingItem& item, const QString& destinationFilePath)
+{
+	if (outputRoot.isEmpty())
+	{
+		return;
+	}
+
+	Entry entry;
+	entry.source = getFileIdentity(item.sourceFile->filePath);
+	entry.referenceFilePath = item.referenceFile->filePath;
+	entry.reference = getFileIdentity(item.referenceFile->filePath);
+	entry.options = getOptions(item);
+	entry.outputFilePath = FileUtils::getRelativePath(outputRoot, destinationFilePath);
+	entry.output = getFileIdentity(destinationFilePath);
+
+	append(FileUtils::getRelativePath(sourceFilesRoot, item.sourceFile->filePath), entry);
+}
+
+void Manifest::append(const QString& sourceRelativePath, const Entry& entry)
+{
+	entries.insert(sourceRelativePath, entry);
+	isModified = true;
+
+	QFile manifestFile(getFilePath());
+	if (manifestFile.open(QIODevice::WriteOnly | QIODevice::Append))
+	{
+		manifestFile.write(QJsonDocument(toJson(sourceRelativePath, entry)).toJson(QJsonDocument::Compact) + '\n');
+		linesCount++;
+	}
+}
+
+QJsonObject Manifest::getOptions(const ProcessingItem& item) const
+{
+	QJsonObject options;
+	options["luminanceCorrectionIntensity"] = item.processingOptions.luminanceCorrectionIntensity;
+	options["colorCorrectionIntensity"] = item.processingOptions.colorCorrectionIntensity;
+	options["gaussianBlurSigma"] = item.processingOptions.gaussianBlurSigma;
+	options["limitToWhiteLevel"] = globalProcessingOptions.limitToWhiteLevel;
+	options["scaleChannelsToAvoidClipping"] = globalProcessingOptions.scaleChannelsToAvoidClipping;
+	options["calculateCommonScaleForBatch"] = globalProcessingOptions.calculateCommonScaleForBatch;
+	options["outputFormat"] = savingOptions.outputFormat;
+	return options;
+}
+
+QString Manifest::getFilePath() const
+{
+	return FileUtils::getAbsolutePath(outputRoot, fileName);
+}
+
+Manifest::FileIdentity Manifest::getFileIdentity(const QString& filePath)
+{
+	const QFileInfo fileInfo(filePath);
+	if (!fileInfo.exists())
+	{
+		return {};
+	}
+
+	FileIdentity identity;
+	identity.size = fileInfo.size();
+	identity.modified = fileInfo.lastModified().toMSecsSinceEpoch();
+	identity.hash = getFastHash(filePath, identity.size);
+	return identity;
+}
+
+QByteArray Manifest::getFastHash(const QString& filePath, qint64 size)
+{
+	// Raw data takes most of a DNG, so the middle and end samples change with the image, and the start sample with the metadata.
+	QFile file(filePath);
+	if (!file.open(QIODevice::ReadOnly))
+	{
+		return {};
+	}
+
+	QCryptographicHash hash(QCryptographicHash::Md5);
+	const qint64 offsets[] = { 0, qMax<qint64>(0, size / 2 - hashSampleSize / 2), qMax<qint64>(0, size - hashSampleSize) };
+	for (const qint64 offset : offsets)
+	{
+		if (!file.seek(offset))
+		{
+			return {};
+		}
+		hash.addData(file.read(hashSampleSize));
+	}
+
+	return hash.result().toHex();
+}
+
+bool Manifest::isSameFile(const QString& filePath, const FileIdentity& identity)
+{
+	const QFileInfo fileInfo(filePath);
+	if (identity.size < 0 || !fileInfo.exists() || fileInfo.size() != identity.size)
+	{
+		return false;
+	}
+
+	return fileInfo.lastModified().toMSecsSinceEpoch() == identity.modified || getFastHash(filePath, identity.size) == identity.hash;
+}
+
+QJsonObject Manifest::toJson(const QString& sourceRelativePath, const Entry& entry)
+{
+	QJsonObject jsonObject;
+	jsonObject["source"] = sourceRelativePath;
+	writeIdentity(jsonObject, "source", entry.source);
+	jsonObject["reference"] = entry.referenceFilePath;
+	writeIdentity(jsonObject, "reference", entry.reference);
+	jsonObject["options"] = entry.options;
+	jsonObject["output"] = entry.outputFilePath;
+	writeIdentity(jsonObject, "output", entry.output);
+	return jsonObject;
+}
+
+void Manifest::writeIdentity(QJsonObject& jsonObject, const QString& prefix, const FileIdentity& identity)
+{
+	jsonObject[prefix + "Size"] = identity.size;
+	jsonObject[prefix + "Modified"] = identity.modified;
+	jsonObject[prefix + "Hash"] = QString::fromLatin1(identity.hash);
+}
+
+Manifest::FileIdentity Manifest::readIdentity(const QJsonObject& jsonObject, const QString& prefix)
+{
+	FileIdentity identity;
+	identity.size = jsonObject[prefix + "Size"].toInteger(-1);
+	identity.modified = jsonObject[prefix + "Modified"].toInteger();
+	identity.hash = jsonObject[prefix + "Hash"].toString().toLatin1();
+	return identity;
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <QJsonObject>
+#include <QMap>
+#include <QString>
+
+#include "DataStructs.h"
+
+// Record of processed files, kept in the output root. Items whose source, reference, options and output did not change since they
+// were processed are up to date and are not processed again. An entry is appended right after every processed item, so an interrupted
+// batch continues from the first item which was not finished.
+class Manifest
+{
+	struct FileIdentity
+	{
+		qint64 size = -1;
+		qint64 modified = 0;
+		QByteArray hash;
+	};
+
+	struct Entry
+	{
+		FileIdentity source;
+		QString referenceFilePath;
+		FileIdentity reference;
+		QJsonObject options;
+		QString outputFilePath;
+		FileIdentity output;
+	};
+
+	inline static const QString fileName = "processingManifest.json";
+	// Size of each of the three samples, at the start, middle and end of the file, which make the fast hash.
+	static constexpr qint64 hashSampleSize = 64 * 1024;
+
+	QString sourceFilesRoot;
+	QString outputRoot;
+	GlobalProcessingOptions globalProcessingOptions;
+	SavingOptions savingOptions;
+	QMap<QString, Entry> entries;
+	int linesCount = 0;
+	bool isModified = false;
+
+	QJsonObject getOptions(const ProcessingItem& item) const;
+	QString getFilePath() const;
+	void append(const QString& sourceRelativePath, const Entry& entry);
+	static FileIdentity getFileIdentity(const QString& filePath);
+	static QByteArray getFastHash(const QString& filePath, qint64 size);
+	// Modification time is checked first, the hash is only read when it differs, e.g. for copied files.
+	static bool isSameFile(const QString& filePath, const FileIdentity& identity);
+	static QJsonObject toJson(const QString& sourceRelativePath, const Entry& entry);
+	static void writeIdentity(QJsonObject& jsonObject, const QString& prefix, const FileIdentity& identity);
+	static FileIdentity readIdentity(const QJsonObject& jsonObject, const QString& prefix);
+
+public:
+	explicit Manifest(const ProcessingParcel& parcel);
+	// Rewrites the manifest without entries which were replaced during the batch.
+	~Manifest();
+
+	static QString getOutputRoot(const QString& sourceFilesRoot, const SavingOptions& savingOptions);
+	bool isUpToDate(const ProcessingItem& item, const QString& destinationFilePath) const;
+	// Records the item after its output was saved.
+	void update(const ProcessingItem& item, const QString& destinationFilePath);
+};
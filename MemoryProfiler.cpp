@@ -0,0 +1,192 @@
+#include <QJsonDocument>
+#include <QSaveFile>
+#include <opencv2/core/mat.hpp>
+#include "MemoryProfiler.h"
+
+QAtomicInt MemoryProfiler::isEnabledValue = 0;
+MemoryProfiler::StageStatistics MemoryProfiler::stages[Metrics::StagesCount];
+QAtomicInteger<qint64> MemoryProfiler::liveBytes;
+QAtomicInteger<qint64> MemoryProfiler::peakBytes;
+QAtomicInteger<qint64> MemoryProfiler::itemAllocatedBytes;
+QAtomicInteger<qint64> MemoryProfiler::itemAllocations;
+QAtomicInteger<qint64> MemoryProfiler::itemPeakBytes;
+QMutex MemoryProfiler::itemsMutex;
+QJsonArray MemoryProfiler::items;
+
+// Counts Mats allocated by OpenCV, which is used only by the blur, and leaves the allocation itself to the standard allocator.
+// Temporary rows of the filter engine are not Mats and are not counted.
+class CountingMatAllocator : public cv::MatAllocator
+{
+	cv::MatAllocator* stdAllocator = cv::Mat::getStdAllocator();
+
+public:
+	cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step, cv::AccessFlag flags, cv::UMatUsageFlags usageFlags) const override
+	{
+		cv::UMatData* u = stdAllocator->allocate(dims, sizes, type, data, step, flags, usageFlags);
+		if (u != nullptr)
+		{
+			// Mats release their data through the allocator which is set here, so this one sees the deallocation too.
+			u->currAllocator = this;
+			if (data == nullptr)
+			{
+				MemoryProfiler::allocate(Metrics::Blur, static_cast<qint64>(u->size));
+			}
+		}
+		return u;
+	}
+
+	bool allocate(cv::UMatData* u, cv::AccessFlag accessFlags, cv::UMatUsageFlags usageFlags) const override
+	{
+		return stdAllocator->allocate(u, accessFlags, usageFlags);
+	}
+
+	void deallocate(cv::UMatData* u) const override
+	{
+		if (u != nullptr && !(u->flags & cv::UMatData::USER_ALLOCATED))
+		{
+			MemoryProfiler::release(Metrics::Blur, static_cast<qint64>(u->size));
+		}
+		stdAllocator->deallocate(u);
+	}
+};
+
+MemoryProfiler::Allocation::Allocation(Metrics::StageEnum stage, qint64 size) : stage(stage), size(isEnabled() ? size : 0)
+{
+	allocate(stage, this->size);
+}
+
+MemoryProfiler::Allocation::~Allocation()
+{
+	release(stage, size);
+}
+
+MemoryProfiler::ItemScope::ItemScope(const QString& filePath) : filePath(filePath)
+{
+	itemAllocatedBytes.storeRelaxed(0);
+	itemAllocations.storeRelaxed(0);
+	itemPeakBytes.storeRelaxed(liveBytes.loadRelaxed());
+}
+
+MemoryProfiler::ItemScope::~ItemScope()
+{
+	if (!isEnabled())
+	{
+		return;
+	}
+
+	QJsonObject item;
+	item["file"] = filePath;
+	item["allocatedBytes"] = itemAllocatedBytes.loadRelaxed();
+	item["allocations"] = itemAllocations.loadRelaxed();
+	item["peakBytes"] = itemPeakBytes.loadRelaxed();
+
+	const QMutexLocker locker(&itemsMutex);
+	items.append(item);
+}
+
+void MemoryProfiler::setEnabled(bool isEnabled)
+{
+	if (isEnabled && !MemoryProfiler::isEnabled())
+	{
+		installMatAllocator();
+	}
+	isEnabledValue.storeRelaxed(isEnabled ? 1 : 0);
+}
+
+bool MemoryProfiler::isEnabled()
+{
+	return isEnabledValue.loadRelaxed() != 0;
+}
+
+void MemoryProfiler::installMatAllocator()
+{
+	// Mats may outlive the profiler, so the allocator is never deleted.
+	static CountingMatAllocator* allocator = new CountingMatAllocator();
+	cv::Mat::setDefaultAllocator(allocator);
+}
+
+void MemoryProfiler::reset()
+{
+	for (StageStatistics& stage : stages)
+	{
+		stage.allocatedBytes.storeRelaxed(0);
+		stage.allocations.storeRelaxed(0);
+		stage.peakBytes.storeRelaxed(stage.liveBytes.loadRelaxed());
+	}
+	peakBytes.storeRelaxed(liveBytes.loadRelaxed());
+
+	const QMutexLocker locker(&itemsMutex);
+	items = QJsonArray();
+}
+
+void MemoryProfiler::allocate(Metrics::StageEnum stage, qint64 size, bool isItemAllocation)
+{
+	if (!isEnabled() || size <= 0)
+	{
+		return;
+	}
+
+	StageStatistics& statistics = stages[stage];
+	statistics.allocatedBytes.fetchAndAddRelaxed(size);
+	statistics.allocations.fetchAndAddRelaxed(1);
+	updatePeak(statistics.peakBytes, statistics.liveBytes.fetchAndAddRelaxed(size) + size);
+	updatePeak(peakBytes, liveBytes.fetchAndAddRelaxed(size) + size);
+
+	if (!isItemAllocation)
+	{
+		return;
+	}
+
+	itemAllocatedBytes.fetchAndAddRelaxed(size);
+	itemAllocations.fetchAndAddRelaxed(1);
+	updatePeak(itemPeakBytes, liveBytes.loadRelaxed());
+}
+
+void MemoryProfiler::release(Metrics::StageEnum stage, qint64 size)
+{
+	// Memory allocated before the profiler was enabled is released without being counted, so live bytes can't go below zero.
+	if (size <= 0 || stages[stage].liveBytes.loadRelaxed() < size)
+	{
+		return;
+	}
+
+	stages[stage].liveBytes.fetchAndAddRelaxed(-size);
+	liveBytes.fetchAndAddRelaxed(-size);
+}
+
+void MemoryProfiler::updatePeak(QAtomicInteger<qint64>& peak, qint64 value)
+{
+	qint64 current = peak.loadRelaxed();
+	while (value > current && !peak.testAndSetRelaxed(current, value, current))
+	{
+	}
+}
+
+QJsonObject MemoryProfiler::getReport()
+{
+	QJsonObject stageValues;
+	for (int stage = 0; stage < Metrics::StagesCount; stage++)
+	{
+		QJsonObject values;
+		values["allocatedBytes"] = stages[stage].allocatedBytes.loadRelaxed();
+		values["allocations"] = stages[stage].allocations.loadRelaxed();
+		values["peakBytes"] = stages[stage].peakBytes.loadRelaxed();
+		values["liveBytes"] = stages[stage].liveBytes.loadRelaxed();
+		stageValues[Metrics::getName(static_cast<Metrics::StageEnum>(stage))] = values;
+	}
+
+	QJsonObject report;
+	report["peakBytes"] = peakBytes.loadRelaxed();
+	report["liveBytes"] = liveBytes.loadRelaxed();
+	report["stages"] = stageValues;
+
+	const QMutexLocker locker(&itemsMutex);
+	report["items"] = items;
+	return report;
+}
+
+bool MemoryProfiler::writeReport(const QString& filePath)
+{
+	QSaveFile file(filePath);
+	return file.open(QIODevice::WriteOnly) && file.write(QJsonDocument(getReport()).toJson()) >= 0 && file.commit();
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <QAtomicInt>
+#include <QAtomicInteger>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QMutex>
+#include <QString>
+
+#include "Metrics.h"
+
+// Opt-in accounting of the memory held by the processing stages, for sizing the number of files processed in parallel. Raw buffers,
+// channel buffers and OpenCV temporaries of the blur are counted with the stage which allocates them, from allocation until release,
+// together with the high-water marks per stage, per item and for the whole run. Per item figures are kept for one item scope at a time,
+// so scopes must not overlap, as in Processor::run, which processes the items of a run one after another. Buffers which are loaded in
+// background for the next items are counted with their stage but not with the current item, the item counts them once it takes them
+// over. The item peak is the peak of all live memory while the item is processed. When it is disabled every call returns right away.
+class MemoryProfiler
+{
+	struct StageStatistics
+	{
+		QAtomicInteger<qint64> allocatedBytes;
+		QAtomicInteger<qint64> allocations;
+		QAtomicInteger<qint64> liveBytes;
+		QAtomicInteger<qint64> peakBytes;
+	};
+
+	static QAtomicInt isEnabledValue;
+	static StageStatistics stages[Metrics::StagesCount];
+	static QAtomicInteger<qint64> liveBytes;
+	static QAtomicInteger<qint64> peakBytes;
+	static QAtomicInteger<qint64> itemAllocatedBytes;
+	static QAtomicInteger<qint64> itemAllocations;
+	static QAtomicInteger<qint64> itemPeakBytes;
+	static QMutex itemsMutex;
+	static QJsonArray items;
+
+	static void updatePeak(QAtomicInteger<qint64>& peak, qint64 value);
+	static void installMatAllocator();
+
+public:
+	// Counts the bytes for the lifetime of the scope.
+	class Allocation
+	{
+		Metrics::StageEnum stage;
+		qint64 size;
+
+	public:
+		Allocation(Metrics::StageEnum stage, qint64 size);
+		~Allocation();
+		Allocation(const Allocation&) = delete;
+		Allocation& operator=(const Allocation&) = delete;
+	};
+
+	// Per item figures are collected from the start of the scope until its end.
+	class ItemScope
+	{
+		QString filePath;
+
+	public:
+		explicit ItemScope(const QString& filePath);
+		~ItemScope();
+	};
+
+	// Enabling it also replaces the default OpenCV allocator, so it is done once at startup, before any processing.
+	static void setEnabled(bool isEnabled);
+	static bool isEnabled();
+	// Clears the figures of the previous run. Memory which is still held stays counted as live.
+	static void reset();
+
+	// Allocations which don't belong to the current item, e.g. background loads of the next ones, are left out of the item figures.
+	static void allocate(Metrics::StageEnum stage, qint64 size, bool isItemAllocation = true);
+	static void release(Metrics::StageEnum stage, qint64 size);
+	// Sizes of buffers which are counted by the caller.
+	template<typename T>
+	static qint64 getSize(const QList<QList<T>>& buffers);
+
+	static QJsonObject getReport();
+	static bool writeReport(const QString& filePath);
+};
+
+template<typename T>
+qint64 MemoryProfiler::getSize(const QList<QList<T>>& buffers)
+{
+	qint64 size = 0;
+	for (const QList<T>& buffer : buffers)
+	{
+		size += buffer.size() * static_cast<qint64>(sizeof(T));
+	}
+	return size;
+}
@@ -1,8 +1,213 @@
 #include "MetadataReader.h"
+#include "Tracer.h"
 
 #include <QFile>
 
 QSharedPointer<Metadata> MetadataReader::readMetadata(const QString& filename)
+{
+    const Tracer::Span span("readMetadata", "scan", filename);
+    // Native reader handles regular DNGs with a few small reads, Exiv2 is used for everything it rejects.
+    QSharedPointer<Metadata> metadata = readMetadataNative(filename);
+    if (metadata.isNull())
+    {
+        metadata = readMetadataExiv2(filename);
+    }
+    return metadata;
+}
+
+QSharedPointer<Metadata> MetadataReader::readMetadataNative(const QString& filename)
+{
+    QFile file(filename);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Unbuffered))
+    {
+        return nullptr;
+    }
+
+    TiffFile tiffFile(&file);
+    tiffFile.setLoadedTags({
+        ExifTagsEnum::ImageWidth, ExifTagsEnum::ImageHeight, ExifTagsEnum::BitsPerSample, ExifTagsEnum::Compression,
+        ExifTagsEnum::PhotometricInterpretation, ExifTagsEnum::CameraMaker, ExifTagsEnum::CameraModel, ExifTagsEnum::StripOffsets,
+        ExifTagsEnum::SamplesPerPixel, ExifTagsEnum::RowsPerStrip, ExifTagsEnum::StripByteCounts, ExifTagsEnum::TileWidth,
+        ExifTagsEnum::TileLength, ExifTagsEnum::TileOffsets, ExifTagsEnum::TileByteCounts, ExifTagsEnum::SampleFormat,
+        ExifTagsEnum::CFAPattern2, ExifTagsEnum::FNumber, ExifTagsEnum::FocalLength, ExifTagsEnum::LensModel,
+        ExifTagsEnum::BlackLevel, ExifTagsEnum::WhiteLevel, ExifTagsEnum::ActiveArea });
+    if (!tiffFile.read())
+    {
+        return nullptr;
+    }
+
+    const QList<TiffFile::Directory>& directories = tiffFile.getDirectories();
+    QSharedPointer<Metadata> metadata = QSharedPointer<Metadata>(new Metadata());
+    metadata->bigEndian = tiffFile.isBigEndian();
+    int rawDirectory = -1;
+    int photometricInterpretation = 0;
+
+    for (int i = 0; i < directories.size(); i++)
+    {
+        const TiffFile::Entry* entry;
+        if ((entry = directories[i].findEntry(ExifTagsEnum::CameraMaker)) != nullptr)
+        {
+            metadata->cameraMaker = tiffFile.getString(*entry);
+        }
+        if ((entry = directories[i].findEntry(ExifTagsEnum::CameraModel)) != nullptr)
+        {
+            metadata->cameraModel = tiffFile.getString(*entry);
+        }
+        if ((entry = directories[i].findEntry(ExifTagsEnum::LensModel)) != nullptr)
+        {
+            metadata->lens = tiffFile.getString(*entry);
+        }
+        if ((entry = directories[i].findEntry(ExifTagsEnum::FNumber)) != nullptr)
+        {
+            metadata->fNumber = static_cast<float>(tiffFile.getRealValue(*entry, 0));
+        }
+        if ((entry = directories[i].findEntry(ExifTagsEnum::FocalLength)) != nullptr)
+        {
+            metadata->focalLength = static_cast<float>(tiffFile.getRealValue(*entry, 0));
+        }
+
+        entry = directories[i].findEntry(ExifTagsEnum::PhotometricInterpretation);
+        if (rawDirectory < 0 && entry != nullptr && (tiffFile.getValue(*entry, 0) == 34892 || tiffFile.getValue(*entry, 0) == 32803))
+        {
+            rawDirectory = i;
+            photometricInterpretation = static_cast<int>(tiffFile.getValue(*entry, 0));
+        }
+    }
+
+    if (rawDirectory < 0 || !readRawDirectory(tiffFile, directories[rawDirectory], photometricInterpretation, metadata))
+    {
+        return nullptr;
+    }
+
+    for (int i = 0; i < directories.size(); i++)
+    {
+        const TiffFile::Entry* entry = directories[i].findEntry(ExifTagsEnum::PhotometricInterpretation);
+        if (i == rawDirectory || entry == nullptr || static_cast<int>(tiffFile.getValue(*entry, 0)) != photometricInterpretation)
+        {
+            continue;
+        }
+
+        QSharedPointer<Metadata> frameMetadata = QSharedPointer<Metadata>(new Metadata());
+        if (readRawDirectory(tiffFile, directories[i], photometricInterpretation, frameMetadata) && isFrameLayoutCompatible(metadata, frameMetadata))
+        {
+            Metadata::FrameLayout frame;
+            frame.dataOffsets = frameMetadata->dataOffsets;
+            frame.dataByteCounts = frameMetadata->dataByteCounts;
+            metadata->additionalFrames.append(frame);
+        }
+    }
+
+    return completeMetadata(metadata);
+}
+
+bool MetadataReader::readRawDirectory(const TiffFile& tiffFile, const TiffFile::Directory& directory, int photometricInterpretation, const QSharedPointer<Metadata>& metadata)
+{
+    QList<qint64> stripOffsets;
+    QList<qint64> stripByteCounts;
+    QList<qint64> tileOffsets;
+    QList<qint64> tileByteCounts;
+    int rowsPerStrip = 0;
+    int samplesPerPixel = 1;
+
+    for (int i = 0; i < directory.entries.size(); i++)
+    {
+        const TiffFile::Entry& entry = directory.entries[i];
+        const int value = static_cast<int>(tiffFile.getValue(entry, 0));
+        switch (entry.tag)
+        {
+            case ExifTagsEnum::ImageWidth:
+                metadata->imageWidth = value;
+                break;
+            case ExifTagsEnum::ImageHeight:
+                metadata->imageHeight = value;
+                break;
+            case ExifTagsEnum::BitsPerSample:
+                metadata->bitsPerSample = value;
+                break;
+            case ExifTagsEnum::Compression:
+                if (value != Metadata::CompressionEnum::Uncompressed && value != Metadata::CompressionEnum::LosslessJPEG)
+                {
+                    return false;
+                }
+                metadata->compression = static_cast<Metadata::CompressionEnum>(value);
+                break;
+            case ExifTagsEnum::SampleFormat:
+                if (value != Metadata::SampleFormatEnum::UnsignedInteger && value != Metadata::SampleFormatEnum::FloatingPoint)
+                {
+                    return false;
+                }
+                metadata->sampleFormat = static_cast<Metadata::SampleFormatEnum>(value);
+                break;
+            case ExifTagsEnum::SamplesPerPixel:
+                samplesPerPixel = value;
+                break;
+            case ExifTagsEnum::RowsPerStrip:
+                rowsPerStrip = value;
+                break;
+            case ExifTagsEnum::TileWidth:
+                metadata->tileWidth = value;
+                break;
+            case ExifTagsEnum::TileLength:
+                metadata->tileHeight = value;
+                break;
+            case ExifTagsEnum::CFAPattern2:
+                metadata->cfaColorPattern.resize(entry.count);
+                for (quint32 j = 0; j < entry.count; j++)
+                {
+                    metadata->cfaColorPattern[j] = static_cast<Metadata::CFAPatternEnum>(tiffFile.getValue(entry, j));
+                }
+                break;
+            case ExifTagsEnum::BlackLevel:
+                metadata->blackLevels.resize(entry.count);
+                for (quint32 j = 0; j < entry.count; j++)
+                {
+                    metadata->blackLevels[j] = static_cast<uint16_t>(tiffFile.getRealValue(entry, j));
+                }
+                break;
+            case ExifTagsEnum::WhiteLevel:
+                metadata->whiteLevels.resize(entry.count);
+                for (quint32 j = 0; j < entry.count; j++)
+                {
+                    metadata->whiteLevels[j] = static_cast<uint16_t>(tiffFile.getValue(entry, j));
+                }
+                break;
+            case ExifTagsEnum::ActiveArea:
+                metadata->activeArea.resize(entry.count);
+                for (quint32 j = 0; j < entry.count; j++)
+                {
+                    metadata->activeArea[j] = static_cast<int>(tiffFile.getValue(entry, j));
+                }
+                break;
+        }
+
+        if (entry.tag == ExifTagsEnum::StripOffsets || entry.tag == ExifTagsEnum::StripByteCounts || entry.tag == ExifTagsEnum::TileOffsets || entry.tag == ExifTagsEnum::TileByteCounts)
+        {
+            QList<qint64>& values = entry.tag == ExifTagsEnum::StripOffsets ? stripOffsets : entry.tag == ExifTagsEnum::StripByteCounts ? stripByteCounts : entry.tag == ExifTagsEnum::TileOffsets ? tileOffsets : tileByteCounts;
+            values.resize(entry.count);
+            for (quint32 j = 0; j < entry.count; j++)
+            {
+                values[j] = static_cast<qint64>(tiffFile.getValue(entry, j));
+            }
+        }
+    }
+
+    if (photometricInterpretation == 32803)
+    {
+        metadata->rawType = Metadata::RawTypeEnum::Bayer;
+    }
+    else if (samplesPerPixel == 1 || samplesPerPixel == 3)
+    {
+        metadata->rawType = samplesPerPixel == 1 ? Metadata::RawTypeEnum::Mono : Metadata::RawTypeEnum::RGB;
+    }
+    else
+    {
+        return false;
+    }
+
+    return fillDataLayout(metadata, stripOffsets, stripByteCounts, rowsPerStrip, tileOffsets, tileByteCounts);
+}
+
+QSharedPointer<Metadata> MetadataReader::readMetadataExiv2(const QString& filename)
 {
     Exiv2::Image::UniquePtr image;
 
@@ -27,8 +232,14 @@ QSharedPointer<Metadata> MetadataReader::readMetadata(const QString& filename)
 	image->readMetadata();
     Exiv2::ExifData exifData = image->exifData();
     QSharedPointer<Metadata> metadata = QSharedPointer<Metadata>(new Metadata());
+    metadata->bigEndian = image->byteOrder() == Exiv2::bigEndian;
     int photometricInterpretation = 0;
     const int rawIFDid = findRawIFD(&exifData, &photometricInterpretation);
+    QList<qint64> stripOffsets;
+    QList<qint64> stripByteCounts;
+    QList<qint64> tileOffsets;
+    QList<qint64> tileByteCounts;
+    int rowsPerStrip = 0;
 
     for (Exiv2::ExifData::const_iterator iterator = exifData.begin(); iterator != exifData.end(); ++iterator)
     {
@@ -61,14 +272,52 @@ QSharedPointer<Metadata> MetadataReader::readMetadata(const QString& filename)
                 case ExifTagsEnum::ImageHeight:
                     metadata->imageHeight = static_cast<int>(iterator->toInt64());
                     break;
+                case ExifTagsEnum::BitsPerSample:
+                    metadata->bitsPerSample = static_cast<int>(iterator->toInt64());
+                    break;
                 case ExifTagsEnum::Compression:
-                    if (iterator->toUint32() != 1)
+                    switch (iterator->toUint32())
                     {
-                        return nullptr;
+                        case 1:
+                            metadata->compression = Metadata::CompressionEnum::Uncompressed;
+                            break;
+                        case 7:
+                            metadata->compression = Metadata::CompressionEnum::LosslessJPEG;
+                            break;
+                        default:
+                            return nullptr;
+                    }
+                    break;
+                case ExifTagsEnum::SampleFormat:
+                    switch (iterator->toUint32())
+                    {
+                        case 1:
+                            metadata->sampleFormat = Metadata::SampleFormatEnum::UnsignedInteger;
+                            break;
+                        case 3:
+                            metadata->sampleFormat = Metadata::SampleFormatEnum::FloatingPoint;
+                            break;
+                        default:
+                            return nullptr;
                     }
                     break;
                 case ExifTagsEnum::StripOffsets:
-                    metadata->dataOffset = static_cast<int>(iterator->toInt64(0));
+                    readValues(*iterator, stripOffsets);
+                    break;
+                case ExifTagsEnum::RowsPerStrip:
+                    rowsPerStrip = static_cast<int>(iterator->toInt64());
+                    break;
+                case ExifTagsEnum::TileWidth:
+                    metadata->tileWidth = static_cast<int>(iterator->toInt64());
+                    break;
+                case ExifTagsEnum::TileLength:
+                    metadata->tileHeight = static_cast<int>(iterator->toInt64());
+                    break;
+                case ExifTagsEnum::TileOffsets:
+                    readValues(*iterator, tileOffsets);
+                    break;
+                case ExifTagsEnum::TileByteCounts:
+                    readValues(*iterator, tileByteCounts);
                     break;
                 case ExifTagsEnum::SamplesPerPixel:
                     switch (photometricInterpretation)
@@ -94,10 +343,7 @@ QSharedPointer<Metadata> MetadataReader::readMetadata(const QString& filename)
                     }
                     break;
                 case ExifTagsEnum::StripByteCounts:
-                    for (size_t i = 0; i < iterator->count(); i++)
-                    {
-                        metadata->dataSize += static_cast<int>(iterator->toUint32(i));
-                    }
+                    readValues(*iterator, stripByteCounts);
                     break;
                 case ExifTagsEnum::CFAPattern2:
                     metadata->cfaColorPattern.resize(iterator->count());
@@ -130,6 +376,26 @@ QSharedPointer<Metadata> MetadataReader::readMetadata(const QString& filename)
         }
     }
 
+    if (!fillDataLayout(metadata, stripOffsets, stripByteCounts, rowsPerStrip, tileOffsets, tileByteCounts))
+    {
+        return nullptr;
+    }
+
+    const QList<int> additionalRawIFDs = findAdditionalRawIFDs(&exifData, rawIFDid, photometricInterpretation);
+    for (int i = 0; i < additionalRawIFDs.size(); i++)
+    {
+        Metadata::FrameLayout frame;
+        if (readFrameLayout(&exifData, additionalRawIFDs[i], metadata, frame))
+        {
+            metadata->additionalFrames.append(frame);
+        }
+    }
+
+    return completeMetadata(metadata);
+}
+
+QSharedPointer<Metadata> MetadataReader::completeMetadata(const QSharedPointer<Metadata>& metadata)
+{
     if (metadata->blackLevels.size() != metadata->getChannelsCount())
     {
         uint16_t blackLevel = 0;
@@ -149,7 +415,7 @@ QSharedPointer<Metadata> MetadataReader::readMetadata(const QString& filename)
 
     if (metadata->whiteLevels.size() != metadata->getChannelsCount())
     {
-        uint16_t whiteLevel = 65535;
+        uint16_t whiteLevel = metadata->isBitPacked() ? static_cast<uint16_t>((1 << metadata->bitsPerSample) - 1) : 65535;
         if (!metadata->whiteLevels.isEmpty())
         {
             whiteLevel = metadata->whiteLevels[0];
@@ -194,4 +460,144 @@ int MetadataReader::findRawIFD(Exiv2::ExifData* exifData, int* photometricInterp
         }
     }
     return -1;
-}
\ No newline at end of file
+}
+
+QList<int> MetadataReader::findAdditionalRawIFDs(Exiv2::ExifData* exifData, int rawIFDid, int photometricInterpretation)
+{
+    QList<int> rawIFDs;
+    for (Exiv2::ExifData::const_iterator iterator = exifData->begin(); iterator != exifData->end(); ++iterator)
+    {
+        const int ifdId = static_cast<int>(iterator->ifdId());
+        if (iterator->tag() == ExifTagsEnum::PhotometricInterpretation && static_cast<int>(iterator->toUint32()) == photometricInterpretation && ifdId != rawIFDid && !rawIFDs.contains(ifdId))
+        {
+            rawIFDs.append(ifdId);
+        }
+    }
+    return rawIFDs;
+}
+
+bool MetadataReader::readFrameLayout(Exiv2::ExifData* exifData, int ifdId, const QSharedPointer<Metadata>& metadata, Metadata::FrameLayout& frame)
+{
+    QSharedPointer<Metadata> frameMetadata = QSharedPointer<Metadata>(new Metadata());
+    QList<qint64> stripOffsets;
+    QList<qint64> stripByteCounts;
+    QList<qint64> tileOffsets;
+    QList<qint64> tileByteCounts;
+    int rowsPerStrip = 0;
+    int compression = Metadata::CompressionEnum::Uncompressed;
+
+    for (Exiv2::ExifData::const_iterator iterator = exifData->begin(); iterator != exifData->end(); ++iterator)
+    {
+        if (static_cast<int>(iterator->ifdId()) != ifdId)
+        {
+            continue;
+        }
+
+        switch (iterator->tag())
+        {
+            case ExifTagsEnum::ImageWidth:
+                frameMetadata->imageWidth = static_cast<int>(iterator->toInt64());
+                break;
+            case ExifTagsEnum::ImageHeight:
+                frameMetadata->imageHeight = static_cast<int>(iterator->toInt64());
+                break;
+            case ExifTagsEnum::BitsPerSample:
+                frameMetadata->bitsPerSample = static_cast<int>(iterator->toInt64());
+                break;
+            case ExifTagsEnum::SampleFormat:
+                frameMetadata->sampleFormat = static_cast<Metadata::SampleFormatEnum>(iterator->toInt64());
+                break;
+            case ExifTagsEnum::Compression:
+                compression = static_cast<int>(iterator->toInt64());
+                break;
+            case ExifTagsEnum::StripOffsets:
+                readValues(*iterator, stripOffsets);
+                break;
+            case ExifTagsEnum::StripByteCounts:
+                readValues(*iterator, stripByteCounts);
+                break;
+            case ExifTagsEnum::RowsPerStrip:
+                rowsPerStrip = static_cast<int>(iterator->toInt64());
+                break;
+            case ExifTagsEnum::TileWidth:
+                frameMetadata->tileWidth = static_cast<int>(iterator->toInt64());
+                break;
+            case ExifTagsEnum::TileLength:
+                frameMetadata->tileHeight = static_cast<int>(iterator->toInt64());
+                break;
+            case ExifTagsEnum::TileOffsets:
+                readValues(*iterator, tileOffsets);
+                break;
+            case ExifTagsEnum::TileByteCounts:
+                readValues(*iterator, tileByteCounts);
+                break;
+        }
+    }
+
+    frameMetadata->compression = static_cast<Metadata::CompressionEnum>(compression);
+    if (!fillDataLayout(frameMetadata, stripOffsets, stripByteCounts, rowsPerStrip, tileOffsets, tileByteCounts) || !isFrameLayoutCompatible(metadata, frameMetadata))
+    {
+        return false;
+    }
+
+    frame.dataOffsets = frameMetadata->dataOffsets;
+    frame.dataByteCounts = frameMetadata->dataByteCounts;
+    return true;
+}
+
+bool MetadataReader::isFrameLayoutCompatible(const QSharedPointer<Metadata>& metadata, const QSharedPointer<Metadata>& frameMetadata)
+{
+    // Only frames which can be handled exactly as the first one are used, e.g. previews in raw format are skipped. Samples of all frames
+    // are read and written with the format of the first one.
+    return frameMetadata->imageWidth == metadata->imageWidth &&
+        frameMetadata->imageHeight == metadata->imageHeight &&
+        frameMetadata->bitsPerSample == metadata->bitsPerSample &&
+        frameMetadata->sampleFormat == metadata->sampleFormat &&
+        frameMetadata->tileWidth == metadata->tileWidth &&
+        frameMetadata->tileHeight == metadata->tileHeight &&
+        frameMetadata->stripLayout == metadata->stripLayout &&
+        frameMetadata->dataOffsets.size() == metadata->dataOffsets.size() &&
+        frameMetadata->compression == metadata->compression;
+}
+
+void MetadataReader::readValues(const Exiv2::Exifdatum& exifDatum, QList<qint64>& values)
+{
+    values.resize(exifDatum.count());
+    for (size_t i = 0; i < exifDatum.count(); i++)
+    {
+        values[i] = exifDatum.toInt64(i);
+    }
+}
+
+bool MetadataReader::fillDataLayout(const QSharedPointer<Metadata>& metadata, const QList<qint64>& stripOffsets, const QList<qint64>& stripByteCounts, int rowsPerStrip, const QList<qint64>& tileOffsets, const QList<qint64>& tileByteCounts)
+{
+    if (!tileOffsets.isEmpty())
+    {
+        metadata->stripLayout = false;
+        metadata->dataOffsets = tileOffsets;
+        metadata->dataByteCounts = tileByteCounts;
+    }
+    else
+    {
+        // Strips are handled as full width tiles, missing RowsPerStrip means the whole image is one strip.
+        metadata->tileWidth = metadata->imageWidth;
+        metadata->tileHeight = rowsPerStrip > 0 && rowsPerStrip < metadata->imageHeight ? rowsPerStrip : metadata->imageHeight;
+        metadata->stripLayout = true;
+        metadata->dataOffsets = stripOffsets;
+        metadata->dataByteCounts = stripByteCounts;
+    }
+
+    if (metadata->dataOffsets.isEmpty() || metadata->dataOffsets.size() != metadata->dataByteCounts.size() || metadata->tileWidth <= 0 || metadata->tileHeight <= 0)
+    {
+        return false;
+    }
+
+    metadata->dataOffset = static_cast<int>(metadata->dataOffsets[0]);
+    metadata->dataSize = 0;
+    for (int i = 0; i < metadata->dataByteCounts.size(); i++)
+    {
+        metadata->dataSize += static_cast<int>(metadata->dataByteCounts[i]);
+    }
+
+    return true;
+}
@@ -1,6 +1,7 @@
 #pragma once
 #include "exiv2/exiv2.hpp"
 #include "DataStructs.h"
+#include "TiffFile.h"
 
 class MetadataReader
 {
@@ -8,13 +9,20 @@ class MetadataReader
 	{
 		ImageWidth = 0x0100,
 		ImageHeight = 0x0101,
+		BitsPerSample = 0x0102,
 		Compression = 0x0103,
 		PhotometricInterpretation = 0x0106,
 		CameraMaker = 0x010f,
 		CameraModel = 0x0110,
 		StripOffsets = 0x0111,
 		SamplesPerPixel = 0x0115,
+		RowsPerStrip = 0x0116,
 		StripByteCounts = 0x0117,
+		TileWidth = 0x0142,
+		TileLength = 0x0143,
+		TileOffsets = 0x0144,
+		TileByteCounts = 0x0145,
+		SampleFormat = 0x0153,
 		CFAPattern2 = 0x828e,
 		FNumber = 0x829d,
 		FocalLength = 0x920a,
@@ -24,7 +32,16 @@ class MetadataReader
 		ActiveArea = 0xc68d
 	};
 
+	static QSharedPointer<Metadata> readMetadataNative(const QString& filename);
+	static bool readRawDirectory(const TiffFile& tiffFile, const TiffFile::Directory& directory, int photometricInterpretation, const QSharedPointer<Metadata>& metadata);
+	static QSharedPointer<Metadata> readMetadataExiv2(const QString& filename);
+	static QSharedPointer<Metadata> completeMetadata(const QSharedPointer<Metadata>& metadata);
+	static bool isFrameLayoutCompatible(const QSharedPointer<Metadata>& metadata, const QSharedPointer<Metadata>& frameMetadata);
 	static int findRawIFD(Exiv2::ExifData* exifData, int* photometricInterpretation);
+	static QList<int> findAdditionalRawIFDs(Exiv2::ExifData* exifData, int rawIFDid, int photometricInterpretation);
+	static bool readFrameLayout(Exiv2::ExifData* exifData, int ifdId, const QSharedPointer<Metadata>& metadata, Metadata::FrameLayout& frame);
+	static void readValues(const Exiv2::Exifdatum& exifDatum, QList<qint64>& values);
+	static bool fillDataLayout(const QSharedPointer<Metadata>& metadata, const QList<qint64>& stripOffsets, const QList<qint64>& stripByteCounts, int rowsPerStrip, const QList<qint64>& tileOffsets, const QList<qint64>& tileByteCounts);
 
 public:
 	static QSharedPointer<Metadata> readMetadata(const QString& filename);
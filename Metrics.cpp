@@ -0,0 +1,174 @@
+#include <QJsonArray>
+#include "Metrics.h"
+
+QAtomicInteger<qint64> Metrics::counters[CountersCount];
+QAtomicInteger<qint64> Metrics::gauges[GaugesCount];
+QAtomicInteger<qint64> Metrics::stageBuckets[StagesCount][bucketsCount];
+QAtomicInteger<qint64> Metrics::stageSums[StagesCount];
+
+static QElapsedTimer createStartTimer()
+{
+	QElapsedTimer timer;
+	timer.start();
+	return timer;
+}
+
+// Started with the process, rates are calculated over its whole lifetime.
+static const QElapsedTimer startTimer = createStartTimer();
+
+Metrics::GaugeScope::GaugeScope(GaugeEnum gauge, qint64 value) : gauge(gauge), value(value)
+{
+	addToGauge(gauge, value);
+}
+
+Metrics::GaugeScope::~GaugeScope()
+{
+	addToGauge(gauge, -value);
+}
+
+Metrics::StageTimer::StageTimer(StageEnum stage) : stage(stage), span(getName(stage), "stage")
+{
+	timer.start();
+}
+
+Metrics::StageTimer::~StageTimer()
+{
+	observe(stage, timer.nsecsElapsed() / 1000);
+}
+
+void Metrics::add(CounterEnum counter, qint64 value)
+{
+	counters[counter].fetchAndAddRelaxed(value);
+}
+
+void Metrics::addToGauge(GaugeEnum gauge, qint64 value)
+{
+	gauges[gauge].fetchAndAddRelaxed(value);
+}
+
+void Metrics::observe(StageEnum stage, qint64 duration)
+{
+	int bucket = 0;
+	while (bucket < bucketsCount - 1 && duration > bucketBounds[bucket] * 1000)
+	{
+		bucket++;
+	}
+
+	stageBuckets[stage][bucket].fetchAndAddRelaxed(1);
+	stageSums[stage].fetchAndAddRelaxed(duration);
+}
+
+qint64 Metrics::getUptime()
+{
+	return startTimer.elapsed();
+}
+
+QJsonObject Metrics::getSnapshot()
+{
+	const qint64 uptime = getUptime();
+
+	QJsonObject counterValues;
+	for (int counter = 0; counter < CountersCount; counter++)
+	{
+		counterValues[getName(static_cast<CounterEnum>(counter))] = counters[counter].loadRelaxed();
+	}
+
+	QJsonObject gaugeValues;
+	for (int gauge = 0; gauge < GaugesCount; gauge++)
+	{
+		gaugeValues[getName(static_cast<GaugeEnum>(gauge))] = gauges[gauge].loadRelaxed();
+	}
+
+	// Buckets are not cumulative here, unlike in the Prometheus text.
+	QJsonObject stages;
+	for (int stage = 0; stage < StagesCount; stage++)
+	{
+		QJsonArray buckets;
+		qint64 count = 0;
+		for (int bucket = 0; bucket < bucketsCount; bucket++)
+		{
+			const qint64 bucketCount = stageBuckets[stage][bucket].loadRelaxed();
+			buckets.append(bucketCount);
+			count += bucketCount;
+		}
+
+		QJsonObject stageValues;
+		stageValues["count"] = count;
+		stageValues["sumMs"] = stageSums[stage].loadRelaxed() / 1000.0;
+		stageValues["buckets"] = buckets;
+		stages[getName(static_cast<StageEnum>(stage))] = stageValues;
+	}
+
+	QJsonArray bounds;
+	for (const qint64 bound : bucketBounds)
+	{
+		bounds.append(bound);
+	}
+
+	const qint64 hits = counters[ReferenceCacheHits].loadRelaxed();
+	const qint64 lookups = hits + counters[ReferenceCacheMisses].loadRelaxed();
+
+	QJsonObject snapshot;
+	snapshot["uptimeMs"] = uptime;
+	snapshot["filesPerSecond"] = uptime > 0 ? counters[FilesProcessed].loadRelaxed() * 1000.0 / uptime : 0;
+	snapshot["referenceCacheHitRate"] = lookups > 0 ? static_cast<double>(hits) / lookups : 0;
+	snapshot["counters"] = counterValues;
+	snapshot["gauges"] = gaugeValues;
+	snapshot["stages"] = stages;
+	snapshot["bucketBoundsMs"] = bounds;
+	return snapshot;
+}
+
+QByteArray Metrics::getPrometheusText()
+{
+	QByteArray text;
+
+	for (int counter = 0; counter < CountersCount; counter++)
+	{
+		const QByteArray name = QByteArray("flatfield_") + getName(static_cast<CounterEnum>(counter)) + "_total";
+		text += "# TYPE " + name + " counter\n";
+		text += name + ' ' + QByteArray::number(counters[counter].loadRelaxed()) + '\n';
+	}
+
+	for (int gauge = 0; gauge < GaugesCount; gauge++)
+	{
+		const QByteArray name = QByteArray("flatfield_") + getName(static_cast<GaugeEnum>(gauge));
+		text += "# TYPE " + name + " gauge\n";
+		text += name + ' ' + QByteArray::number(gauges[gauge].loadRelaxed()) + '\n';
+	}
+
+	text += "# TYPE flatfield_stage_duration_seconds histogram\n";
+	for (int stage = 0; stage < StagesCount; stage++)
+	{
+		const QByteArray label = QByteArray("stage=\"") + getName(static_cast<StageEnum>(stage)) + '"';
+		qint64 count = 0;
+		for (int bucket = 0; bucket < bucketsCount; bucket++)
+		{
+			count += stageBuckets[stage][bucket].loadRelaxed();
+			const QByteArray bound = bucket < bucketsCount - 1 ? QByteArray::number(bucketBounds[bucket] / 1000.0) : QByteArray("+Inf");
+			text += "flatfield_stage_duration_seconds_bucket{" + label + ",le=\"" + bound + "\"} " + QByteArray::number(count) + '\n';
+		}
+		text += "flatfield_stage_duration_seconds_sum{" + label + "} " + QByteArray::number(stageSums[stage].loadRelaxed() / 1000000.0) + '\n';
+		text += "flatfield_stage_duration_seconds_count{" + label + "} " + QByteArray::number(count) + '\n';
+	}
+
+	return text;
+}
+
+const char* Metrics::getName(CounterEnum counter)
+{
+	static const char* names[CountersCount] = { "files_processed", "files_failed", "bytes_read", "bytes_written", "reference_cache_hits", "reference_cache_misses" };
+	return names[counter];
+}
+
+const char* Metrics::getName(GaugeEnum gauge)
+{
+	static const char* names[GaugesCount] = { "prefetch_queue_depth", "io_requests_in_flight", "buffers_in_flight_bytes" };
+	return names[gauge];
+}
+
+const char* Metrics::getName(StageEnum stage)
+{
+	static const char* names[StagesCount] = { "read", "split", "blur", "correct", "scale", "assemble", "save" };
+	return names[stage];
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <QAtomicInteger>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QJsonObject>
+
+#include "Tracer.h"
+
+// Counters, gauges and stage latency histograms of the engine. They are process wide and updated without locks from all processing
+// threads. Snapshot is taken as JSON or as text in the Prometheus exposition format.
+class Metrics
+{
+public:
+	enum CounterEnum
+	{
+		FilesProcessed,
+		FilesFailed,
+		// Raw data transferred by AsyncFileIO and written through mapped output files.
+		BytesRead,
+		BytesWritten,
+		// Items which reused the blurred reference of the previous item, and items which prepared it.
+		ReferenceCacheHits,
+		ReferenceCacheMisses,
+		CountersCount
+	};
+
+	enum GaugeEnum
+	{
+		// Items loaded in background by the prefetcher and not taken yet.
+		PrefetchQueueDepth,
+		// Blocks submitted to AsyncFileIO which are not completed yet.
+		IORequestsInFlight,
+		// Image and reference buffers of the items being loaded or corrected.
+		BuffersInFlightBytes,
+		GaugesCount
+	};
+
+	enum StageEnum
+	{
+		Read,
+		Split,
+		Blur,
+		Correct,
+		Scale,
+		Assemble,
+		Save,
+		StagesCount
+	};
+
+	// Adds the value to the gauge for the lifetime of the scope.
+	class GaugeScope
+	{
+		GaugeEnum gauge;
+		qint64 value;
+
+	public:
+		GaugeScope(GaugeEnum gauge, qint64 value);
+		~GaugeScope();
+	};
+
+	// Records the lifetime of the scope in the histogram of the stage, and as a span of the trace.
+	class StageTimer
+	{
+		StageEnum stage;
+		Tracer::Span span;
+		QElapsedTimer timer;
+
+	public:
+		explicit StageTimer(StageEnum stage);
+		~StageTimer();
+	};
+
+private:
+	// Upper bounds of the histogram buckets in milliseconds, the last bucket has no bound.
+	static constexpr qint64 bucketBounds[] = { 1, 5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000 };
+	static constexpr int bucketsCount = sizeof(bucketBounds) / sizeof(bucketBounds[0]) + 1;
+
+	static QAtomicInteger<qint64> counters[CountersCount];
+	static QAtomicInteger<qint64> gauges[GaugesCount];
+	static QAtomicInteger<qint64> stageBuckets[StagesCount][bucketsCount];
+	static QAtomicInteger<qint64> stageSums[StagesCount];
+
+	static const char* getName(CounterEnum counter);
+	static const char* getName(GaugeEnum gauge);
+	static qint64 getUptime();
+
+public:
+	static const char* getName(StageEnum stage);
+	static void add(CounterEnum counter, qint64 value = 1);
+	static void addToGauge(GaugeEnum gauge, qint64 value);
+	// Duration is in microseconds.
+	static void observe(StageEnum stage, qint64 duration);
+	static QJsonObject getSnapshot();
+	static QByteArray getPrometheusText();
+};
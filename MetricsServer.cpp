@@ -0,0 +1,65 @@
+#include <QJsonDocument>
+#include "MetricsServer.h"
+#include "Metrics.h"
+
+MetricsServer::MetricsServer(QObject* parent) : QObject(parent)
+{
+	connect(&server, &QTcpServer::newConnection, this, &MetricsServer::slotNewConnection);
+}
+
+bool MetricsServer::listen(quint16 port)
+{
+	return server.listen(QHostAddress::LocalHost, port);
+}
+
+QString MetricsServer::getErrorString() const
+{
+	return server.errorString();
+}
+
+void MetricsServer::slotNewConnection()
+{
+	while (server.hasPendingConnections())
+	{
+		QTcpSocket* client = server.nextPendingConnection();
+		connect(client, &QTcpSocket::readyRead, this, [this, client]()
+		{
+			if (client->canReadLine())
+			{
+				handle(client, client->readLine());
+			}
+		});
+		connect(client, &QTcpSocket::disconnected, client, &QObject::deleteLater);
+	}
+}
+
+void MetricsServer::handle(QTcpSocket* client, const QByteArray& requestLine)
+{
+	// Request line is "GET /path HTTP/1.1", headers which follow it are not needed.
+	const QList<QByteArray> parts = requestLine.trimmed().split(' ');
+	if (parts.size() < 2 || parts[0] != "GET")
+	{
+		send(client, "405 Method Not Allowed", "text/plain", "Only GET is supported\n");
+	}
+	else if (parts[1] == "/metrics")
+	{
+		send(client, "200 OK", "text/plain; version=0.0.4", Metrics::getPrometheusText());
+	}
+	else if (parts[1] == "/metrics.json")
+	{
+		send(client, "200 OK", "application/json", QJsonDocument(Metrics::getSnapshot()).toJson(QJsonDocument::Compact));
+	}
+	else
+	{
+		send(client, "404 Not Found", "text/plain", "Not found\n");
+	}
+}
+
+void MetricsServer::send(QTcpSocket* client, const QByteArray& status, const QByteArray& contentType, const QByteArray& body)
+{
+	client->write("HTTP/1.1 " + status + "\r\n" +
+		"Content-Type: " + contentType + "\r\n" +
+		"Content-Length: " + QByteArray::number(body.size()) + "\r\n" +
+		"Connection: close\r\n\r\n" + body);
+	client->disconnectFromHost();
+}
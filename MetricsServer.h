@@ -0,0 +1,28 @@
+#pragma once
+#include <QByteArray>
+#include <QObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+
+// HTTP endpoint with the metrics of the command line runner, for scraping by Prometheus or a look with curl. It listens on localhost only:
+// - /metrics returns the text exposition format,
+// - /metrics.json returns the JSON snapshot.
+// Each connection gets one response and is closed, requests are not parsed further than the request line.
+class MetricsServer : public QObject
+{
+	Q_OBJECT
+
+	QTcpServer server;
+
+	void handle(QTcpSocket* client, const QByteArray& requestLine);
+	static void send(QTcpSocket* client, const QByteArray& status, const QByteArray& contentType, const QByteArray& body);
+
+private slots:
+	void slotNewConnection();
+
+public:
+	explicit MetricsServer(QObject* parent = nullptr);
+
+	bool listen(quint16 port);
+	QString getErrorString() const;
+};
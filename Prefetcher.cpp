@@ -0,0 +1,262 @@
+#include <algorithm>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrentRun>
+#include "Prefetcher.h"
+#include "AsyncFileIO.h"
+#include "MemoryProfiler.h"
+#include "Metrics.h"
+#include "Processor.h"
+#include "RawDataIO.h"
+#include "Tracer.h"
+
+// Background loads run in their own thread and read their tiles inline, so they don't take threads of the global pool from the correction.
+class PrefetchThreadPool : public QThreadPool
+{
+public:
+	PrefetchThreadPool()
+	{
+		setMaxThreadCount(1);
+	}
+};
+
+Q_GLOBAL_STATIC(PrefetchThreadPool, prefetchThreadPool)
+
+QAtomicInt Prefetcher::lookahead = Prefetcher::defaultLookahead;
+QAtomicInt Prefetcher::memoryLimit = Prefetcher::defaultMemoryLimit;
+
+template<>
+Prefetcher::Slot<uint16_t>& Prefetcher::getSlot<uint16_t>()
+{
+	return integerSlot;
+}
+
+template<>
+Prefetcher::Slot<float>& Prefetcher::getSlot<float>()
+{
+	return floatSlot;
+}
+
+void Prefetcher::setLookahead(int items)
+{
+	lookahead.storeRelaxed(qMax(0, items));
+}
+
+int Prefetcher::getLookahead()
+{
+	return lookahead.loadRelaxed();
+}
+
+void Prefetcher::setMemoryLimit(int megabytes)
+{
+	memoryLimit.storeRelaxed(qMax(0, megabytes));
+}
+
+int Prefetcher::getMemoryLimit()
+{
+	return memoryLimit.loadRelaxed();
+}
+
+Prefetcher::~Prefetcher()
+{
+	// Background loads write into the slot buffers, so they must finish first.
+	integerSlot.future.waitForFinished();
+	floatSlot.future.waitForFinished();
+	releaseSlot(integerSlot);
+	releaseSlot(floatSlot);
+}
+
+bool Prefetcher::load(const ProcessingParcel& parcel, int index, QList<QList<uint16_t>>& imageBuffers, QList<uint16_t>& referenceBuffer)
+{
+	return loadItem(parcel, index, imageBuffers, referenceBuffer);
+}
+
+bool Prefetcher::load(const ProcessingParcel& parcel, int index, QList<QList<float>>& imageBuffers, QList<float>& referenceBuffer)
+{
+	return loadItem(parcel, index, imageBuffers, referenceBuffer);
+}
+
+void Prefetcher::recycle(QList<QList<uint16_t>>& imageBuffers, QList<uint16_t>& referenceBuffer)
+{
+	recycleItem(imageBuffers, referenceBuffer);
+}
+
+void Prefetcher::recycle(QList<QList<float>>& imageBuffers, QList<float>& referenceBuffer)
+{
+	recycleItem(imageBuffers, referenceBuffer);
+}
+
+void Prefetcher::readAhead(const ProcessingParcel& parcel, int index)
+{
+	// Going back means the next pass over the same items.
+	if (index <= loadedIndex)
+	{
+		readAheadIndex = -1;
+	}
+	loadedIndex = index;
+
+	for (int i = qMax(index + 1, readAheadIndex + 1); i <= index + getLookahead() && i < parcel.items.size(); i++)
+	{
+		const QSharedPointer<FileInfo>& sourceFile = parcel.items[i].sourceFile;
+		for (int frame = 0; frame < sourceFile->metadata->getFramesCount(); frame++)
+		{
+			const QSharedPointer<Metadata> frameMetadata = sourceFile->metadata->getFrame(frame);
+			if (frameMetadata->dataOffsets.isEmpty())
+			{
+				continue;
+			}
+
+			qint64 end = 0;
+			for (int tile = 0; tile < frameMetadata->dataOffsets.size(); tile++)
+			{
+				end = qMax(end, frameMetadata->dataOffsets[tile] + frameMetadata->dataByteCounts[tile]);
+			}
+
+			const qint64 start = *std::min_element(frameMetadata->dataOffsets.begin(), frameMetadata->dataOffsets.end());
+			AsyncFileIO::readAhead(sourceFile->filePath, start, end - start);
+		}
+		readAheadIndex = i;
+	}
+}
+
+template<typename T>
+bool Prefetcher::loadItem(const ProcessingParcel& parcel, int index, QList<QList<T>>& imageBuffers, QList<T>& referenceBuffer)
+{
+	Slot<T>& slot = getSlot<T>();
+	bool isLoaded = false;
+
+	if (slot.index == index)
+	{
+		isLoaded = slot.future.result();
+		imageBuffers.swap(slot.imageBuffers);
+		referenceBuffer.swap(slot.referenceBuffer);
+		releaseSlot(slot);
+	}
+
+	if (!isLoaded)
+	{
+		allocate(parcel.items[index], isReferenceNeeded(parcel, index), imageBuffers, referenceBuffer, slot);
+		isLoaded = read(parcel.items[index], imageBuffers, referenceBuffer, QThreadPool::globalInstance());
+	}
+
+	readAhead(parcel, index);
+	if (index + 1 < parcel.items.size())
+	{
+		if (parcel.items[index + 1].sourceFile->metadata->isFloatingPoint())
+		{
+			startLoading<float>(parcel, index + 1);
+		}
+		else
+		{
+			startLoading<uint16_t>(parcel, index + 1);
+		}
+	}
+
+	return isLoaded;
+}
+
+template<typename T>
+void Prefetcher::startLoading(const ProcessingParcel& parcel, int index)
+{
+	Slot<T>& slot = getSlot<T>();
+
+	// Load of an item which was not requested, e.g. after a stop, is dropped.
+	if (slot.index >= 0)
+	{
+		slot.future.waitForFinished();
+		recycleItem(slot.imageBuffers, slot.referenceBuffer);
+		releaseSlot(slot);
+	}
+
+	const ProcessingItem item = parcel.items[index];
+	const bool withReference = isReferenceNeeded(parcel, index);
+	if (getItemSize(item, withReference) > static_cast<qint64>(getMemoryLimit()) * 1024 * 1024)
+	{
+		return;
+	}
+
+	allocate(item, withReference, slot.imageBuffers, slot.referenceBuffer, slot);
+	slot.index = index;
+	slot.size = getItemSize(item, withReference);
+	Metrics::addToGauge(Metrics::PrefetchQueueDepth, 1);
+	Metrics::addToGauge(Metrics::BuffersInFlightBytes, slot.size);
+	MemoryProfiler::allocate(Metrics::Read, slot.size, false);
+
+	QList<QList<T>>* imageBuffers = &slot.imageBuffers;
+	QList<T>* referenceBuffer = &slot.referenceBuffer;
+	slot.future = QtConcurrent::run(prefetchThreadPool, [item, imageBuffers, referenceBuffer]()
+		{
+			const Tracer::Span span("prefetch", "item", item.sourceFile->filePath);
+			return read(item, *imageBuffers, *referenceBuffer, nullptr);
+		});
+}
+
+template<typename T>
+void Prefetcher::releaseSlot(Slot<T>& slot)
+{
+	if (slot.index < 0)
+	{
+		return;
+	}
+
+	Metrics::addToGauge(Metrics::PrefetchQueueDepth, -1);
+	Metrics::addToGauge(Metrics::BuffersInFlightBytes, -slot.size);
+	MemoryProfiler::release(Metrics::Read, slot.size);
+	slot.index = -1;
+	slot.size = 0;
+}
+
+template<typename T>
+void Prefetcher::recycleItem(QList<QList<T>>& imageBuffers, QList<T>& referenceBuffer)
+{
+	Slot<T>& slot = getSlot<T>();
+	slot.spareImageBuffers.swap(imageBuffers);
+	slot.spareReferenceBuffer.swap(referenceBuffer);
+}
+
+template<typename T>
+void Prefetcher::allocate(const ProcessingItem& item, bool withReference, QList<QList<T>>& imageBuffers, QList<T>& referenceBuffer, Slot<T>& slot)
+{
+	const QSharedPointer<Metadata>& metadata = item.sourceFile->metadata;
+	const qsizetype size = static_cast<qsizetype>(metadata->imageHeight) * metadata->imageWidth * metadata->getSamplesPerPixel();
+
+	// Spare buffers already have the capacity of the previous item, in a batch it is usually the same size.
+	if (imageBuffers.isEmpty())
+	{
+		imageBuffers.swap(slot.spareImageBuffers);
+		referenceBuffer.swap(slot.spareReferenceBuffer);
+	}
+
+	imageBuffers.resize(metadata->getFramesCount());
+	for (int frame = 0; frame < imageBuffers.size(); frame++)
+	{
+		imageBuffers[frame].resize(size);
+	}
+	referenceBuffer.resize(withReference ? size : 0);
+}
+
+template<typename T>
+bool Prefetcher::read(const ProcessingItem& item, QList<QList<T>>& imageBuffers, QList<T>& referenceBuffer, QThreadPool* threadPool)
+{
+	for (int frame = 0; frame < imageBuffers.size(); frame++)
+	{
+		if (!RawDataIO::read(item.sourceFile->filePath, item.sourceFile->metadata->getFrame(frame), imageBuffers[frame], true, threadPool))
+		{
+			return false;
+		}
+	}
+
+	// Only the first frame of a multi frame reference is used.
+	return referenceBuffer.isEmpty() || RawDataIO::read(item.referenceFile->filePath, item.referenceFile->metadata, referenceBuffer, false, threadPool);
+}
+
+bool Prefetcher::isReferenceNeeded(const ProcessingParcel& parcel, int index)
+{
+	return index == 0 || Processor::getReferenceKey(parcel.items[index]) != Processor::getReferenceKey(parcel.items[index - 1]);
+}
+
+qint64 Prefetcher::getItemSize(const ProcessingItem& item, bool withReference)
+{
+	const QSharedPointer<Metadata>& metadata = item.sourceFile->metadata;
+	const qint64 sampleSize = metadata->isFloatingPoint() ? sizeof(float) : sizeof(uint16_t);
+	return (metadata->getFramesCount() + (withReference ? 1 : 0)) * static_cast<qint64>(metadata->imageHeight) * metadata->imageWidth * metadata->getSamplesPerPixel() * sampleSize;
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <QAtomicInt>
+#include <QFuture>
+#include <QThreadPool>
+
+#include "DataStructs.h"
+
+// Keeps the disk busy with the next items of a parcel while the current one is corrected. Raw data of the next items is read ahead
+// into the page cache, and the next item is fully loaded in background if its buffers fit into the memory limit.
+class Prefetcher
+{
+	template<typename T>
+	struct Slot
+	{
+		int index = -1;
+		// Size of the loaded item, counted in the metrics while it is queued.
+		qint64 size = 0;
+		QList<QList<T>> imageBuffers;
+		QList<T> referenceBuffer;
+		QFuture<bool> future;
+		// Buffers of the last processed item, reused for the next load.
+		QList<QList<T>> spareImageBuffers;
+		QList<T> spareReferenceBuffer;
+	};
+
+	static QAtomicInt lookahead;
+	static QAtomicInt memoryLimit;
+
+	Slot<uint16_t> integerSlot;
+	Slot<float> floatSlot;
+	// Last item which was loaded and last item which was read ahead, so every item is read ahead once per pass.
+	int loadedIndex = -1;
+	int readAheadIndex = -1;
+
+	template<typename T>
+	Slot<T>& getSlot();
+	template<typename T>
+	bool loadItem(const ProcessingParcel& parcel, int index, QList<QList<T>>& imageBuffers, QList<T>& referenceBuffer);
+	template<typename T>
+	void startLoading(const ProcessingParcel& parcel, int index);
+	template<typename T>
+	static void releaseSlot(Slot<T>& slot);
+	template<typename T>
+	void recycleItem(QList<QList<T>>& imageBuffers, QList<T>& referenceBuffer);
+	template<typename T>
+	static void allocate(const ProcessingItem& item, bool withReference, QList<QList<T>>& imageBuffers, QList<T>& referenceBuffer, Slot<T>& slot);
+	template<typename T>
+	// Tiles are read in the given pool, or in the calling thread when it is nullptr.
+	static bool read(const ProcessingItem& item, QList<QList<T>>& imageBuffers, QList<T>& referenceBuffer, QThreadPool* threadPool);
+	// Reference buffer is counted only when the reference is read with the item.
+	static qint64 getItemSize(const ProcessingItem& item, bool withReference);
+	// Reference of an item with the same reference as the previous one is already prepared, so it is not read.
+	static bool isReferenceNeeded(const ProcessingParcel& parcel, int index);
+
+public:
+	static constexpr int defaultLookahead = 2;
+	static constexpr int defaultMemoryLimit = 1024;
+
+	// Number of next items which are read ahead.
+	static void setLookahead(int items);
+	static int getLookahead();
+	// Memory in megabytes which one background loaded item may take, larger items are only read ahead.
+	static void setMemoryLimit(int megabytes);
+	static int getMemoryLimit();
+
+	~Prefetcher();
+
+	// Fills buffers of the item, from the prefetched data when it is ready, and starts prefetching of the following items. The reference
+	// buffer is left empty when the item has the same reference as the previous one.
+	bool load(const ProcessingParcel& parcel, int index, QList<QList<uint16_t>>& imageBuffers, QList<uint16_t>& referenceBuffer);
+	bool load(const ProcessingParcel& parcel, int index, QList<QList<float>>& imageBuffers, QList<float>& referenceBuffer);
+	// Takes buffers of a processed item back, so they are reused instead of allocated again.
+	void recycle(QList<QList<uint16_t>>& imageBuffers, QList<uint16_t>& referenceBuffer);
+	void recycle(QList<QList<float>>& imageBuffers, QList<float>& referenceBuffer);
+	// Issues read ahead for raw data of the items following the given one, without loading them.
+	void readAhead(const ProcessingParcel& parcel, int index);
+};
@@ -1,9 +1,17 @@
 #include <QtConcurrent/QtConcurrent>
+#include <QElapsedTimer>
+#include <QFileInfo>
 #include "Processor.h"
+#include "AsyncFileIO.h"
 #include "FileUtils.h"
+#include "GainMap.h"
 #include "ImageProcessorBayer.h"
 #include "ImageProcessorMono.h"
 #include "ImageProcessorRGB.h"
+#include "Manifest.h"
+#include "Metrics.h"
+#include "Tracer.h"
+#include "RawDataIO.h"
 
 
 void Processor::stopProcessing()
@@ -20,87 +28,488 @@ void Processor::process(const ProcessingParcel& parcel)
 
 void Processor::processWorker(const ProcessingParcel& parcel)
 {
-	emit signalProcessingStarted(parcel.globalProcessingOptions.calculateCommonScaleForBatch ? parcel.items.size() * 2 : parcel.items.size());
+	ProcessingCallbacks callbacks;
+	callbacks.started = [this](int total) { emit signalProcessingStarted(total); };
+	callbacks.progressChanged = [this](int progress) { emit signalProcessingProgressChanged(progress); };
+	callbacks.itemProcessed = [this](int index, bool isProcessed, qint64 elapsed) { emit signalItemProcessed(index, isProcessed, elapsed); };
+	callbacks.itemUpToDate = [this](int index) { emit signalItemUpToDate(index); };
+	callbacks.firstPassFinished = [this](float commonScaleForBatch, int processedCount) { emit signalFirstPassFinished(commonScaleForBatch, processedCount); };
+	callbacks.isStopRequested = [this]() { return stopAfterCurrent; };
+
+	run(parcel, callbacks);
+
+	emit signalProcessingFinished();
+}
+
+void Processor::run(const ProcessingParcel& batch, const ProcessingCallbacks& callbacks)
+{
+	// Gain maps are not scaled, so they don't need the common scale pass.
+	const bool isGainMapOutput = batch.savingOptions.outputFormat == SavingOptions::OutputFormatEnum::GainMap;
+	const bool isTwoPass = batch.globalProcessingOptions.scaleChannelsToAvoidClipping && batch.globalProcessingOptions.calculateCommonScaleForBatch && !isGainMapOutput;
+	const GlobalProcessingOptions::BatchPassEnum batchPass = isTwoPass ? batch.globalProcessingOptions.batchPass : GlobalProcessingOptions::BatchPassEnum::BothPasses;
+	const bool isFirstPass = isTwoPass && batchPass != GlobalProcessingOptions::BatchPassEnum::SecondPass;
+	const bool isSecondPass = batchPass != GlobalProcessingOptions::BatchPassEnum::FirstPass;
+
+	// Up to date items are left out of the parcel. The common scale depends on the whole batch, so it is processed in full unless all items are up to date.
+	// Shards don't see the whole batch, so all their items are processed.
+	Manifest manifest(batch);
+	QList<bool> upToDate(batch.items.size());
+	for (int i = 0; i < batch.items.size(); i++)
+	{
+		upToDate[i] = batchPass == GlobalProcessingOptions::BatchPassEnum::BothPasses &&
+			manifest.isUpToDate(batch.items[i], getDestinationFilePath(batch.items[i], batch.savingOptions, batch.sourceFileRoot));
+	}
+	if (isTwoPass && upToDate.contains(false))
+	{
+		upToDate.fill(false);
+	}
+
+	ProcessingParcel parcel = batch;
+	parcel.items.clear();
+	QList<int> batchIndexes;
+	for (int i = 0; i < batch.items.size(); i++)
+	{
+		if (!upToDate[i])
+		{
+			parcel.items.append(batch.items[i]);
+			batchIndexes.append(i);
+		}
+	}
+
+	callbacks.started((isFirstPass + isSecondPass) * parcel.items.size());
+
+	for (int i = 0; i < batch.items.size(); i++)
+	{
+		if (upToDate[i])
+		{
+			callbacks.itemUpToDate(i);
+		}
+	}
+
+	// Reference files are reused across the batch, so they are read ahead and never dropped from the page cache, even when they are
+	// also sources.
+	QSet<QString> referenceFiles;
+	for (int i = 0; i < parcel.items.size(); i++)
+	{
+		const QSharedPointer<FileInfo>& referenceFile = parcel.items[i].referenceFile;
+		if (!referenceFiles.contains(referenceFile->filePath))
+		{
+			referenceFiles.insert(referenceFile->filePath);
+			AsyncFileIO::keepCached(referenceFile->filePath, referenceFile->metadata->dataOffset, referenceFile->metadata->dataSize);
+		}
+	}
 
 	TwoPassProcessingState twoPassProcessingState;
+	Prefetcher prefetcher;
+	PreparedReference preparedReference;
 
 	int step = 1;
-	if (parcel.globalProcessingOptions.scaleChannelsToAvoidClipping && parcel.globalProcessingOptions.calculateCommonScaleForBatch)
+	if (isFirstPass)
 	{
+		const Tracer::Span passSpan("firstPass", "batch");
+		int processedCount = 0;
 		for (int i = 0; i < parcel.items.size(); i++)
 		{
-			if (stopAfterCurrent)
+			if (callbacks.isStopRequested())
 			{
-				emit signalProcessingFinished();
 				return;
 			}
 
-			ProcessingItem item = parcel.items[i];
-			ImageProcessor* imageProcessor = getImageProcessor(item.sourceFile->metadata->rawType);
-			QList<uint16_t> imageBuffer(imageProcessor->getImageDataSize(item.sourceFile->metadata));
-			QList<uint16_t> referenceBuffer(imageProcessor->getImageDataSize(item.sourceFile->metadata));
+			const bool isProcessed = parcel.items[i].sourceFile->metadata->isFloatingPoint() ?
+				processItem<float>(parcel, i, twoPassProcessingState, false, prefetcher, preparedReference) :
+				processItem<uint16_t>(parcel, i, twoPassProcessingState, false, prefetcher, preparedReference);
 
-			if (!read(item, imageBuffer, referenceBuffer))
+			if (!isProcessed)
 			{
 				continue;
 			}
 
-			imageProcessor->process(imageBuffer, referenceBuffer, parcel, i, twoPassProcessingState);
-
-			delete imageProcessor;
+			processedCount++;
+			callbacks.progressChanged(step++);
+		}
 
-			emit signalProcessingProgressChanged(step++);
+		callbacks.firstPassFinished(twoPassProcessingState.commonScaleForBatch, processedCount);
+		if (!isSecondPass)
+		{
+			return;
 		}
+	}
 
+	if (isTwoPass)
+	{
 		twoPassProcessingState.performBatchScale = true;
+		if (!isFirstPass)
+		{
+			twoPassProcessingState.commonScaleForBatch = batch.globalProcessingOptions.mergedCommonScaleForBatch;
+		}
 	}
 
+	const Tracer::Span passSpan(isTwoPass ? "secondPass" : "pass", "batch");
 	for (int i = 0; i < parcel.items.size(); i++)
 	{
-		if (stopAfterCurrent)
+		if (callbacks.isStopRequested())
 		{
-			emit signalProcessingFinished();
 			return;
 		}
 
-		ProcessingItem item = parcel.items[i];
-		ImageProcessor* imageProcessor = getImageProcessor(item.sourceFile->metadata->rawType);
-		QList<uint16_t> imageBuffer(imageProcessor->getImageDataSize(item.sourceFile->metadata));
-		QList<uint16_t> referenceBuffer(imageProcessor->getImageDataSize(item.sourceFile->metadata));
+		QElapsedTimer timer;
+		timer.start();
 
-		if (!read(item, imageBuffer, referenceBuffer))
+		bool isProcessed;
+		if (isGainMapOutput)
+		{
+			// Only the reference raw data is read for gain maps, sources are just copied.
+			prefetcher.readAhead(parcel, i);
+			isProcessed = parcel.items[i].referenceFile->metadata->isFloatingPoint() ?
+				saveGainMap<float>(parcel, i) :
+				saveGainMap<uint16_t>(parcel, i);
+		}
+		else
+		{
+			isProcessed = parcel.items[i].sourceFile->metadata->isFloatingPoint() ?
+				processItem<float>(parcel, i, twoPassProcessingState, true, prefetcher, preparedReference) :
+				processItem<uint16_t>(parcel, i, twoPassProcessingState, true, prefetcher, preparedReference);
+		}
+
+		// Sources are read again by the second pass, so they are dropped from the page cache only after the last one.
+		if (!referenceFiles.contains(parcel.items[i].sourceFile->filePath))
+		{
+			AsyncFileIO::releaseCached(parcel.items[i].sourceFile->filePath, false);
+		}
+
+		if (isProcessed)
+		{
+			manifest.update(parcel.items[i], getDestinationFilePath(parcel.items[i], parcel.savingOptions, parcel.sourceFileRoot));
+		}
+
+		Metrics::add(isProcessed ? Metrics::FilesProcessed : Metrics::FilesFailed);
+		callbacks.itemProcessed(batchIndexes[i], isProcessed, timer.elapsed());
+
+		if (!isProcessed)
 		{
 			continue;
 		}
 
-		imageProcessor->process(imageBuffer, referenceBuffer, parcel, i, twoPassProcessingState);
+		callbacks.progressChanged(step++);
+	}
+}
+
+template<typename T>
+bool Processor::processItem(const ProcessingParcel& parcel, int index, TwoPassProcessingState& twoPassProcessingState, bool saveResult, Prefetcher& prefetcher, PreparedReference& preparedReference)
+{
+	const ProcessingItem& item = parcel.items[index];
+	const Tracer::Span itemSpan("item", "item", item.sourceFile->filePath);
+	const MemoryProfiler::ItemScope memoryItemScope(item.sourceFile->filePath);
+	QList<QList<T>> imageBuffers;
+	QList<T> referenceBuffer;
+
+	// Next items are prefetched while this one is corrected.
+	if (!prefetcher.load(parcel, index, imageBuffers, referenceBuffer))
+	{
+		return false;
+	}
+
+	qint64 buffersSize = referenceBuffer.size();
+	for (int frame = 0; frame < imageBuffers.size(); frame++)
+	{
+		buffersSize += imageBuffers[frame].size();
+	}
+	const Metrics::GaugeScope buffersInFlight(Metrics::BuffersInFlightBytes, buffersSize * static_cast<qint64>(sizeof(T)));
+	const MemoryProfiler::Allocation rawBuffers(Metrics::Read, buffersSize * static_cast<qint64>(sizeof(T)));
+
+	ImageProcessor* imageProcessor = getImageProcessor(item.sourceFile->metadata->rawType);
+
+	// Items of a batch usually share few references, so reading and blurring of the reference is skipped for all but the first one of a run.
+	const QString referenceKey = getReferenceKey(item);
+	if (preparedReference.key != referenceKey)
+	{
+		Metrics::add(Metrics::ReferenceCacheMisses);
 
+		// Prefetcher doesn't read the reference of the previous item again, but that item could have failed before it was prepared.
+		if (referenceBuffer.isEmpty())
+		{
+			referenceBuffer.resize(imageProcessor->getImageDataSize(item.sourceFile->metadata));
+			if (!RawDataIO::read(item.referenceFile->filePath, item.referenceFile->metadata, referenceBuffer))
+			{
+				delete imageProcessor;
+				prefetcher.recycle(imageBuffers, referenceBuffer);
+				return false;
+			}
+		}
+
+		preparedReference.allocation.reset();
+		preparedReference.channels = imageProcessor->prepareReference(referenceBuffer, item);
+		preparedReference.key = referenceKey;
+		preparedReference.allocation.reset(new MemoryProfiler::Allocation(Metrics::Blur, MemoryProfiler::getSize(preparedReference.channels)));
+	}
+	else
+	{
+		Metrics::add(Metrics::ReferenceCacheHits);
+	}
+
+	// Mapped output gets corrected samples straight from the assemble step, so the image buffers are not written at all.
+	QFile destinationFile;
+	const QList<uchar*> mappings = saveResult ? mapOutput(item, parcel.savingOptions, parcel.sourceFileRoot, destinationFile) : QList<uchar*>();
+	QList<T*> outputBuffers;
+	for (int frame = 0; frame < mappings.size(); frame++)
+	{
+		outputBuffers.append(reinterpret_cast<T*>(mappings[frame]));
+	}
+
+	imageProcessor->process(imageBuffers, ImageProcessor::getChannelViews(preparedReference.channels), parcel, index, twoPassProcessingState, outputBuffers);
+
+	delete imageProcessor;
+
+	bool isSaved = true;
+	if (!mappings.isEmpty())
+	{
+		isSaved = unmapOutput(item, parcel.savingOptions, destinationFile, mappings);
+	}
+	else if (saveResult)
+	{
+		isSaved = save(item, parcel.savingOptions, parcel.sourceFileRoot, imageBuffers);
+	}
+
+	prefetcher.recycle(imageBuffers, referenceBuffer);
+
+	return isSaved;
+}
+
+QList<QList<float>> Processor::prepareReference(const ProcessingItem& item)
+{
+	return item.sourceFile->metadata->isFloatingPoint() ? readReference<float>(item) : readReference<uint16_t>(item);
+}
+
+template<typename T>
+QList<QList<float>> Processor::readReference(const ProcessingItem& item)
+{
+	ImageProcessor* imageProcessor = getImageProcessor(item.sourceFile->metadata->rawType);
+	QList<T> referenceBuffer(imageProcessor->getImageDataSize(item.sourceFile->metadata));
+
+	QList<QList<float>> referenceChannels;
+	if (RawDataIO::read(item.referenceFile->filePath, item.referenceFile->metadata, referenceBuffer))
+	{
+		referenceChannels = imageProcessor->prepareReference(referenceBuffer, item);
+	}
+
+	delete imageProcessor;
+	return referenceChannels;
+}
+
+bool Processor::processPrepared(const ProcessingParcel& parcel, int index, TwoPassProcessingState& twoPassProcessingState, bool saveResult, const QList<const float*>& referenceChannels)
+{
+	const QSharedPointer<Metadata>& metadata = parcel.items[index].sourceFile->metadata;
+	if (parcel.savingOptions.outputFormat == SavingOptions::OutputFormatEnum::GainMap)
+	{
+		return metadata->isFloatingPoint() ? saveGainMap<float>(parcel, index) : saveGainMap<uint16_t>(parcel, index);
+	}
+
+	return metadata->isFloatingPoint() ?
+		processPreparedItem<float>(parcel, index, twoPassProcessingState, saveResult, referenceChannels) :
+		processPreparedItem<uint16_t>(parcel, index, twoPassProcessingState, saveResult, referenceChannels);
+}
+
+template<typename T>
+bool Processor::processPreparedItem(const ProcessingParcel& parcel, int index, TwoPassProcessingState& twoPassProcessingState, bool saveResult, const QList<const float*>& referenceChannels)
+{
+	const ProcessingItem& item = parcel.items[index];
+	const QSharedPointer<Metadata>& metadata = item.sourceFile->metadata;
+	ImageProcessor* imageProcessor = getImageProcessor(metadata->rawType);
+
+	QList<QList<T>> imageBuffers(metadata->getFramesCount());
+	for (int frame = 0; frame < imageBuffers.size(); frame++)
+	{
+		imageBuffers[frame].resize(imageProcessor->getImageDataSize(metadata));
+		if (!RawDataIO::read(item.sourceFile->filePath, metadata->getFrame(frame), imageBuffers[frame], true))
+		{
+			delete imageProcessor;
+			return false;
+		}
+	}
+
+	QFile destinationFile;
+	const QList<uchar*> mappings = saveResult ? mapOutput(item, parcel.savingOptions, parcel.sourceFileRoot, destinationFile) : QList<uchar*>();
+	QList<T*> outputBuffers;
+	for (int frame = 0; frame < mappings.size(); frame++)
+	{
+		outputBuffers.append(reinterpret_cast<T*>(mappings[frame]));
+	}
+
+	imageProcessor->process(imageBuffers, referenceChannels, parcel, index, twoPassProcessingState, outputBuffers);
+
+	delete imageProcessor;
+
+	bool isSaved = true;
+	if (!mappings.isEmpty())
+	{
+		isSaved = unmapOutput(item, parcel.savingOptions, destinationFile, mappings);
+	}
+	else if (saveResult)
+	{
+		isSaved = save(item, parcel.savingOptions, parcel.sourceFileRoot, imageBuffers);
+	}
+
+	// The first pass doesn't save, the source is read again by the second one. Sources which are also references stay cached.
+	bool isReference = false;
+	for (int i = 0; i < parcel.items.size() && !isReference; i++)
+	{
+		isReference = parcel.items[i].referenceFile->filePath == item.sourceFile->filePath;
+	}
+	if (saveResult && !isReference)
+	{
+		AsyncFileIO::releaseCached(item.sourceFile->filePath, false);
+	}
+
+	return isSaved;
+}
+
+template<typename T>
+bool Processor::saveGainMap(const ProcessingParcel& parcel, int index)
+{
+	// Only the reference is read, source raw data stays untouched in the output.
+	const ProcessingItem& item = parcel.items[index];
+	const Tracer::Span itemSpan("item", "item", item.sourceFile->filePath);
+	ImageProcessor* imageProcessor = getImageProcessor(item.sourceFile->metadata->rawType);
+	QList<T> referenceBuffer(imageProcessor->getImageDataSize(item.sourceFile->metadata));
+
+	if (!RawDataIO::read(item.referenceFile->filePath, item.referenceFile->metadata, referenceBuffer))
+	{
 		delete imageProcessor;
+		return false;
+	}
+
+	const QList<QList<float>> gains = imageProcessor->calculateGains(referenceBuffer, item);
 
-		save(item, parcel.savingOptions, parcel.sourceFileRoot, imageBuffer);
+	delete imageProcessor;
 
-		emit signalProcessingProgressChanged(step++);
+	const Metrics::StageTimer stageTimer(Metrics::Save);
+	const QString destinationFilePath = createDestinationFile(item, parcel.savingOptions, parcel.sourceFileRoot);
+	const bool isSaved = GainMap::write(destinationFilePath, item.sourceFile->metadata, GainMap::createOpcodes(item.sourceFile->metadata, gains));
+	if (!isSaved)
+	{
+		QFile::remove(destinationFilePath);
+	}
+	else
+	{
+		AsyncFileIO::releaseCached(destinationFilePath, true);
 	}
 
-	emit signalProcessingFinished();
+	return isSaved;
+}
+
+bool Processor::save(const ProcessingItem& item, const SavingOptions& savingOptions, const QString& sourceFilesRoot, const QList<QList<uint16_t>>& imageBuffers)
+{
+	const Metrics::StageTimer stageTimer(Metrics::Save);
+	const QString destinationFilePath = createDestinationFile(item, savingOptions, sourceFilesRoot);
+
+	// Compressed sources can't be overwritten in place, so they are always saved compressed.
+	const bool isCompressed = savingOptions.outputFormat == SavingOptions::OutputFormatEnum::LosslessJPEG || item.sourceFile->metadata->compression != Metadata::CompressionEnum::Uncompressed;
+	bool isSaved = true;
+	if (isCompressed)
+	{
+		// Frames are compressed in one pass, so raw data of none of them is left in the file.
+		isSaved = RawDataIO::writeCompressed(destinationFilePath, item.sourceFile->metadata, imageBuffers);
+	}
+	else
+	{
+		for (int frame = 0; frame < imageBuffers.size() && isSaved; frame++)
+		{
+			isSaved = RawDataIO::write(destinationFilePath, item.sourceFile->metadata->getFrame(frame), imageBuffers[frame]);
+		}
+	}
+
+	if (!isSaved)
+	{
+		// Unmodified copy must not be left in the output as if it was processed.
+		QFile::remove(destinationFilePath);
+		return false;
+	}
+
+	AsyncFileIO::releaseCached(destinationFilePath, true);
+	return true;
 }
 
-bool Processor::read(const ProcessingItem& item, QList<uint16_t>& imageBuffer, QList<uint16_t>& referenceBuffer)
+bool Processor::save(const ProcessingItem& item, const SavingOptions& savingOptions, const QString& sourceFilesRoot, const QList<QList<float>>& imageBuffers)
 {
-	QFile imageFile(item.sourceFile->filePath);
-	QFile referenceFile(item.referenceFile->filePath);
+	const Metrics::StageTimer stageTimer(Metrics::Save);
+	// Lossless JPEG can't hold float data, so float files are always saved in the source format.
+	const QString destinationFilePath = createDestinationFile(item, savingOptions, sourceFilesRoot);
+	for (int frame = 0; frame < imageBuffers.size(); frame++)
+	{
+		if (!RawDataIO::write(destinationFilePath, item.sourceFile->metadata->getFrame(frame), imageBuffers[frame]))
+		{
+			QFile::remove(destinationFilePath);
+			return false;
+		}
+	}
 
-	if (!imageFile.open(QIODevice::ReadOnly) || !referenceFile.open(QIODevice::ReadOnly) || !imageFile.seek(item.sourceFile->metadata->dataOffset) || !referenceFile.seek(item.referenceFile->metadata->dataOffset))
+	AsyncFileIO::releaseCached(destinationFilePath, true);
+	return true;
+}
+
+QList<uchar*> Processor::mapOutput(const ProcessingItem& item, const SavingOptions& savingOptions, const QString& sourceFilesRoot, QFile& destinationFile)
+{
+	const QSharedPointer<Metadata>& metadata = item.sourceFile->metadata;
+	if (!savingOptions.mapOutputFile || savingOptions.outputFormat != SavingOptions::OutputFormatEnum::SameAsSource)
+	{
+		return {};
+	}
+
+	for (int frame = 0; frame < metadata->getFramesCount(); frame++)
+	{
+		if (!RawDataIO::isMappable(metadata->getFrame(frame)))
+		{
+			return {};
+		}
+	}
+
+	destinationFile.setFileName(createDestinationFile(item, savingOptions, sourceFilesRoot));
+	if (destinationFile.fileName().isEmpty() || !destinationFile.open(QIODevice::ReadWrite))
 	{
+		return {};
+	}
+
+	QList<uchar*> mappings;
+	for (int frame = 0; frame < metadata->getFramesCount(); frame++)
+	{
+		uchar* mapping = RawDataIO::map(destinationFile, metadata->getFrame(frame));
+		if (mapping == nullptr)
+		{
+			// Output is saved the regular way then, the copy is created again.
+			for (int i = 0; i < mappings.size(); i++)
+			{
+				destinationFile.unmap(mappings[i]);
+			}
+			destinationFile.remove();
+			return {};
+		}
+		mappings.append(mapping);
+	}
+
+	return mappings;
+}
+
+bool Processor::unmapOutput(const ProcessingItem& item, const SavingOptions& savingOptions, QFile& destinationFile, const QList<uchar*>& mappings)
+{
+	const Metrics::StageTimer stageTimer(Metrics::Save);
+	bool isSaved = true;
+	for (int frame = 0; frame < mappings.size(); frame++)
+	{
+		isSaved = RawDataIO::unmap(destinationFile, mappings[frame], item.sourceFile->metadata->getFrame(frame), savingOptions.outputSync) && isSaved;
+	}
+	destinationFile.close();
+
+	if (!isSaved)
+	{
+		destinationFile.remove();
 		return false;
 	}
 
-	imageFile.read((char*)imageBuffer.data(), item.sourceFile->metadata->dataSize);
-	referenceFile.read((char*)referenceBuffer.data(), item.referenceFile->metadata->dataSize);
+	AsyncFileIO::releaseCached(destinationFile.fileName(), true);
 	return true;
 }
 
-void Processor::save(const ProcessingItem& item, const SavingOptions& savingOptions, const QString& sourceFilesRoot, const QList<uint16_t>& imageBuffer)
+QString Processor::createDestinationFile(const ProcessingItem& item, const SavingOptions& savingOptions, const QString& sourceFilesRoot)
 {
 	QString destinationFilePath;
 
@@ -114,12 +523,47 @@ void Processor::save(const ProcessingItem& item, const SavingOptions& savingOpti
 		destinationFilePath = FileUtils::createDestinationFileInSubfolder(item.sourceFile->filePath, savingOptions);
 	}
 
-	QFile destinationFile(destinationFilePath);
+	return destinationFilePath;
+}
 
-	if (destinationFile.open(QIODevice::ReadWrite) && destinationFile.seek(item.sourceFile->metadata->dataOffset))
+QString Processor::getReferenceKey(const ProcessingItem& item)
+{
+	// Reference channels are split in the layout of the source and normalized by its color pattern, so they are a part of the key too.
+	// The active area sets the size of the channels.
+	const QSharedPointer<Metadata>& metadata = item.sourceFile->metadata;
+	QStringList activeArea;
+	for (const int value : metadata->activeArea)
+	{
+		activeArea.append(QString::number(value));
+	}
+	QStringList cfaColorPattern;
+	for (const Metadata::CFAPatternEnum color : metadata->cfaColorPattern)
 	{
-		destinationFile.write((char*)imageBuffer.data(), item.sourceFile->metadata->dataSize);
+		cfaColorPattern.append(QString::number(static_cast<int>(color)));
 	}
+	QStringList blackLevels;
+	for (const uint16_t value : metadata->blackLevels)
+	{
+		blackLevels.append(QString::number(value));
+	}
+
+	return QString("%1|%2|%3|%4|%5|%6|%7|%8|%9")
+		.arg(item.referenceFile->filePath)
+		.arg(QFileInfo(item.referenceFile->filePath).lastModified().toMSecsSinceEpoch())
+		.arg(item.processingOptions.gaussianBlurSigma)
+		.arg(static_cast<int>(metadata->rawType))
+		.arg(metadata->imageWidth)
+		.arg(metadata->imageHeight)
+		.arg(activeArea.join(","))
+		.arg(cfaColorPattern.join(","))
+		.arg(blackLevels.join(","));
+}
+
+QString Processor::getDestinationFilePath(const ProcessingItem& item, const SavingOptions& savingOptions, const QString& sourceFilesRoot)
+{
+	return savingOptions.saveTo == SavingOptions::SaveToEnum::Folder ?
+		FileUtils::getDestinationFilePathInDestinationFolder(item.sourceFile->filePath, sourceFilesRoot, savingOptions) :
+		FileUtils::getDestinationFilePathInSubfolder(item.sourceFile->filePath, savingOptions);
 }
 
 ImageProcessor* Processor::getImageProcessor(Metadata::RawTypeEnum rawType)
@@ -1,8 +1,25 @@
 #pragma once
+#include <functional>
+#include <QFile>
 #include <QObject>
 
 #include "DataStructs.h"
 #include "ImageProcessor.h"
+#include "MemoryProfiler.h"
+#include "Prefetcher.h"
+
+// Progress of a synchronous run, called in the thread which runs it. Indexes are indexes of the items of the given parcel.
+struct ProcessingCallbacks
+{
+	std::function<void(int total)> started = [](int) {};
+	std::function<void(int progress)> progressChanged = [](int) {};
+	std::function<void(int index, bool isProcessed, qint64 elapsed)> itemProcessed = [](int, bool, qint64) {};
+	std::function<void(int index)> itemUpToDate = [](int) {};
+	// Called after the first pass of a two pass batch with the common scale of the batch and the number of items it was calculated from.
+	std::function<void(float commonScaleForBatch, int processedCount)> firstPassFinished = [](float, int) {};
+	// Checked before every item, processing is stopped when it returns true.
+	std::function<bool()> isStopRequested = []() { return false; };
+};
 
 class Processor : public QObject
 {
@@ -10,17 +27,53 @@ class Processor : public QObject
 
 		bool stopAfterCurrent = false;
 
+	// Blurred reference of the previous item, reused by the following items with the same reference.
+	struct PreparedReference
+	{
+		QString key;
+		QList<QList<float>> channels;
+		QSharedPointer<MemoryProfiler::Allocation> allocation;
+	};
+
 	void processWorker(const ProcessingParcel& parcel);
-	static bool read(const ProcessingItem& item, QList<uint16_t>& imageBuffer, QList<uint16_t>& referenceBuffer);
-	static void save(const ProcessingItem& item, const SavingOptions& savingOptions, const QString& sourceFilesRoot, const QList<uint16_t>& imageBuffer);
-	static ImageProcessor* getImageProcessor(Metadata::RawTypeEnum rawType);
+	template<typename T>
+	static bool processItem(const ProcessingParcel& parcel, int index, TwoPassProcessingState& twoPassProcessingState, bool saveResult, Prefetcher& prefetcher, PreparedReference& preparedReference);
+	template<typename T>
+	static bool processPreparedItem(const ProcessingParcel& parcel, int index, TwoPassProcessingState& twoPassProcessingState, bool saveResult, const QList<const float*>& referenceChannels);
+	template<typename T>
+	static QList<QList<float>> readReference(const ProcessingItem& item);
+	template<typename T>
+	static bool saveGainMap(const ProcessingParcel& parcel, int index);
+	static bool save(const ProcessingItem& item, const SavingOptions& savingOptions, const QString& sourceFilesRoot, const QList<QList<uint16_t>>& imageBuffers);
+	static bool save(const ProcessingItem& item, const SavingOptions& savingOptions, const QString& sourceFilesRoot, const QList<QList<float>>& imageBuffers);
+	static QList<uchar*> mapOutput(const ProcessingItem& item, const SavingOptions& savingOptions, const QString& sourceFilesRoot, QFile& destinationFile);
+	static bool unmapOutput(const ProcessingItem& item, const SavingOptions& savingOptions, QFile& destinationFile, const QList<uchar*>& mappings);
+	static QString createDestinationFile(const ProcessingItem& item, const SavingOptions& savingOptions, const QString& sourceFilesRoot);
 
 signals:
 	void signalProcessingStarted(int total);
 	void signalProcessingFinished();
 	void signalProcessingProgressChanged(int progress);
+	// Emitted once per item of the parcel, with the time it took in milliseconds. Items of the first pass of a two pass batch are not reported.
+	void signalItemProcessed(int index, bool isProcessed, qint64 elapsed);
+	// Emitted for items which are recorded in the manifest as processed with the same inputs and options, they are not processed again.
+	void signalItemUpToDate(int index);
+	void signalFirstPassFinished(float commonScaleForBatch, int processedCount);
 
 public:
+	// Runs the parcel in a pool thread and reports progress with signals.
 	void process(const ProcessingParcel& parcel);
 	void stopProcessing();
+	// Processes the parcel in the calling thread, without signals or event loop.
+	static void run(const ProcessingParcel& batch, const ProcessingCallbacks& callbacks = {});
+	static ImageProcessor* getImageProcessor(Metadata::RawTypeEnum rawType);
+	// Items with the same key have the same prepared reference.
+	static QString getReferenceKey(const ProcessingItem& item);
+	static QString getDestinationFilePath(const ProcessingItem& item, const SavingOptions& savingOptions, const QString& sourceFilesRoot);
+	// Reads and blurs the reference of the item, it is the same for all items with the same reference and blur sigma. Empty if the
+	// reference can't be read.
+	static QList<QList<float>> prepareReference(const ProcessingItem& item);
+	// Processes one item with the prepared reference outside of a batch run, e.g. in a worker process. The state is used as in the passes
+	// of a two pass batch, the first pass doesn't save the result. The manifest is not updated.
+	static bool processPrepared(const ProcessingParcel& parcel, int index, TwoPassProcessingState& twoPassProcessingState, bool saveResult, const QList<const float*>& referenceChannels);
 };
\ No newline at end of file
@@ -0,0 +1,941 @@
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <QFile>
+#include <QFloat16>
+#include <QSaveFile>
+#include <QThread>
+#include <QtEndian>
+#include <QtConcurrent/QtConcurrentMap>
+#include "RawDataIO.h"
+#include "AsyncFileIO.h"
+#include "BitPacking.h"
+#include "LosslessJpeg.h"
+#include "Metrics.h"
+#include "TiffFile.h"
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+bool RawDataIO::read(const QString& filePath, const QSharedPointer<Metadata>& metadata, QList<uint16_t>& imageBuffer, bool streamed, QThreadPool* threadPool)
+{
+	const Metrics::StageTimer stageTimer(Metrics::Read);
+	if (metadata->isFloatingPoint() || imageBuffer.size() < static_cast<qsizetype>(metadata->imageHeight) * metadata->imageWidth * metadata->getSamplesPerPixel())
+	{
+		return false;
+	}
+
+	uint16_t* buffer = imageBuffer.data();
+	if (!threadPool)
+	{
+		return readTiles(filePath, metadata, buffer, TileRange(0, metadata->dataOffsets.size()), streamed);
+	}
+
+	QFuture<bool> future = QtConcurrent::mapped(threadPool, splitTiles(metadata), [&filePath, &metadata, buffer, streamed](const TileRange& range)
+		{
+			return readTiles(filePath, metadata, buffer, range, streamed);
+		});
+	future.waitForFinished();
+
+	return !future.results().contains(false);
+}
+
+bool RawDataIO::write(const QString& filePath, const QSharedPointer<Metadata>& metadata, const QList<uint16_t>& imageBuffer)
+{
+	// Compressed data can't be overwritten in place, its size depends on the content.
+	if (filePath.isEmpty() || metadata->compression != Metadata::CompressionEnum::Uncompressed || metadata->isFloatingPoint() || imageBuffer.size() < static_cast<qsizetype>(metadata->imageHeight) * metadata->imageWidth * metadata->getSamplesPerPixel())
+	{
+		return false;
+	}
+
+	const uint16_t* buffer = imageBuffer.constData();
+	QFuture<bool> future = QtConcurrent::mapped(splitTiles(metadata), [&filePath, &metadata, buffer](const TileRange& range)
+		{
+			return writeTiles(filePath, metadata, buffer, range);
+		});
+	future.waitForFinished();
+
+	return !future.results().contains(false);
+}
+
+bool RawDataIO::read(const QString& filePath, const QSharedPointer<Metadata>& metadata, QList<float>& imageBuffer, bool streamed, QThreadPool* threadPool)
+{
+	const Metrics::StageTimer stageTimer(Metrics::Read);
+	if (!metadata->isFloatingPoint() || imageBuffer.size() < static_cast<qsizetype>(metadata->imageHeight) * metadata->imageWidth * metadata->getSamplesPerPixel())
+	{
+		return false;
+	}
+
+	float* buffer = imageBuffer.data();
+	if (!threadPool)
+	{
+		return readFloatTiles(filePath, metadata, buffer, TileRange(0, metadata->dataOffsets.size()), streamed);
+	}
+
+	QFuture<bool> future = QtConcurrent::mapped(threadPool, splitTiles(metadata), [&filePath, &metadata, buffer, streamed](const TileRange& range)
+		{
+			return readFloatTiles(filePath, metadata, buffer, range, streamed);
+		});
+	future.waitForFinished();
+
+	return !future.results().contains(false);
+}
+
+bool RawDataIO::write(const QString& filePath, const QSharedPointer<Metadata>& metadata, const QList<float>& imageBuffer)
+{
+	if (filePath.isEmpty() || !metadata->isFloatingPoint() || imageBuffer.size() < static_cast<qsizetype>(metadata->imageHeight) * metadata->imageWidth * metadata->getSamplesPerPixel())
+	{
+		return false;
+	}
+
+	const float* buffer = imageBuffer.constData();
+	QFuture<bool> future = QtConcurrent::mapped(splitTiles(metadata), [&filePath, &metadata, buffer](const TileRange& range)
+		{
+			return writeFloatTiles(filePath, metadata, buffer, range);
+		});
+	future.waitForFinished();
+
+	return !future.results().contains(false);
+}
+
+bool RawDataIO::writeCompressed(const QString& filePath, const QSharedPointer<Metadata>& metadata, const QList<QList<uint16_t>>& imageBuffers)
+{
+	QFile file(filePath);
+	if (filePath.isEmpty() || imageBuffers.size() != metadata->getFramesCount() || !file.open(QIODevice::ReadWrite))
+	{
+		return false;
+	}
+
+	TiffFile tiffFile(&file);
+	if (!tiffFile.read())
+	{
+		return false;
+	}
+
+	QList<const TiffFile::Directory*> rawDirectories;
+	QList<qint64> dataOffsets;
+	QList<qint64> dataByteCounts;
+	for (int frame = 0; frame < imageBuffers.size(); frame++)
+	{
+		const QSharedPointer<Metadata> frameMetadata = metadata->getFrame(frame);
+		const TiffFile::Directory* rawDirectory = tiffFile.findDirectoryByDataOffset(frameMetadata->dataOffset);
+		if (rawDirectory == nullptr || imageBuffers[frame].size() < static_cast<qsizetype>(metadata->imageHeight) * metadata->imageWidth * metadata->getSamplesPerPixel())
+		{
+			return false;
+		}
+
+		rawDirectories.append(rawDirectory);
+		dataOffsets.append(frameMetadata->dataOffsets);
+		dataByteCounts.append(frameMetadata->dataByteCounts);
+	}
+
+	const int tilesAcross = (metadata->imageWidth + compressedTileSize - 1) / compressedTileSize;
+	const int tilesDown = (metadata->imageHeight + compressedTileSize - 1) / compressedTileSize;
+	QList<int> tiles(tilesAcross * tilesDown);
+	std::iota(tiles.begin(), tiles.end(), 0);
+
+	QList<QList<QByteArray>> encodedFrames;
+	for (int frame = 0; frame < imageBuffers.size(); frame++)
+	{
+		const uint16_t* buffer = imageBuffers[frame].constData();
+		QFuture<QByteArray> future = QtConcurrent::mapped(tiles, [&metadata, buffer](int tile)
+			{
+				return encodeTile(metadata, buffer, tile);
+			});
+		future.waitForFinished();
+		encodedFrames.append(future.results());
+	}
+
+	// The file is rebuilt without the original raw data whenever all of its structure is known.
+	if (isCompactable(tiffFile))
+	{
+		return writeCompacted(file, tiffFile, rawDirectories, encodedFrames);
+	}
+
+	// Otherwise original raw data is overwritten only when nothing else follows it, and new tiles are appended leaving the original
+	// raw data behind as dead bytes when something does.
+	qint64 position = isDataAtFileEnd(dataOffsets, dataByteCounts, file.size()) ? *std::min_element(dataOffsets.begin(), dataOffsets.end()) : file.size();
+	position += position % 2;
+
+	QList<TiffFile::Directory> directories;
+	for (int frame = 0; frame < encodedFrames.size(); frame++)
+	{
+		const QList<QByteArray>& encodedTiles = encodedFrames[frame];
+		QList<quint64> tileOffsets;
+		QList<AsyncFileIO::Block> blocks;
+		for (int i = 0; i < encodedTiles.size(); i++)
+		{
+			tileOffsets.append(position);
+			blocks.append({ position, encodedTiles[i].size(), const_cast<char*>(encodedTiles[i].constData()) });
+			position += encodedTiles[i].size() + encodedTiles[i].size() % 2;
+		}
+
+		if (position > 0xffffffffLL || !AsyncFileIO::write(filePath, blocks))
+		{
+			return false;
+		}
+
+		directories.append(createCompressedDirectory(tiffFile, *rawDirectories[frame], tileOffsets, encodedTiles));
+	}
+
+	// Directories follow the tiles. Frames chained in IFD0 point to each other, so next offsets of the replaced directories are moved too.
+	QList<qint64> directoryPositions;
+	for (int frame = 0; frame < directories.size(); frame++)
+	{
+		directoryPositions.append(position);
+		position += TiffFile::getDirectorySize(directories[frame]);
+	}
+	if (position > 0xffffffffLL)
+	{
+		return false;
+	}
+
+	for (int frame = 0; frame < directories.size(); frame++)
+	{
+		for (int next = 0; next < directories.size(); next++)
+		{
+			if (directories[frame].nextOffset != 0 && directories[frame].nextOffset == rawDirectories[next]->offset)
+			{
+				directories[frame].nextOffset = static_cast<quint32>(directoryPositions[next]);
+			}
+		}
+
+		if (tiffFile.writeDirectory(directoryPositions[frame], directories[frame]) < 0)
+		{
+			return false;
+		}
+	}
+
+	// Pointers are switched once all new directories are written.
+	for (int frame = 0; frame < directories.size(); frame++)
+	{
+		if (!tiffFile.writePointer(rawDirectories[frame]->pointerPosition, static_cast<quint32>(directoryPositions[frame])))
+		{
+			return false;
+		}
+	}
+
+	return file.resize(position);
+}
+
+bool RawDataIO::isCompactable(const TiffFile& tiffFile)
+{
+	const QList<TiffFile::Directory>& directories = tiffFile.getDirectories();
+	const auto isDirectoryRead = [&directories](quint64 offset)
+		{
+			return offset == 0 || std::any_of(directories.begin(), directories.end(), [offset](const TiffFile::Directory& directory) { return directory.offset == static_cast<qint64>(offset); });
+		};
+
+	for (const TiffFile::Directory& directory : directories)
+	{
+		if (!isDirectoryRead(directory.nextOffset))
+		{
+			return false;
+		}
+
+		for (const TiffFile::Entry& entry : directory.entries)
+		{
+			// Data behind unknown types and maker notes may be addressed by absolute offsets, so it can't be moved.
+			if (TiffFile::getTypeSize(entry.type) == 0 || entry.tag == TiffFile::TagEnum::MakerNote)
+			{
+				return false;
+			}
+
+			if (entry.tag == TiffFile::TagEnum::SubIFDs || TiffFile::isDirectoryPointer(entry.tag))
+			{
+				for (quint32 i = 0; i < entry.count; i++)
+				{
+					if (TiffFile::getTypeSize(entry.type) != 4 || !isDirectoryRead(tiffFile.getValue(entry, i)))
+					{
+						return false;
+					}
+				}
+			}
+		}
+
+		for (const auto& dataTags : compactedDataTags)
+		{
+			const TiffFile::Entry* offsets = directory.findEntry(dataTags.first);
+			const TiffFile::Entry* byteCounts = directory.findEntry(dataTags.second);
+			if (offsets != nullptr && (byteCounts == nullptr || byteCounts->count != offsets->count))
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+bool RawDataIO::writeCompacted(QFile& file, const TiffFile& tiffFile, const QList<const TiffFile::Directory*>& rawDirectories, const QList<QList<QByteArray>>& encodedFrames)
+{
+	QSaveFile saveFile(file.fileName());
+	if (!saveFile.open(QIODevice::WriteOnly))
+	{
+		return false;
+	}
+
+	// Header is written once the position of the first directory is known, data blocks of all directories follow it, directories are last.
+	qint64 position = 8;
+	if (!saveFile.seek(position))
+	{
+		return false;
+	}
+
+	const QList<TiffFile::Directory>& sourceDirectories = tiffFile.getDirectories();
+	QList<TiffFile::Directory> directories;
+	for (const TiffFile::Directory& sourceDirectory : sourceDirectories)
+	{
+		const int frame = rawDirectories.indexOf(&sourceDirectory);
+		if (frame >= 0)
+		{
+			const QList<QByteArray>& encodedTiles = encodedFrames[frame];
+			QList<quint64> tileOffsets;
+			for (const QByteArray& encodedTile : encodedTiles)
+			{
+				tileOffsets.append(position);
+				if (saveFile.write(encodedTile) != encodedTile.size() || (encodedTile.size() % 2 != 0 && !saveFile.putChar('\0')))
+				{
+					return false;
+				}
+				position += encodedTile.size() + encodedTile.size() % 2;
+			}
+
+			directories.append(createCompressedDirectory(tiffFile, sourceDirectory, tileOffsets, encodedTiles));
+			continue;
+		}
+
+		// Previews and other images keep their data, only their offsets change.
+		TiffFile::Directory directory = sourceDirectory;
+		for (const auto& dataTags : compactedDataTags)
+		{
+			const TiffFile::Entry* offsets = sourceDirectory.findEntry(dataTags.first);
+			if (offsets == nullptr)
+			{
+				continue;
+			}
+
+			const TiffFile::Entry* byteCounts = sourceDirectory.findEntry(dataTags.second);
+			QList<quint64> newOffsets;
+			for (quint32 i = 0; i < offsets->count; i++)
+			{
+				const qint64 size = static_cast<qint64>(tiffFile.getValue(*byteCounts, i));
+				if (!file.seek(static_cast<qint64>(tiffFile.getValue(*offsets, i))))
+				{
+					return false;
+				}
+
+				const QByteArray data = file.read(size);
+				newOffsets.append(position);
+				if (data.size() != size || saveFile.write(data) != size || (size % 2 != 0 && !saveFile.putChar('\0')))
+				{
+					return false;
+				}
+				position += size + size % 2;
+			}
+
+			directory.setEntry(tiffFile.createEntry(dataTags.first, TiffFile::TypeEnum::Long, newOffsets));
+		}
+		directories.append(directory);
+	}
+
+	QList<qint64> directoryPositions;
+	for (const TiffFile::Directory& directory : directories)
+	{
+		directoryPositions.append(position);
+		position += TiffFile::getDirectorySize(directory);
+	}
+	if (position > 0xffffffffLL)
+	{
+		return false;
+	}
+
+	// Every directory pointer targets a read directory, isCompactable checked it.
+	const auto getDirectoryPosition = [&sourceDirectories, &directoryPositions](quint64 offset) -> quint64
+		{
+			for (int i = 0; i < sourceDirectories.size(); i++)
+			{
+				if (sourceDirectories[i].offset == static_cast<qint64>(offset))
+				{
+					return directoryPositions[i];
+				}
+			}
+			return 0;
+		};
+
+	for (int i = 0; i < directories.size(); i++)
+	{
+		TiffFile::Directory& directory = directories[i];
+		directory.nextOffset = static_cast<quint32>(getDirectoryPosition(directory.nextOffset));
+		for (const TiffFile::Entry& entry : sourceDirectories[i].entries)
+		{
+			if (entry.tag == TiffFile::TagEnum::SubIFDs || TiffFile::isDirectoryPointer(entry.tag))
+			{
+				QList<quint64> pointers;
+				for (quint32 pointer = 0; pointer < entry.count; pointer++)
+				{
+					pointers.append(getDirectoryPosition(tiffFile.getValue(entry, pointer)));
+				}
+				directory.setEntry(tiffFile.createEntry(entry.tag, static_cast<TiffFile::TypeEnum>(entry.type), pointers));
+			}
+		}
+
+		const QByteArray directoryData = tiffFile.getDirectoryData(directoryPositions[i], directory);
+		if (directoryData.isEmpty() || saveFile.write(directoryData) != directoryData.size())
+		{
+			return false;
+		}
+	}
+
+	// The first read directory starts the IFD0 chain.
+	if (!saveFile.seek(0) || saveFile.write(tiffFile.getHeader(static_cast<quint32>(directoryPositions[0]))) != 8)
+	{
+		return false;
+	}
+
+	// Source handle is closed before the copy is replaced, so the rename doesn't fail on Windows.
+	file.close();
+	return saveFile.commit();
+}
+
+TiffFile::Directory RawDataIO::createCompressedDirectory(const TiffFile& tiffFile, const TiffFile::Directory& rawDirectory, const QList<quint64>& tileOffsets, const QList<QByteArray>& encodedTiles)
+{
+	QList<quint64> tileByteCounts;
+	for (const QByteArray& encodedTile : encodedTiles)
+	{
+		tileByteCounts.append(encodedTile.size());
+	}
+
+	// BitsPerSample is kept, tiles are encoded with the source bit depth.
+	TiffFile::Directory directory = rawDirectory;
+	directory.removeEntry(TiffFile::TagEnum::StripOffsets);
+	directory.removeEntry(TiffFile::TagEnum::StripByteCounts);
+	directory.removeEntry(TiffFile::TagEnum::RowsPerStrip);
+	directory.setEntry(tiffFile.createEntry(TiffFile::TagEnum::Compression, TiffFile::TypeEnum::Short, { Metadata::CompressionEnum::LosslessJPEG }));
+	directory.setEntry(tiffFile.createEntry(TiffFile::TagEnum::TileWidth, TiffFile::TypeEnum::Long, { compressedTileSize }));
+	directory.setEntry(tiffFile.createEntry(TiffFile::TagEnum::TileLength, TiffFile::TypeEnum::Long, { compressedTileSize }));
+	directory.setEntry(tiffFile.createEntry(TiffFile::TagEnum::TileOffsets, TiffFile::TypeEnum::Long, tileOffsets));
+	directory.setEntry(tiffFile.createEntry(TiffFile::TagEnum::TileByteCounts, TiffFile::TypeEnum::Long, tileByteCounts));
+	return directory;
+}
+
+bool RawDataIO::isMappable(const QSharedPointer<Metadata>& metadata)
+{
+	const qint64 sampleSize = metadata->isFloatingPoint() ? sizeof(float) : sizeof(uint16_t);
+	if (metadata->compression != Metadata::CompressionEnum::Uncompressed || !metadata->isStripLayout() || !isHostByteOrder(metadata) ||
+		metadata->bitsPerSample != sampleSize * 8 || metadata->dataOffsets[0] % sampleSize != 0)
+	{
+		return false;
+	}
+
+	const qint64 imageRowBytes = static_cast<qint64>(metadata->imageWidth) * metadata->getSamplesPerPixel() * sampleSize;
+	for (int tile = 0; tile < metadata->dataOffsets.size(); tile++)
+	{
+		if (metadata->dataOffsets[tile] != metadata->dataOffsets[0] + getTileBufferOffset(metadata, tile) * sampleSize ||
+			metadata->dataByteCounts[tile] < getTileRows(metadata, tile) * imageRowBytes)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+uchar* RawDataIO::map(QFile& file, const QSharedPointer<Metadata>& metadata)
+{
+	if (!isMappable(metadata) || metadata->dataOffsets[0] + getMappedSize(metadata) > file.size())
+	{
+		return nullptr;
+	}
+
+	return file.map(metadata->dataOffsets[0], getMappedSize(metadata));
+}
+
+bool RawDataIO::unmap(QFile& file, uchar* data, const QSharedPointer<Metadata>& metadata, SavingOptions::OutputSyncEnum outputSync)
+{
+	bool isSynced = true;
+	if (outputSync != SavingOptions::OutputSyncEnum::NoSync)
+	{
+#ifdef Q_OS_WIN
+		isSynced = FlushViewOfFile(data, static_cast<SIZE_T>(getMappedSize(metadata))) &&
+			(outputSync == SavingOptions::OutputSyncEnum::AsyncSync || FlushFileBuffers(reinterpret_cast<HANDLE>(_get_osfhandle(file.handle()))));
+#else
+		// msync needs a page aligned address, the mapping starts at the page which contains the data offset.
+		const qint64 pageOffset = metadata->dataOffsets[0] % sysconf(_SC_PAGESIZE);
+		isSynced = msync(data - pageOffset, static_cast<size_t>(getMappedSize(metadata) + pageOffset), outputSync == SavingOptions::OutputSyncEnum::FullSync ? MS_SYNC : MS_ASYNC) == 0;
+#endif
+	}
+
+	const bool isUnmapped = file.unmap(data) && isSynced;
+	if (isUnmapped)
+	{
+		Metrics::add(Metrics::BytesWritten, getMappedSize(metadata));
+	}
+	return isUnmapped;
+}
+
+QList<RawDataIO::TileRange> RawDataIO::splitTiles(const QSharedPointer<Metadata>& metadata)
+{
+	// Every range is handled by one task with its own file handle, so the number of ranges is limited by the number of cores instead of tiles.
+	const int tilesCount = metadata->dataOffsets.size();
+	const int rangesCount = qBound(1, QThread::idealThreadCount(), tilesCount);
+
+	QList<TileRange> ranges;
+	for (int i = 0; i < rangesCount; i++)
+	{
+		ranges.append(TileRange(tilesCount * i / rangesCount, tilesCount * (i + 1) / rangesCount));
+	}
+	return ranges;
+}
+
+bool RawDataIO::readTiles(const QString& filePath, const QSharedPointer<Metadata>& metadata, uint16_t* imageBuffer, TileRange range, bool streamed)
+{
+	const int samplesPerPixel = metadata->getSamplesPerPixel();
+	const qint64 imageRowSize = static_cast<qint64>(metadata->imageWidth) * samplesPerPixel;
+	const qint64 tileRowSize = static_cast<qint64>(metadata->tileWidth) * samplesPerPixel;
+	const qint64 tileRowBytes = metadata->isBitPacked() ? BitPacking::getPackedSize(tileRowSize, metadata->bitsPerSample) : tileRowSize * static_cast<qint64>(sizeof(uint16_t));
+	const bool compressed = metadata->compression == Metadata::CompressionEnum::LosslessJPEG;
+	// Strip rows have the same width as image rows, so they are read in place.
+	const bool readInPlace = !compressed && !metadata->isBitPacked() && metadata->isStripLayout();
+
+	// All tiles of the range are read with one batch of requests and decoded afterwards.
+	QList<AsyncFileIO::Block> blocks;
+	qint64 rangeSize = 0;
+	for (int tile = range.first; tile < range.last; tile++)
+	{
+		const qint64 tileSize = compressed ? metadata->dataByteCounts[tile] : getTileRows(metadata, tile) * tileRowBytes;
+		if (!readInPlace && metadata->dataByteCounts[tile] < tileSize)
+		{
+			return false;
+		}
+
+		blocks.append({ metadata->dataOffsets[tile], readInPlace ? qMin(tileSize, metadata->dataByteCounts[tile]) : tileSize, nullptr });
+		rangeSize += readInPlace ? 0 : tileSize;
+	}
+
+	QByteArray rangeData;
+	rangeData.resize(rangeSize);
+	for (qint64 i = 0, position = 0; i < blocks.size(); position += readInPlace ? 0 : blocks[i].size, i++)
+	{
+		blocks[i].data = readInPlace ? reinterpret_cast<char*>(imageBuffer + getTileBufferOffset(metadata, range.first + i)) : rangeData.data() + position;
+	}
+
+	if (!AsyncFileIO::read(filePath, blocks, streamed))
+	{
+		return false;
+	}
+
+	for (int tile = range.first; tile < range.last; tile++)
+	{
+		const int rows = getTileRows(metadata, tile);
+		const int columnSamples = getTileColumns(metadata, tile) * samplesPerPixel;
+		uint16_t* destination = imageBuffer + getTileBufferOffset(metadata, tile);
+		const AsyncFileIO::Block& block = blocks[tile - range.first];
+
+		// Compressed tiles are decoded straight into the image buffer, edge tile padding is dropped by the decoder.
+		if (compressed)
+		{
+			if (!LosslessJpeg::decode(block.data, block.size, { destination, imageRowSize, static_cast<int>(tileRowSize), rows, columnSamples }))
+			{
+				return false;
+			}
+			continue;
+		}
+
+		// Packed rows are unpacked from the whole tile or strip, every row starts at a byte boundary.
+		if (metadata->isBitPacked())
+		{
+			for (int row = 0; row < rows; row++)
+			{
+				BitPacking::unpack(block.data + row * tileRowBytes, destination + row * imageRowSize, columnSamples, metadata->bitsPerSample);
+			}
+			continue;
+		}
+
+		if (readInPlace)
+		{
+			fromFileByteOrder(metadata, destination, destination, rows * imageRowSize);
+			continue;
+		}
+
+		const uint16_t* source = reinterpret_cast<const uint16_t*>(block.data);
+		for (int row = 0; row < rows; row++)
+		{
+			fromFileByteOrder(metadata, source + row * tileRowSize, destination + row * imageRowSize, columnSamples);
+		}
+	}
+
+	return true;
+}
+
+bool RawDataIO::writeTiles(const QString& filePath, const QSharedPointer<Metadata>& metadata, const uint16_t* imageBuffer, TileRange range)
+{
+	const int samplesPerPixel = metadata->getSamplesPerPixel();
+	const qint64 imageRowSize = static_cast<qint64>(metadata->imageWidth) * samplesPerPixel;
+	const qint64 tileRowSize = static_cast<qint64>(metadata->tileWidth) * samplesPerPixel;
+	const qint64 tileRowBytes = metadata->isBitPacked() ? BitPacking::getPackedSize(tileRowSize, metadata->bitsPerSample) : tileRowSize * static_cast<qint64>(sizeof(uint16_t));
+	// Strips in the host byte order are written directly from the image buffer.
+	const bool writeInPlace = !metadata->isBitPacked() && metadata->isStripLayout() && isHostByteOrder(metadata);
+
+	// Edge tiles are padded up to the full tile size, padding content is not used by readers.
+	QList<qint64> tileSizes;
+	qint64 rangeSize = 0;
+	for (int tile = range.first; tile < range.last; tile++)
+	{
+		tileSizes.append((metadata->isStripLayout() ? getTileRows(metadata, tile) : metadata->tileHeight) * tileRowBytes);
+		rangeSize += writeInPlace ? 0 : tileSizes.last();
+	}
+
+	// All tiles of the range are encoded first and written with one batch of requests.
+	QByteArray rangeData;
+	rangeData.fill(0, rangeSize);
+	QList<AsyncFileIO::Block> blocks;
+	qint64 position = 0;
+	for (int tile = range.first; tile < range.last; tile++)
+	{
+		const int rows = getTileRows(metadata, tile);
+		const int columnSamples = getTileColumns(metadata, tile) * samplesPerPixel;
+		const uint16_t* source = imageBuffer + getTileBufferOffset(metadata, tile);
+		const qint64 tileSize = tileSizes[tile - range.first];
+		char* tileData = writeInPlace ? const_cast<char*>(reinterpret_cast<const char*>(source)) : rangeData.data() + position;
+		position += writeInPlace ? 0 : tileSize;
+		blocks.append({ metadata->dataOffsets[tile], qMin(tileSize, metadata->dataByteCounts[tile]), tileData });
+
+		if (writeInPlace)
+		{
+			continue;
+		}
+
+		for (int row = 0; row < rows; row++)
+		{
+			if (metadata->isBitPacked())
+			{
+				BitPacking::pack(source + row * imageRowSize, tileData + row * tileRowBytes, columnSamples, metadata->bitsPerSample);
+			}
+			else
+			{
+				toFileByteOrder(metadata, source + row * imageRowSize, tileData + row * tileRowBytes, columnSamples);
+			}
+		}
+	}
+
+	return AsyncFileIO::write(filePath, blocks);
+}
+
+bool RawDataIO::readFloatTiles(const QString& filePath, const QSharedPointer<Metadata>& metadata, float* imageBuffer, TileRange range, bool streamed)
+{
+	const int samplesPerPixel = metadata->getSamplesPerPixel();
+	const qint64 imageRowSize = static_cast<qint64>(metadata->imageWidth) * samplesPerPixel;
+	const qint64 tileRowBytes = static_cast<qint64>(metadata->tileWidth) * samplesPerPixel * metadata->bitsPerSample / 8;
+
+	QList<AsyncFileIO::Block> blocks;
+	qint64 rangeSize = 0;
+	for (int tile = range.first; tile < range.last; tile++)
+	{
+		const qint64 tileSize = getTileRows(metadata, tile) * tileRowBytes;
+		if (metadata->dataByteCounts[tile] < tileSize)
+		{
+			return false;
+		}
+
+		blocks.append({ metadata->dataOffsets[tile], tileSize, nullptr });
+		rangeSize += tileSize;
+	}
+
+	QByteArray rangeData;
+	rangeData.resize(rangeSize);
+	for (qint64 i = 0, position = 0; i < blocks.size(); position += blocks[i].size, i++)
+	{
+		blocks[i].data = rangeData.data() + position;
+	}
+
+	if (!AsyncFileIO::read(filePath, blocks, streamed))
+	{
+		return false;
+	}
+
+	for (int tile = range.first; tile < range.last; tile++)
+	{
+		const int rows = getTileRows(metadata, tile);
+		const int columnSamples = getTileColumns(metadata, tile) * samplesPerPixel;
+		float* destination = imageBuffer + getTileBufferOffset(metadata, tile);
+		char* tileData = blocks[tile - range.first].data;
+
+		for (int row = 0; row < rows; row++)
+		{
+			decodeFloatSamples(metadata, tileData + row * tileRowBytes, destination + row * imageRowSize, columnSamples);
+		}
+	}
+
+	return true;
+}
+
+bool RawDataIO::writeFloatTiles(const QString& filePath, const QSharedPointer<Metadata>& metadata, const float* imageBuffer, TileRange range)
+{
+	const int samplesPerPixel = metadata->getSamplesPerPixel();
+	const qint64 imageRowSize = static_cast<qint64>(metadata->imageWidth) * samplesPerPixel;
+	const qint64 tileRowBytes = static_cast<qint64>(metadata->tileWidth) * samplesPerPixel * metadata->bitsPerSample / 8;
+
+	qint64 rangeSize = 0;
+	for (int tile = range.first; tile < range.last; tile++)
+	{
+		rangeSize += (metadata->isStripLayout() ? getTileRows(metadata, tile) : metadata->tileHeight) * tileRowBytes;
+	}
+
+	QByteArray rangeData;
+	rangeData.fill(0, rangeSize);
+	QList<AsyncFileIO::Block> blocks;
+	qint64 position = 0;
+	for (int tile = range.first; tile < range.last; tile++)
+	{
+		const int rows = getTileRows(metadata, tile);
+		const int columnSamples = getTileColumns(metadata, tile) * samplesPerPixel;
+		const float* source = imageBuffer + getTileBufferOffset(metadata, tile);
+		const qint64 tileSize = (metadata->isStripLayout() ? rows : metadata->tileHeight) * tileRowBytes;
+		char* tileData = rangeData.data() + position;
+		position += tileSize;
+
+		for (int row = 0; row < rows; row++)
+		{
+			encodeFloatSamples(metadata, source + row * imageRowSize, tileData + row * tileRowBytes, columnSamples);
+		}
+		blocks.append({ metadata->dataOffsets[tile], qMin(tileSize, metadata->dataByteCounts[tile]), tileData });
+	}
+
+	return AsyncFileIO::write(filePath, blocks);
+}
+
+int RawDataIO::getTileRows(const QSharedPointer<Metadata>& metadata, int tile)
+{
+	const int top = tile / metadata->getTilesAcross() * metadata->tileHeight;
+	return qMin(metadata->tileHeight, metadata->imageHeight - top);
+}
+
+int RawDataIO::getTileColumns(const QSharedPointer<Metadata>& metadata, int tile)
+{
+	const int left = tile % metadata->getTilesAcross() * metadata->tileWidth;
+	return qMin(metadata->tileWidth, metadata->imageWidth - left);
+}
+
+qint64 RawDataIO::getTileBufferOffset(const QSharedPointer<Metadata>& metadata, int tile)
+{
+	const qint64 top = tile / metadata->getTilesAcross() * static_cast<qint64>(metadata->tileHeight);
+	const qint64 left = tile % metadata->getTilesAcross() * static_cast<qint64>(metadata->tileWidth);
+	return (top * metadata->imageWidth + left) * metadata->getSamplesPerPixel();
+}
+
+QByteArray RawDataIO::encodeTile(const QSharedPointer<Metadata>& metadata, const uint16_t* imageBuffer, int tile)
+{
+	const int samplesPerPixel = metadata->getSamplesPerPixel();
+	const int tilesAcross = (metadata->imageWidth + compressedTileSize - 1) / compressedTileSize;
+	const int top = tile / tilesAcross * compressedTileSize;
+	const int left = tile % tilesAcross * compressedTileSize;
+	const int rows = qMin(compressedTileSize, metadata->imageHeight - top);
+	const int columnSamples = qMin(compressedTileSize, metadata->imageWidth - left) * samplesPerPixel;
+	const int tileRowSamples = compressedTileSize * samplesPerPixel;
+
+	// Bayer rows are encoded as two interleaved components, so every sample is predicted from the same color.
+	const int componentsCount = metadata->rawType == Metadata::RawTypeEnum::Bayer ? 2 : samplesPerPixel;
+	const int padPeriod = columnSamples >= componentsCount ? componentsCount : samplesPerPixel;
+
+	// Edge tiles are padded by repeating the last pixels, it costs almost nothing to encode.
+	QList<uint16_t> tileBuffer(compressedTileSize * tileRowSamples);
+	for (int row = 0; row < compressedTileSize; row++)
+	{
+		const uint16_t* source = imageBuffer + ((static_cast<qint64>(top) + qMin(row, rows - 1)) * metadata->imageWidth + left) * samplesPerPixel;
+		uint16_t* destination = tileBuffer.data() + row * tileRowSamples;
+		memcpy(destination, source, columnSamples * sizeof(uint16_t));
+		for (int i = columnSamples; i < tileRowSamples; i++)
+		{
+			destination[i] = destination[i - padPeriod];
+		}
+	}
+
+	// Samples are scaled or clipped to the source range, so the source bit depth is kept instead of widening packed sources to 16 bits.
+	return LosslessJpeg::encode(tileBuffer.constData(), tileRowSamples, tileRowSamples / componentsCount, compressedTileSize, componentsCount, metadata->bitsPerSample);
+}
+
+bool RawDataIO::isDataAtFileEnd(const QList<qint64>& dataOffsets, const QList<qint64>& dataByteCounts, qint64 fileSize)
+{
+	qint64 start = dataOffsets[0];
+	qint64 end = 0;
+	qint64 size = 0;
+	for (int i = 0; i < dataOffsets.size(); i++)
+	{
+		start = qMin(start, dataOffsets[i]);
+		end = qMax(end, dataOffsets[i] + dataByteCounts[i]);
+		size += dataByteCounts[i];
+	}
+
+	// Contiguous data allowing word alignment padding after every tile.
+	return end - start <= size + dataOffsets.size() && end >= fileSize - 1;
+}
+
+qint64 RawDataIO::getMappedSize(const QSharedPointer<Metadata>& metadata)
+{
+	const qint64 sampleSize = metadata->isFloatingPoint() ? sizeof(float) : sizeof(uint16_t);
+	return static_cast<qint64>(metadata->imageHeight) * metadata->imageWidth * metadata->getSamplesPerPixel() * sampleSize;
+}
+
+bool RawDataIO::isHostByteOrder(const QSharedPointer<Metadata>& metadata)
+{
+	return metadata->bigEndian == (QSysInfo::ByteOrder == QSysInfo::BigEndian);
+}
+
+void RawDataIO::fromFileByteOrder(const QSharedPointer<Metadata>& metadata, const void* source, uint16_t* destination, qint64 count)
+{
+	// Qt swaps arrays with SIMD when available, and only copies when the order matches the host, in place conversion is allowed.
+	if (metadata->bigEndian)
+	{
+		qFromBigEndian<uint16_t>(source, count, destination);
+	}
+	else
+	{
+		qFromLittleEndian<uint16_t>(source, count, destination);
+	}
+}
+
+void RawDataIO::toFileByteOrder(const QSharedPointer<Metadata>& metadata, const uint16_t* source, void* destination, qint64 count)
+{
+	if (metadata->bigEndian)
+	{
+		qToBigEndian<uint16_t>(source, count, destination);
+	}
+	else
+	{
+		qToLittleEndian<uint16_t>(source, count, destination);
+	}
+}
+
+void RawDataIO::decodeFloatSamples(const QSharedPointer<Metadata>& metadata, char* source, float* destination, qint64 count)
+{
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(source);
+	switch (metadata->bitsPerSample)
+	{
+		case 16:
+			// Half floats are swapped in place to the host order, then widened by Qt, with F16C when available.
+			fromFileByteOrder(metadata, source, reinterpret_cast<uint16_t*>(source), count);
+			qFloatFromFloat16(destination, reinterpret_cast<const qfloat16*>(source), count);
+			break;
+		case 24:
+			for (qint64 i = 0; i < count; i++)
+			{
+				const uint8_t* sample = bytes + i * 3;
+				destination[i] = fromFloat24(metadata->bigEndian ?
+					static_cast<quint32>(sample[0]) << 16 | sample[1] << 8 | sample[2] :
+					static_cast<quint32>(sample[2]) << 16 | sample[1] << 8 | sample[0]);
+			}
+			break;
+		case 32:
+			if (metadata->bigEndian)
+			{
+				qFromBigEndian<quint32>(source, count, destination);
+			}
+			else
+			{
+				qFromLittleEndian<quint32>(source, count, destination);
+			}
+			break;
+	}
+}
+
+void RawDataIO::encodeFloatSamples(const QSharedPointer<Metadata>& metadata, const float* source, char* destination, qint64 count)
+{
+	uint8_t* bytes = reinterpret_cast<uint8_t*>(destination);
+	switch (metadata->bitsPerSample)
+	{
+		case 16:
+			qFloatToFloat16(reinterpret_cast<qfloat16*>(destination), source, count);
+			toFileByteOrder(metadata, reinterpret_cast<const uint16_t*>(destination), destination, count);
+			break;
+		case 24:
+			for (qint64 i = 0; i < count; i++)
+			{
+				const quint32 value = toFloat24(source[i]);
+				uint8_t* sample = bytes + i * 3;
+				sample[metadata->bigEndian ? 0 : 2] = static_cast<uint8_t>(value >> 16);
+				sample[1] = static_cast<uint8_t>(value >> 8);
+				sample[metadata->bigEndian ? 2 : 0] = static_cast<uint8_t>(value);
+			}
+			break;
+		case 32:
+			if (metadata->bigEndian)
+			{
+				qToBigEndian<quint32>(source, count, destination);
+			}
+			else
+			{
+				qToLittleEndian<quint32>(source, count, destination);
+			}
+			break;
+	}
+}
+
+// DNG 24 bit float: 1 sign bit, 7 exponent bits with bias 63, 16 mantissa bits.
+float RawDataIO::fromFloat24(quint32 value)
+{
+	const quint32 sign = (value >> 23) << 31;
+	const int exponent = (value >> 16) & 0x7f;
+	const quint32 mantissa = value & 0xffff;
+
+	quint32 bits;
+	if (exponent == 0x7f)
+	{
+		bits = sign | 0x7f800000 | mantissa << 7;
+	}
+	else if (exponent == 0)
+	{
+		// Denormals of float24 are normal floats.
+		const float magnitude = std::ldexp(static_cast<float>(mantissa), -62 - 16);
+		return sign != 0 ? -magnitude : magnitude;
+	}
+	else
+	{
+		bits = sign | static_cast<quint32>(exponent - 63 + 127) << 23 | mantissa << 7;
+	}
+
+	float result;
+	memcpy(&result, &bits, sizeof(result));
+	return result;
+}
+
+quint32 RawDataIO::toFloat24(float value)
+{
+	quint32 bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	const quint32 sign = (bits >> 31) << 23;
+	const int exponent = static_cast<int>((bits >> 23) & 0xff);
+	const quint32 mantissa = bits & 0x7fffff;
+
+	if (exponent == 0xff)
+	{
+		// NaN must keep a non-zero mantissa after truncation.
+		return sign | 0x7f0000 | (mantissa != 0 ? qMax<quint32>(mantissa >> 7, 1) : 0);
+	}
+
+	const int float24Exponent = exponent - 127 + 63;
+	if (float24Exponent >= 0x7f)
+	{
+		return sign | 0x7f0000;
+	}
+
+	// Rounding carry may overflow the mantissa into the exponent, which is still the correct result.
+	quint32 magnitude;
+	if (float24Exponent > 0)
+	{
+		magnitude = (static_cast<quint32>(float24Exponent) << 16 | mantissa >> 7) + (mantissa >> 6 & 1);
+	}
+	else
+	{
+		const int shift = 8 - float24Exponent;
+		const quint32 fullMantissa = mantissa | 0x800000;
+		magnitude = exponent == 0 || shift > 24 ? 0 : (fullMantissa >> shift) + (fullMantissa >> (shift - 1) & 1);
+	}
+
+	return sign | qMin<quint32>(magnitude, 0x7f0000);
+}
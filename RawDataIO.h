@@ -0,0 +1,70 @@
+#pragma once
+#include <QFile>
+#include <QString>
+#include <QThreadPool>
+
+#include "DataStructs.h"
+#include "TiffFile.h"
+
+class RawDataIO
+{
+	struct TileRange
+	{
+		int first;
+		int last;
+
+		TileRange(int first, int last)
+		{
+			this->first = first;
+			this->last = last;
+		}
+	};
+
+	static constexpr int compressedTileSize = 256;
+	// Offset and byte count tags of data blocks copied when a compressed file is compacted.
+	static constexpr std::pair<uint16_t, uint16_t> compactedDataTags[] =
+	{
+		{ TiffFile::TagEnum::StripOffsets, TiffFile::TagEnum::StripByteCounts },
+		{ TiffFile::TagEnum::TileOffsets, TiffFile::TagEnum::TileByteCounts },
+		{ TiffFile::TagEnum::JPEGInterchangeFormat, TiffFile::TagEnum::JPEGInterchangeFormatLength }
+	};
+
+	static QList<TileRange> splitTiles(const QSharedPointer<Metadata>& metadata);
+	static bool readTiles(const QString& filePath, const QSharedPointer<Metadata>& metadata, uint16_t* imageBuffer, TileRange range, bool streamed);
+	static bool writeTiles(const QString& filePath, const QSharedPointer<Metadata>& metadata, const uint16_t* imageBuffer, TileRange range);
+	static bool readFloatTiles(const QString& filePath, const QSharedPointer<Metadata>& metadata, float* imageBuffer, TileRange range, bool streamed);
+	static bool writeFloatTiles(const QString& filePath, const QSharedPointer<Metadata>& metadata, const float* imageBuffer, TileRange range);
+	static int getTileRows(const QSharedPointer<Metadata>& metadata, int tile);
+	static int getTileColumns(const QSharedPointer<Metadata>& metadata, int tile);
+	static qint64 getTileBufferOffset(const QSharedPointer<Metadata>& metadata, int tile);
+	static QByteArray encodeTile(const QSharedPointer<Metadata>& metadata, const uint16_t* imageBuffer, int tile);
+	static TiffFile::Directory createCompressedDirectory(const TiffFile& tiffFile, const TiffFile::Directory& rawDirectory, const QList<quint64>& tileOffsets, const QList<QByteArray>& encodedTiles);
+	// Data behind every pointer of the file is known, so the file can be rebuilt without the original raw data.
+	static bool isCompactable(const TiffFile& tiffFile);
+	static bool writeCompacted(QFile& file, const TiffFile& tiffFile, const QList<const TiffFile::Directory*>& rawDirectories, const QList<QList<QByteArray>>& encodedFrames);
+	static bool isDataAtFileEnd(const QList<qint64>& dataOffsets, const QList<qint64>& dataByteCounts, qint64 fileSize);
+	static bool isHostByteOrder(const QSharedPointer<Metadata>& metadata);
+	static void fromFileByteOrder(const QSharedPointer<Metadata>& metadata, const void* source, uint16_t* destination, qint64 count);
+	static void toFileByteOrder(const QSharedPointer<Metadata>& metadata, const uint16_t* source, void* destination, qint64 count);
+	static void decodeFloatSamples(const QSharedPointer<Metadata>& metadata, char* source, float* destination, qint64 count);
+	static void encodeFloatSamples(const QSharedPointer<Metadata>& metadata, const float* source, char* destination, qint64 count);
+	static qint64 getMappedSize(const QSharedPointer<Metadata>& metadata);
+	static float fromFloat24(quint32 value);
+	static quint32 toFloat24(float value);
+
+public:
+	// Streamed data is used once in a batch, it follows the page cache policy of AsyncFileIO. Tiles are read in the given pool, or in the
+	// calling thread when it is nullptr.
+	static bool read(const QString& filePath, const QSharedPointer<Metadata>& metadata, QList<uint16_t>& imageBuffer, bool streamed = false, QThreadPool* threadPool = QThreadPool::globalInstance());
+	static bool write(const QString& filePath, const QSharedPointer<Metadata>& metadata, const QList<uint16_t>& imageBuffer);
+	static bool read(const QString& filePath, const QSharedPointer<Metadata>& metadata, QList<float>& imageBuffer, bool streamed = false, QThreadPool* threadPool = QThreadPool::globalInstance());
+	static bool write(const QString& filePath, const QSharedPointer<Metadata>& metadata, const QList<float>& imageBuffer);
+	// Replaces raw data of all frames of the copied source file with lossless JPEG compressed tiles and rewritten raw IFDs. The file is
+	// compacted when its whole structure is known, otherwise raw data is replaced in place or appended.
+	static bool writeCompressed(const QString& filePath, const QSharedPointer<Metadata>& metadata, const QList<QList<uint16_t>>& imageBuffers);
+	// Raw data stored exactly as the image buffer: uncompressed strips one after another, in the host byte order and the buffer sample size.
+	static bool isMappable(const QSharedPointer<Metadata>& metadata);
+	// Maps raw data of the file writable, so it can be used as the image buffer. Returns nullptr if the data is not mappable.
+	static uchar* map(QFile& file, const QSharedPointer<Metadata>& metadata);
+	static bool unmap(QFile& file, uchar* data, const QSharedPointer<Metadata>& metadata, SavingOptions::OutputSyncEnum outputSync);
+};
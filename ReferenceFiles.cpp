@@ -134,6 +134,25 @@ void ReferenceFiles::load(const QString& referenceFilesRoot)
 			metadata->imageWidth = jsonMetadataObject["imageWidth"].toInt();
 			metadata->dataOffset = jsonMetadataObject["dataOffset"].toInt();
 			metadata->dataSize = jsonMetadataObject["dataSize"].toInt();
+			metadata->compression = static_cast<Metadata::CompressionEnum>(jsonMetadataObject["compression"].toInt(Metadata::CompressionEnum::Uncompressed));
+			metadata->tileWidth = jsonMetadataObject["tileWidth"].toInt(metadata->imageWidth);
+			metadata->tileHeight = jsonMetadataObject["tileHeight"].toInt(metadata->imageHeight);
+			// Databases created before the layout was stored have no key, files whose tiles are as wide as the image are taken as stripped.
+			metadata->stripLayout = jsonMetadataObject["stripLayout"].toBool(metadata->tileWidth == metadata->imageWidth);
+			metadata->bitsPerSample = jsonMetadataObject["bitsPerSample"].toInt(16);
+			metadata->bigEndian = jsonMetadataObject["bigEndian"].toBool();
+			metadata->sampleFormat = static_cast<Metadata::SampleFormatEnum>(jsonMetadataObject["sampleFormat"].toInt(Metadata::SampleFormatEnum::UnsignedInteger));
+
+			// Databases created before tiles support have only one contiguous strip.
+			QJsonArray dataOffsets = jsonMetadataObject["dataOffsets"].toArray({ metadata->dataOffset });
+			QJsonArray dataByteCounts = jsonMetadataObject["dataByteCounts"].toArray({ metadata->dataSize });
+			metadata->dataOffsets.resize(dataOffsets.size());
+			metadata->dataByteCounts.resize(dataByteCounts.size());
+			for (int j = 0; j < dataOffsets.size() && j < dataByteCounts.size(); j++)
+			{
+				metadata->dataOffsets[j] = dataOffsets[j].toInteger();
+				metadata->dataByteCounts[j] = dataByteCounts[j].toInteger();
+			}
 
 			QJsonArray activeArea = jsonMetadataObject["activeArea"].toArray();
 			metadata->activeArea.resize(activeArea.size());
@@ -205,6 +224,23 @@ void ReferenceFiles::save(const QString& referenceFilesRoot) const
 		jsonObjectMetadata["imageWidth"] = fileInfo->metadata->imageWidth;
 		jsonObjectMetadata["dataOffset"] = fileInfo->metadata->dataOffset;
 		jsonObjectMetadata["dataSize"] = fileInfo->metadata->dataSize;
+		jsonObjectMetadata["compression"] = fileInfo->metadata->compression;
+		jsonObjectMetadata["tileWidth"] = fileInfo->metadata->tileWidth;
+		jsonObjectMetadata["tileHeight"] = fileInfo->metadata->tileHeight;
+		jsonObjectMetadata["stripLayout"] = fileInfo->metadata->stripLayout;
+		jsonObjectMetadata["bitsPerSample"] = fileInfo->metadata->bitsPerSample;
+		jsonObjectMetadata["bigEndian"] = fileInfo->metadata->bigEndian;
+		jsonObjectMetadata["sampleFormat"] = fileInfo->metadata->sampleFormat;
+
+		QJsonArray dataOffsets;
+		QJsonArray dataByteCounts;
+		for (int j = 0; j < fileInfo->metadata->dataOffsets.length(); j++)
+		{
+			dataOffsets.append(fileInfo->metadata->dataOffsets[j]);
+			dataByteCounts.append(fileInfo->metadata->dataByteCounts[j]);
+		}
+		jsonObjectMetadata["dataOffsets"] = dataOffsets;
+		jsonObjectMetadata["dataByteCounts"] = dataByteCounts;
 
 		QJsonArray activeArea;
 		for (int j = 0; j < fileInfo->metadata->activeArea.length(); j++)
@@ -322,3 +358,8 @@ QSharedPointer<FileInfo> ReferenceFiles::getFileMetadata(const QString& filePath
 {
 	return db[filePath];
 }
+
+int ReferenceFiles::getCount() const
+{
+	return db.size();
+}
@@ -30,4 +30,5 @@ public:
 	QList<QSharedPointer<FileInfo>> findMatchingReferenceFiles(const QSharedPointer<Metadata>& sourceMetadata, const ReferenceMatcherOptions& options) const;
 	static QList<QSharedPointer<FileInfo>> getCommonReferenceFiles(const QList<QSharedPointer<SourceFileInfo>>& sourceFiles, const ReferenceMatcherOptions& options);
 	QSharedPointer<FileInfo> getFileMetadata(const QString& filePath) const;
+	int getCount() const;
 };
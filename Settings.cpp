@@ -31,62 +31,80 @@ bool Settings::isGaussianBlurSigmaValid(const float sigma)
 
 Settings::Settings()
 {
-	if (!QFile::exists(fileName))
+	QJsonObject jsonObject;
+	if (QFile::exists(fileName))
 	{
-        referenceMatcherOptions.allowedFocalLengthDifferencePercents = defaultFocalLengthDifferencePercent;
-        referenceMatcherOptions.allowedFNumberDifferenceStops = defaultFNumberDifferenceStops;
-        defaultFileProcessingOptions.luminanceCorrectionIntensity = defaultCorrectionIntensity;
-        defaultFileProcessingOptions.colorCorrectionIntensity = defaultCorrectionIntensity;
-        defaultFileProcessingOptions.gaussianBlurSigma = defaultGaussianBlurRadius;
-
-        return;
+		try
+		{
+			QFile settingsFile(fileName);
+			settingsFile.open(QIODevice::ReadOnly);
+
+			jsonObject = QJsonDocument::fromJson(settingsFile.readAll()).object();
+
+			settingsFile.close();
+		}
+		catch (...)
+		{
+		}
 	}
 
-	try
-	{
-		QFile settingsFile(fileName);
-		settingsFile.open(QIODevice::ReadOnly);
-
-		const QJsonDocument jsonDocument = QJsonDocument::fromJson(settingsFile.readAll());
+	load(jsonObject);
+}
 
-		settingsFile.close();
+Settings::Settings(const QJsonObject& jsonObject) : fileName("")
+{
+	load(jsonObject);
+}
 
-		referenceMatcherOptions.referenceFilesRoot = jsonDocument["referenceFilesRoot"].toString();
-		referenceMatcherOptions.allowedFocalLengthDifferencePercents = getDefaultIfNotInRange(jsonDocument["referenceFileMatcherMaxAllowedFocalLengthDifferencePercents"].toDouble(), 0, maxFocalLengthDifferencePercent, defaultFocalLengthDifferencePercent);
-		referenceMatcherOptions.allowedFNumberDifferenceStops = getDefaultIfNotInRange(jsonDocument["referenceFileMatcherMaxAllowedFNumberDifferenceStops"].toDouble(), 0, maxFNumberDifferenceStops, defaultFNumberDifferenceStops);
-		referenceMatcherOptions.ignoreFocalLength = jsonDocument["referenceFileMatcherIgnoreFocalLength"].toBool();
-		referenceMatcherOptions.ignoreFNumber = jsonDocument["referenceFileMatcherIgnoreFNumber"].toBool();
-		referenceMatcherOptions.ignoreLensTag = jsonDocument["referenceFileMatcherIgnoreLensTag"].toBool();
-
-		sourceFilesRoot = jsonDocument["sourceFilesRoot"].toString();
-		sourceFilesRecurseSubfolders = jsonDocument["sourceFilesRecurseSubfolders"].toBool();
-
-		defaultFileProcessingOptions.luminanceCorrectionIntensity = getDefaultIfNotInRange(jsonDocument["processingDefaultLuminanceCorrectionIntensity"].toDouble(), 0, maxCorrectionIntensity, defaultCorrectionIntensity);
-		defaultFileProcessingOptions.colorCorrectionIntensity = getDefaultIfNotInRange(jsonDocument["processingDefaultColorCorrectionIntensity"].toDouble(), 0, maxCorrectionIntensity, defaultCorrectionIntensity);
-		defaultFileProcessingOptions.gaussianBlurSigma = getDefaultIfNotInRange(jsonDocument["processingDefaultGaussianBlurSigma"].toDouble(), 0, maxGaussianBlurRadius, defaultGaussianBlurRadius);
-
-		globalProcessingOptions.limitToWhiteLevel = jsonDocument["processingLimitToWhiteLevel"].toBool();
-		globalProcessingOptions.scaleChannelsToAvoidClipping = jsonDocument["processingScaleChannelsToAvoidClipping"].toBool();
-		globalProcessingOptions.calculateCommonScaleForBatch = jsonDocument["processingCalculateCommonScaleForBatch"].toBool();
-
-		savingOptions.saveTo = (SavingOptions::SaveToEnum)jsonDocument["saveTo"].toInt();
-		savingOptions.saveToFolderPath = jsonDocument["saveProcessedFilesToFolderPath"].toString();
-		savingOptions.saveToSubfolderFolderName = jsonDocument["saveProcessedFilesToSubfolderFolderName"].toString();
-		lastUsedFolderForOneReferenceFileMode = jsonDocument["lastUsedFolderForOneReferenceFileMode"].toString();
-
-		windowIsMaximized = jsonDocument["windowIsMaximized"].toBool();
-		windowHeight = jsonDocument["windowHeight"].toInt();
-		windowWidth = jsonDocument["windowWidth"].toInt();
-		windowPositionX = jsonDocument["windowPositionX"].toInt();
-		windowPositionY = jsonDocument["windowPositionY"].toInt();
-	}
-	catch (...)
-	{
-	}
+void Settings::load(const QJsonObject& jsonObject)
+{
+	// Missing values get defaults, so partial objects like job files can be loaded too.
+	referenceMatcherOptions.referenceFilesRoot = jsonObject["referenceFilesRoot"].toString();
+	referenceMatcherOptions.allowedFocalLengthDifferencePercents = getDefaultIfNotInRange(jsonObject["referenceFileMatcherMaxAllowedFocalLengthDifferencePercents"].toDouble(defaultFocalLengthDifferencePercent), 0, maxFocalLengthDifferencePercent, defaultFocalLengthDifferencePercent);
+	referenceMatcherOptions.allowedFNumberDifferenceStops = getDefaultIfNotInRange(jsonObject["referenceFileMatcherMaxAllowedFNumberDifferenceStops"].toDouble(defaultFNumberDifferenceStops), 0, maxFNumberDifferenceStops, defaultFNumberDifferenceStops);
+	referenceMatcherOptions.ignoreFocalLength = jsonObject["referenceFileMatcherIgnoreFocalLength"].toBool();
+	referenceMatcherOptions.ignoreFNumber = jsonObject["referenceFileMatcherIgnoreFNumber"].toBool();
+	referenceMatcherOptions.ignoreLensTag = jsonObject["referenceFileMatcherIgnoreLensTag"].toBool();
+
+	sourceFilesRoot = jsonObject["sourceFilesRoot"].toString();
+	sourceFilesRecurseSubfolders = jsonObject["sourceFilesRecurseSubfolders"].toBool(sourceFilesRecurseSubfolders);
+
+	defaultFileProcessingOptions.luminanceCorrectionIntensity = getDefaultIfNotInRange(jsonObject["processingDefaultLuminanceCorrectionIntensity"].toDouble(defaultCorrectionIntensity), 0, maxCorrectionIntensity, defaultCorrectionIntensity);
+	defaultFileProcessingOptions.colorCorrectionIntensity = getDefaultIfNotInRange(jsonObject["processingDefaultColorCorrectionIntensity"].toDouble(defaultCorrectionIntensity), 0, maxCorrectionIntensity, defaultCorrectionIntensity);
+	defaultFileProcessingOptions.gaussianBlurSigma = getDefaultIfNotInRange(jsonObject["processingDefaultGaussianBlurSigma"].toDouble(defaultGaussianBlurRadius), 0, maxGaussianBlurRadius, defaultGaussianBlurRadius);
+
+	globalProcessingOptions.limitToWhiteLevel = jsonObject["processingLimitToWhiteLevel"].toBool();
+	globalProcessingOptions.scaleChannelsToAvoidClipping = jsonObject["processingScaleChannelsToAvoidClipping"].toBool();
+	globalProcessingOptions.calculateCommonScaleForBatch = jsonObject["processingCalculateCommonScaleForBatch"].toBool();
+
+	savingOptions.saveTo = (SavingOptions::SaveToEnum)qBound(0, jsonObject["saveTo"].toInt(savingOptions.saveTo), static_cast<int>(SavingOptions::SaveToEnum::Subfolder));
+	savingOptions.saveToFolderPath = jsonObject["saveProcessedFilesToFolderPath"].toString();
+	savingOptions.saveToSubfolderFolderName = jsonObject["saveProcessedFilesToSubfolderFolderName"].toString(savingOptions.saveToSubfolderFolderName);
+	savingOptions.outputFormat = (SavingOptions::OutputFormatEnum)qBound(0, jsonObject["saveOutputFormat"].toInt(), static_cast<int>(SavingOptions::OutputFormatEnum::GainMap));
+	savingOptions.mapOutputFile = jsonObject["saveMapOutputFile"].toBool();
+	savingOptions.outputSync = (SavingOptions::OutputSyncEnum)qBound(0, jsonObject["saveOutputSync"].toInt(), static_cast<int>(SavingOptions::OutputSyncEnum::FullSync));
+	savingOptions.skipUpToDate = jsonObject["saveSkipUpToDate"].toBool(savingOptions.skipUpToDate);
+	lastUsedFolderForOneReferenceFileMode = jsonObject["lastUsedFolderForOneReferenceFileMode"].toString();
+	ioQueueDepth = qBound(1, jsonObject["ioQueueDepth"].toInt(AsyncFileIO::defaultQueueDepth), AsyncFileIO::maxQueueDepth);
+	ioCachePolicy = (AsyncFileIO::CachePolicyEnum)qBound(0, jsonObject["ioCachePolicy"].toInt(), static_cast<int>(AsyncFileIO::CachePolicyEnum::Direct));
+	prefetchItems = qMax(0, jsonObject["prefetchItems"].toInt(Prefetcher::defaultLookahead));
+	prefetchMemoryLimit = qMax(0, jsonObject["prefetchMemoryLimit"].toInt(Prefetcher::defaultMemoryLimit));
+
+	windowIsMaximized = jsonObject["windowIsMaximized"].toBool();
+	windowHeight = jsonObject["windowHeight"].toInt(windowHeight);
+	windowWidth = jsonObject["windowWidth"].toInt(windowWidth);
+	windowPositionX = jsonObject["windowPositionX"].toInt(windowPositionX);
+	windowPositionY = jsonObject["windowPositionY"].toInt(windowPositionY);
 }
 
 Settings::~Settings()
 {
+	// Settings loaded from a job are not written back.
+	if (fileName.isEmpty())
+	{
+		return;
+	}
+
 	QJsonObject jsonObject;
 	jsonObject.insert("referenceFilesRoot", "1");
 	jsonObject["referenceFilesRoot"] = "2";
@@ -111,7 +129,15 @@ Settings::~Settings()
 	jsonObject["saveTo"] = static_cast<int>(savingOptions.saveTo);
 	jsonObject["saveProcessedFilesToFolderPath"] = savingOptions.saveToFolderPath;
 	jsonObject["saveProcessedFilesToSubfolderFolderName"] = savingOptions.saveToSubfolderFolderName;
+	jsonObject["saveOutputFormat"] = static_cast<int>(savingOptions.outputFormat);
+	jsonObject["saveMapOutputFile"] = savingOptions.mapOutputFile;
+	jsonObject["saveOutputSync"] = static_cast<int>(savingOptions.outputSync);
+	jsonObject["saveSkipUpToDate"] = savingOptions.skipUpToDate;
 	jsonObject["lastUsedFolderForOneReferenceFileMode"] = lastUsedFolderForOneReferenceFileMode;
+	jsonObject["ioQueueDepth"] = ioQueueDepth;
+	jsonObject["ioCachePolicy"] = static_cast<int>(ioCachePolicy);
+	jsonObject["prefetchItems"] = prefetchItems;
+	jsonObject["prefetchMemoryLimit"] = prefetchMemoryLimit;
 
 	jsonObject["windowIsMaximized"] = windowIsMaximized;
 	jsonObject["windowHeight"] = windowHeight;
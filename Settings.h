@@ -1,7 +1,10 @@
 #pragma once
+#include <QJsonObject>
 #include <QObject>
 
 #include "DataStructs.h"
+#include "AsyncFileIO.h"
+#include "Prefetcher.h"
 
 
 class Settings : public QObject
@@ -16,6 +19,7 @@ class Settings : public QObject
 	QString fileName = "settings.json";
 
 	static float getDefaultIfNotInRange(float value, float minValue, float maxValue, float defaultValue);
+	void load(const QJsonObject& jsonObject);
 
 public:
 	QString sourceFilesRoot;
@@ -32,6 +36,11 @@ public:
 	SavingOptions savingOptions;
 
 	bool sourceFilesRecurseSubfolders = true;
+	// I/O tuning is not shown in the UI, only set in the settings file.
+	int ioQueueDepth = AsyncFileIO::defaultQueueDepth;
+	AsyncFileIO::CachePolicyEnum ioCachePolicy = AsyncFileIO::CachePolicyEnum::Buffered;
+	int prefetchItems = Prefetcher::defaultLookahead;
+	int prefetchMemoryLimit = Prefetcher::defaultMemoryLimit;
 	QString lastUsedFolderForOneReferenceFileMode = "";
 
 	bool windowIsMaximized = false;
@@ -41,6 +50,8 @@ public:
 	int windowWidth = minWindowWidth;
 
 	Settings();
+	// Settings of a headless job, keys are the same as in the settings file. They are not saved on destruction.
+	explicit Settings(const QJsonObject& jsonObject);
 	~Settings() override;
 
 	static bool isReferenceFileMatcherMaxAllowedFocalLengthDifferencePercentsValid(float difference);
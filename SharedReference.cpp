@@ -0,0 +1,70 @@
+#include <cstring>
+#include <QCryptographicHash>
+#include "SharedReference.h"
+#include "Processor.h"
+
+SharedReference::SharedReference(const QString& key)
+{
+	sharedMemory.setKey(key);
+}
+
+QString SharedReference::getKey(const QString& prefix, const ProcessingItem& item)
+{
+	// Native keys are limited in length, so the description of the reference is hashed.
+	return prefix + QCryptographicHash::hash(Processor::getReferenceKey(item).toUtf8(), QCryptographicHash::Md5).toHex();
+}
+
+bool SharedReference::publish(const QList<QList<float>>& referenceChannels)
+{
+	Header header;
+	header.channelsCount = referenceChannels.size();
+	header.channelSize = referenceChannels.isEmpty() ? 0 : referenceChannels[0].size();
+
+	const qint64 channelBytes = header.channelSize * static_cast<qint64>(sizeof(float));
+	if (!sharedMemory.create(sizeof(Header) + header.channelsCount * channelBytes))
+	{
+		return false;
+	}
+
+	char* data = static_cast<char*>(sharedMemory.data());
+	std::memcpy(data, &header, sizeof(Header));
+	for (int channel = 0; channel < referenceChannels.size(); channel++)
+	{
+		std::memcpy(data + sizeof(Header) + channel * channelBytes, referenceChannels[channel].constData(), channelBytes);
+	}
+
+	return true;
+}
+
+bool SharedReference::attach()
+{
+	return sharedMemory.isAttached() || sharedMemory.attach(QSharedMemory::ReadOnly);
+}
+
+bool SharedReference::read(QList<const float*>& referenceChannels, qint64 channelSize)
+{
+	if (!attach() || sharedMemory.size() < static_cast<qsizetype>(sizeof(Header)))
+	{
+		return false;
+	}
+
+	const char* data = static_cast<const char*>(sharedMemory.constData());
+	Header header;
+	std::memcpy(&header, data, sizeof(Header));
+
+	// Segments are rounded up to pages, so the size is only checked to be large enough.
+	const qint64 channelBytes = header.channelSize * static_cast<qint64>(sizeof(float));
+	if (header.channelsCount <= 0 || header.channelSize != channelSize || sharedMemory.size() < static_cast<qsizetype>(sizeof(Header) + header.channelsCount * channelBytes))
+	{
+		return false;
+	}
+
+	// Header is followed by the channels, so channels are aligned as well as the header size.
+	referenceChannels.resize(header.channelsCount);
+	for (int channel = 0; channel < referenceChannels.size(); channel++)
+	{
+		referenceChannels[channel] = reinterpret_cast<const float*>(data + sizeof(Header) + channel * channelBytes);
+	}
+
+	return true;
+}
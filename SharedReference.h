@@ -0,0 +1,30 @@
+#pragma once
+#include <QList>
+#include <QSharedMemory>
+#include <QString>
+
+#include "DataStructs.h"
+
+// Prepared reference in shared memory. The worker which prepares a reference publishes it, other workers read it straight from the segment
+// instead of reading and blurring the reference again. The segment is never changed after it is published.
+class SharedReference
+{
+	struct Header
+	{
+		qint64 channelsCount;
+		qint64 channelSize;
+	};
+
+	QSharedMemory sharedMemory;
+
+public:
+	explicit SharedReference(const QString& key);
+
+	// Key of the prepared reference of the item, prefix keeps segments of different pools apart.
+	static QString getKey(const QString& prefix, const ProcessingItem& item);
+	bool publish(const QList<QList<float>>& referenceChannels);
+	// Attaches without reading, so the segment stays alive after the worker which published it exits.
+	bool attach();
+	// Channels point into the attached segment, so they are valid as long as this object is. Fails if channels don't have the given size.
+	bool read(QList<const float*>& referenceChannels, qint64 channelSize);
+};
@@ -0,0 +1,483 @@
+#include <algorithm>
+#include <cstring>
+#include <QHash>
+#include "TiffFile.h"
+
+const TiffFile::Entry* TiffFile::Directory::findEntry(uint16_t tag) const
+{
+	for (int i = 0; i < entries.size(); i++)
+	{
+		if (entries[i].tag == tag)
+		{
+			return &entries[i];
+		}
+	}
+	return nullptr;
+}
+
+void TiffFile::Directory::setEntry(const Entry& entry)
+{
+	removeEntry(entry.tag);
+	entries.append(entry);
+}
+
+void TiffFile::Directory::removeEntry(uint16_t tag)
+{
+	for (int i = entries.size() - 1; i >= 0; i--)
+	{
+		if (entries[i].tag == tag)
+		{
+			entries.removeAt(i);
+		}
+	}
+}
+
+TiffFile::TiffFile(QIODevice* device)
+{
+	this->device = device;
+}
+
+void TiffFile::setLoadedTags(const QList<uint16_t>& tags)
+{
+	loadedTags = tags;
+}
+
+bool TiffFile::read()
+{
+	directories.clear();
+
+	char header[8];
+	if (!device->seek(0) || device->read(header, 8) != 8)
+	{
+		return false;
+	}
+
+	if (header[0] == 'I' && header[1] == 'I')
+	{
+		bigEndian = false;
+	}
+	else if (header[0] == 'M' && header[1] == 'M')
+	{
+		bigEndian = true;
+	}
+	else
+	{
+		return false;
+	}
+
+	if (readUint16(header + 2) != 42)
+	{
+		return false;
+	}
+
+	qint64 pointerPosition = 4;
+	quint32 offset = readUint32(header + 4);
+	while (offset != 0 && !isDirectoryRead(offset))
+	{
+		if (!readDirectory(offset, pointerPosition, 0))
+		{
+			return false;
+		}
+
+		const Directory& directory = *std::find_if(directories.begin(), directories.end(), [offset](const Directory& item) { return item.offset == offset; });
+		pointerPosition = offset + 2 + directory.entriesCount * 12;
+		offset = directory.nextOffset;
+	}
+
+	return !directories.isEmpty();
+}
+
+bool TiffFile::readDirectory(qint64 offset, qint64 pointerPosition, int depth)
+{
+	char countData[2];
+	if (!device->seek(offset) || device->read(countData, 2) != 2)
+	{
+		return false;
+	}
+
+	const int entriesCount = readUint16(countData);
+	QByteArray entriesData = device->read(entriesCount * 12 + 4);
+	if (entriesData.size() != entriesCount * 12 + 4)
+	{
+		return false;
+	}
+
+	Directory directory;
+	directory.offset = offset;
+	directory.pointerPosition = pointerPosition;
+	directory.entriesCount = entriesCount;
+	directory.nextOffset = readUint32(entriesData.constData() + entriesCount * 12);
+	qint64 subIFDsValuePosition = 0;
+	QHash<uint16_t, qint64> pointerValuePositions;
+
+	for (int i = 0; i < entriesCount; i++)
+	{
+		const char* entryData = entriesData.constData() + i * 12;
+		Entry entry;
+		entry.tag = readUint16(entryData);
+		entry.type = readUint16(entryData + 2);
+		entry.count = readUint32(entryData + 4);
+
+		// Single offset is stored in the entry itself, otherwise the entry points to the array of offsets.
+		if (entry.tag == TagEnum::SubIFDs)
+		{
+			subIFDsValuePosition = entry.count == 1 ? offset + 2 + i * 12 + 8 : readUint32(entryData + 8);
+		}
+		else if (isDirectoryPointer(entry.tag))
+		{
+			pointerValuePositions.insert(entry.tag, offset + 2 + i * 12 + 8);
+		}
+		else if (!loadedTags.isEmpty() && !loadedTags.contains(entry.tag))
+		{
+			continue;
+		}
+
+		const qint64 size = static_cast<qint64>(getTypeSize(entry.type)) * entry.count;
+		if (getTypeSize(entry.type) == 0)
+		{
+			// Size of unknown types is not known, the value or offset field is copied as it is, the data it points to stays in the file.
+			entry.data = QByteArray(entryData + 8, 4);
+		}
+		else if (size <= 4)
+		{
+			entry.data = QByteArray(entryData + 8, size);
+		}
+		else
+		{
+			if (!device->seek(readUint32(entryData + 8)))
+			{
+				return false;
+			}
+
+			entry.data = device->read(size);
+			if (entry.data.size() != size)
+			{
+				return false;
+			}
+		}
+
+		directory.entries.append(entry);
+	}
+
+	directories.append(directory);
+
+	// Raw images are stored either in the IFD0 chain, or in SubIFDs.
+	const Entry* subIFDs = directory.findEntry(TagEnum::SubIFDs);
+	if (subIFDs != nullptr && depth < maxSubIFDsDepth && getTypeSize(subIFDs->type) == 4)
+	{
+		for (quint32 i = 0; i < subIFDs->count; i++)
+		{
+			const quint32 subIFDOffset = static_cast<quint32>(getValue(*subIFDs, i));
+			if (subIFDOffset == 0 || isDirectoryRead(subIFDOffset))
+			{
+				continue;
+			}
+
+			if (!readDirectory(subIFDOffset, subIFDsValuePosition + i * 4, depth + 1))
+			{
+				return false;
+			}
+		}
+	}
+
+	// Exif IFD holds lens and exposure tags, GPS and interoperability IFDs are read so the whole file can be rewritten.
+	for (const uint16_t tag : { TagEnum::ExifIFD, TagEnum::GPSIFD, TagEnum::InteropIFD })
+	{
+		const Entry* pointer = directory.findEntry(tag);
+		if (pointer == nullptr || depth >= maxSubIFDsDepth || pointer->count != 1 || getTypeSize(pointer->type) != 4)
+		{
+			continue;
+		}
+
+		const quint32 pointerOffset = static_cast<quint32>(getValue(*pointer, 0));
+		if (pointerOffset != 0 && !isDirectoryRead(pointerOffset) && !readDirectory(pointerOffset, pointerValuePositions.value(tag), depth + 1))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool TiffFile::isDirectoryRead(qint64 offset) const
+{
+	for (int i = 0; i < directories.size(); i++)
+	{
+		if (directories[i].offset == offset)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool TiffFile::isBigEndian() const
+{
+	return bigEndian;
+}
+
+const QList<TiffFile::Directory>& TiffFile::getDirectories() const
+{
+	return directories;
+}
+
+const TiffFile::Directory* TiffFile::findDirectoryByDataOffset(qint64 dataOffset) const
+{
+	for (int i = 0; i < directories.size(); i++)
+	{
+		const Entry* offsets = directories[i].findEntry(TagEnum::TileOffsets);
+		if (offsets == nullptr)
+		{
+			offsets = directories[i].findEntry(TagEnum::StripOffsets);
+		}
+
+		if (offsets != nullptr && offsets->count > 0 && static_cast<qint64>(getValue(*offsets, 0)) == dataOffset)
+		{
+			return &directories[i];
+		}
+	}
+	return nullptr;
+}
+
+quint64 TiffFile::getValue(const Entry& entry, int index) const
+{
+	const int typeSize = getTypeSize(entry.type);
+	if (index < 0 || static_cast<quint32>(index) >= entry.count || (index + 1) * typeSize > entry.data.size())
+	{
+		return 0;
+	}
+
+	const char* data = entry.data.constData() + index * typeSize;
+	switch (typeSize)
+	{
+		case 1:
+			return static_cast<uint8_t>(data[0]);
+		case 2:
+			return readUint16(data);
+		default:
+			return readUint32(data);
+	}
+}
+
+double TiffFile::getRealValue(const Entry& entry, int index) const
+{
+	const int typeSize = getTypeSize(entry.type);
+	if (index < 0 || static_cast<quint32>(index) >= entry.count || (index + 1) * typeSize > entry.data.size())
+	{
+		return 0;
+	}
+
+	const char* data = entry.data.constData() + index * typeSize;
+	switch (entry.type)
+	{
+		case TypeEnum::Rational:
+		{
+			const quint32 denominator = readUint32(data + 4);
+			return denominator == 0 ? 0 : static_cast<double>(readUint32(data)) / denominator;
+		}
+		case TypeEnum::SRational:
+		{
+			const qint32 denominator = static_cast<qint32>(readUint32(data + 4));
+			return denominator == 0 ? 0 : static_cast<double>(static_cast<qint32>(readUint32(data))) / denominator;
+		}
+		case TypeEnum::Float:
+		{
+			const quint32 bits = readUint32(data);
+			float value;
+			memcpy(&value, &bits, sizeof(value));
+			return value;
+		}
+		case TypeEnum::Double:
+		{
+			const quint64 bits = static_cast<quint64>(readUint32(data + (bigEndian ? 0 : 4))) << 32 | readUint32(data + (bigEndian ? 4 : 0));
+			double value;
+			memcpy(&value, &bits, sizeof(value));
+			return value;
+		}
+		case TypeEnum::SByte:
+			return static_cast<int8_t>(data[0]);
+		case TypeEnum::SShort:
+			return static_cast<int16_t>(readUint16(data));
+		case TypeEnum::SLong:
+			return static_cast<qint32>(readUint32(data));
+		default:
+			return static_cast<double>(getValue(entry, index));
+	}
+}
+
+QString TiffFile::getString(const Entry& entry) const
+{
+	// ASCII values end with the first zero, the same way Exiv2 reads them, so strings can be compared with ones read by it.
+	const qsizetype length = entry.data.indexOf('\0');
+	return QString::fromUtf8(entry.data.left(length < 0 ? entry.data.size() : length));
+}
+
+TiffFile::Entry TiffFile::createEntry(uint16_t tag, TypeEnum type, const QList<quint64>& values) const
+{
+	Entry entry;
+	entry.tag = tag;
+	entry.type = type;
+	entry.count = values.size();
+
+	const int typeSize = getTypeSize(type);
+	entry.data = QByteArray(values.size() * typeSize, 0);
+	for (int i = 0; i < values.size(); i++)
+	{
+		char* data = entry.data.data() + i * typeSize;
+		switch (typeSize)
+		{
+			case 1:
+				data[0] = static_cast<char>(values[i]);
+				break;
+			case 2:
+				writeUint16(static_cast<uint16_t>(values[i]), data);
+				break;
+			default:
+				writeUint32(static_cast<quint32>(values[i]), data);
+		}
+	}
+	return entry;
+}
+
+int TiffFile::getTypeSize(uint16_t type)
+{
+	switch (type)
+	{
+		case TypeEnum::Byte:
+		case TypeEnum::Ascii:
+		case TypeEnum::SByte:
+		case TypeEnum::Undefined:
+			return 1;
+		case TypeEnum::Short:
+		case TypeEnum::SShort:
+			return 2;
+		case TypeEnum::Long:
+		case TypeEnum::SLong:
+		case TypeEnum::Float:
+		case TypeEnum::Ifd:
+			return 4;
+		case TypeEnum::Rational:
+		case TypeEnum::SRational:
+		case TypeEnum::Double:
+			return 8;
+		default:
+			return 0;
+	}
+}
+
+bool TiffFile::isDirectoryPointer(uint16_t tag)
+{
+	return tag == TagEnum::ExifIFD || tag == TagEnum::GPSIFD || tag == TagEnum::InteropIFD;
+}
+
+qint64 TiffFile::getDirectorySize(const Directory& directory)
+{
+	qint64 size = 2 + directory.entries.size() * 12 + 4;
+	for (const Entry& entry : directory.entries)
+	{
+		if (entry.data.size() > 4)
+		{
+			size += entry.data.size() + entry.data.size() % 2;
+		}
+	}
+	return size;
+}
+
+QByteArray TiffFile::getHeader(quint32 firstDirectoryOffset) const
+{
+	QByteArray header(8, 0);
+	header[0] = bigEndian ? 'M' : 'I';
+	header[1] = header[0];
+	writeUint16(42, header.data() + 2);
+	writeUint32(firstDirectoryOffset, header.data() + 4);
+	return header;
+}
+
+QByteArray TiffFile::getDirectoryData(qint64 position, const Directory& directory) const
+{
+	QList<Entry> entries = directory.entries;
+	std::sort(entries.begin(), entries.end(), [](const Entry& first, const Entry& second) { return first.tag < second.tag; });
+
+	const qint64 directorySize = 2 + entries.size() * 12 + 4;
+	QByteArray directoryData(directorySize, 0);
+	QByteArray valuesData;
+
+	writeUint16(static_cast<uint16_t>(entries.size()), directoryData.data());
+	for (int i = 0; i < entries.size(); i++)
+	{
+		char* entryData = directoryData.data() + 2 + i * 12;
+		writeUint16(entries[i].tag, entryData);
+		writeUint16(entries[i].type, entryData + 2);
+		writeUint32(entries[i].count, entryData + 4);
+
+		if (entries[i].data.size() <= 4)
+		{
+			memcpy(entryData + 8, entries[i].data.constData(), entries[i].data.size());
+		}
+		else
+		{
+			const qint64 valueOffset = position + directorySize + valuesData.size();
+			if (valueOffset + entries[i].data.size() > 0xffffffffLL)
+			{
+				return QByteArray();
+			}
+
+			writeUint32(static_cast<quint32>(valueOffset), entryData + 8);
+			valuesData.append(entries[i].data);
+			if (valuesData.size() % 2 != 0)
+			{
+				valuesData.append('\0');
+			}
+		}
+	}
+	writeUint32(directory.nextOffset, directoryData.data() + 2 + entries.size() * 12);
+
+	directoryData.append(valuesData);
+	return directoryData;
+}
+
+qint64 TiffFile::writeDirectory(qint64 position, const Directory& directory) const
+{
+	const QByteArray directoryData = getDirectoryData(position, directory);
+	if (directoryData.isEmpty() || !device->seek(position) || device->write(directoryData) != directoryData.size())
+	{
+		return -1;
+	}
+
+	return position + directoryData.size();
+}
+
+bool TiffFile::writePointer(qint64 pointerPosition, quint32 offset) const
+{
+	char data[4];
+	writeUint32(offset, data);
+	return device->seek(pointerPosition) && device->write(data, 4) == 4;
+}
+
+quint32 TiffFile::readUint32(const char* data) const
+{
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+	return bigEndian ?
+		static_cast<quint32>(bytes[0]) << 24 | bytes[1] << 16 | bytes[2] << 8 | bytes[3] :
+		static_cast<quint32>(bytes[3]) << 24 | bytes[2] << 16 | bytes[1] << 8 | bytes[0];
+}
+
+uint16_t TiffFile::readUint16(const char* data) const
+{
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+	return static_cast<uint16_t>(bigEndian ? bytes[0] << 8 | bytes[1] : bytes[1] << 8 | bytes[0]);
+}
+
+void TiffFile::writeUint32(quint32 value, char* data) const
+{
+	for (int i = 0; i < 4; i++)
+	{
+		data[bigEndian ? 3 - i : i] = static_cast<char>(value >> (i * 8));
+	}
+}
+
+void TiffFile::writeUint16(uint16_t value, char* data) const
+{
+	data[bigEndian ? 1 : 0] = static_cast<char>(value);
+	data[bigEndian ? 0 : 1] = static_cast<char>(value >> 8);
+}
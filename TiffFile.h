@@ -0,0 +1,114 @@
+#pragma once
+#include <QIODevice>
+#include <QList>
+#include <QString>
+
+// Minimal TIFF structure access: IFD0 chain with SubIFDs, Exif, GPS and interoperability IFDs, entries are kept with their values in
+// file byte order.
+class TiffFile
+{
+public:
+	enum TypeEnum
+	{
+		Byte = 1,
+		Ascii = 2,
+		Short = 3,
+		Long = 4,
+		Rational = 5,
+		SByte = 6,
+		Undefined = 7,
+		SShort = 8,
+		SLong = 9,
+		SRational = 10,
+		Float = 11,
+		Double = 12,
+		Ifd = 13
+	};
+
+	enum TagEnum
+	{
+		BitsPerSample = 0x0102,
+		Compression = 0x0103,
+		StripOffsets = 0x0111,
+		RowsPerStrip = 0x0116,
+		StripByteCounts = 0x0117,
+		TileWidth = 0x0142,
+		TileLength = 0x0143,
+		TileOffsets = 0x0144,
+		TileByteCounts = 0x0145,
+		SubIFDs = 0x014a,
+		JPEGInterchangeFormat = 0x0201,
+		JPEGInterchangeFormatLength = 0x0202,
+		ExifIFD = 0x8769,
+		GPSIFD = 0x8825,
+		MakerNote = 0x927c,
+		InteropIFD = 0xa005,
+		OpcodeList2 = 0xc741
+	};
+
+	// Values of unknown types are kept as the raw 4 bytes of the entry, so they are written back unchanged.
+	struct Entry
+	{
+		uint16_t tag = 0;
+		uint16_t type = 0;
+		quint32 count = 0;
+		QByteArray data;
+	};
+
+	struct Directory
+	{
+		qint64 offset = 0;
+		// Position in the file where the offset of this directory is stored, used to replace the directory.
+		qint64 pointerPosition = 0;
+		// Number of entries in the file, filtered tags are not in the entries.
+		int entriesCount = 0;
+		QList<Entry> entries;
+		quint32 nextOffset = 0;
+
+		const Entry* findEntry(uint16_t tag) const;
+		void setEntry(const Entry& entry);
+		void removeEntry(uint16_t tag);
+	};
+
+private:
+	static constexpr int maxSubIFDsDepth = 4;
+
+	QIODevice* device;
+	bool bigEndian = false;
+	QList<Directory> directories;
+	QList<uint16_t> loadedTags;
+
+	bool readDirectory(qint64 offset, qint64 pointerPosition, int depth);
+	bool isDirectoryRead(qint64 offset) const;
+	quint32 readUint32(const char* data) const;
+	uint16_t readUint16(const char* data) const;
+	void writeUint32(quint32 value, char* data) const;
+	void writeUint16(uint16_t value, char* data) const;
+
+public:
+	explicit TiffFile(QIODevice* device);
+
+	// Limits loaded entries to the given tags, so scanning doesn't read large values. Directories read this way must not be written back.
+	void setLoadedTags(const QList<uint16_t>& tags);
+	bool read();
+	bool isBigEndian() const;
+	const QList<Directory>& getDirectories() const;
+	const Directory* findDirectoryByDataOffset(qint64 dataOffset) const;
+	quint64 getValue(const Entry& entry, int index) const;
+	double getRealValue(const Entry& entry, int index) const;
+	QString getString(const Entry& entry) const;
+	Entry createEntry(uint16_t tag, TypeEnum type, const QList<quint64>& values) const;
+	static int getTypeSize(uint16_t type);
+	// Tags holding the offset of a single directory, SubIFDs hold an array of them.
+	static bool isDirectoryPointer(uint16_t tag);
+
+	// Size of the directory with all its values as written by writeDirectory.
+	static qint64 getDirectorySize(const Directory& directory);
+	// File header pointing to the first directory, in the byte order of the file.
+	QByteArray getHeader(quint32 firstDirectoryOffset) const;
+	// Directory with all its values as stored at the position, empty if the values don't fit in 32 bit offsets.
+	QByteArray getDirectoryData(qint64 position, const Directory& directory) const;
+	// Writes the directory with all its values at the position and returns the end position, or -1 on failure.
+	qint64 writeDirectory(qint64 position, const Directory& directory) const;
+	bool writePointer(qint64 pointerPosition, quint32 offset) const;
+};
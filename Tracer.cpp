@@ -0,0 +1,150 @@
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QSaveFile>
+#include <QThread>
+#include "Tracer.h"
+
+QAtomicInt Tracer::isEnabledValue = 0;
+QMutex Tracer::buffersMutex;
+QList<QSharedPointer<Tracer::ThreadBuffer>> Tracer::buffers;
+
+static QElapsedTimer createStartTimer()
+{
+	QElapsedTimer timer;
+	timer.start();
+	return timer;
+}
+
+// Started with the process, so spans of all threads share the time base.
+static const QElapsedTimer startTimer = createStartTimer();
+
+Tracer::Span::Span(const char* name, const char* category, const QString& detail) : name(name), category(category)
+{
+	if (!isEnabled())
+	{
+		return;
+	}
+
+	this->detail = detail;
+	start = getTime();
+}
+
+Tracer::Span::~Span()
+{
+	if (start < 0 || !isEnabled())
+	{
+		return;
+	}
+
+	const qint64 end = getTime();
+	ThreadBuffer& buffer = getThreadBuffer();
+	const QMutexLocker locker(&buffer.mutex);
+	if (buffer.events.size() >= maxEventsPerThread)
+	{
+		buffer.droppedCount++;
+		return;
+	}
+	buffer.events.append({ name, category, detail, start, end - start });
+}
+
+void Tracer::setEnabled(bool isEnabled)
+{
+	isEnabledValue.storeRelaxed(isEnabled ? 1 : 0);
+}
+
+bool Tracer::isEnabled()
+{
+	return isEnabledValue.loadRelaxed() != 0;
+}
+
+void Tracer::clear()
+{
+	const QMutexLocker locker(&buffersMutex);
+	for (const QSharedPointer<ThreadBuffer>& buffer : buffers)
+	{
+		const QMutexLocker bufferLocker(&buffer->mutex);
+		buffer->events.clear();
+		buffer->droppedCount = 0;
+	}
+}
+
+Tracer::ThreadBuffer& Tracer::getThreadBuffer()
+{
+	// Buffers are kept in the list too, so spans of threads which already exited are written as well.
+	thread_local QSharedPointer<ThreadBuffer> threadBuffer;
+	if (threadBuffer == nullptr)
+	{
+		threadBuffer.reset(new ThreadBuffer());
+		const QString threadName = QThread::currentThread()->objectName();
+
+		const QMutexLocker locker(&buffersMutex);
+		threadBuffer->id = buffers.size() + 1;
+		threadBuffer->name = threadName.isEmpty() ? QString("Thread %1").arg(threadBuffer->id) : QString("%1 %2").arg(threadName).arg(threadBuffer->id);
+		buffers.append(threadBuffer);
+	}
+	return *threadBuffer;
+}
+
+qint64 Tracer::getTime()
+{
+	return startTimer.nsecsElapsed() / 1000;
+}
+
+QJsonObject Tracer::getTrace()
+{
+	const qint64 pid = QCoreApplication::applicationPid();
+	QJsonArray events;
+	qint64 droppedCount = 0;
+
+	const QMutexLocker locker(&buffersMutex);
+	for (const QSharedPointer<ThreadBuffer>& buffer : buffers)
+	{
+		const QMutexLocker bufferLocker(&buffer->mutex);
+		droppedCount += buffer->droppedCount;
+
+		QJsonObject threadName;
+		threadName["name"] = "thread_name";
+		threadName["ph"] = "M";
+		threadName["pid"] = pid;
+		threadName["tid"] = buffer->id;
+		QJsonObject threadNameArgs;
+		threadNameArgs["name"] = buffer->name;
+		threadName["args"] = threadNameArgs;
+		events.append(threadName);
+
+		for (const Event& event : buffer->events)
+		{
+			QJsonObject jsonEvent;
+			jsonEvent["name"] = event.name;
+			jsonEvent["cat"] = event.category;
+			jsonEvent["ph"] = "X";
+			jsonEvent["ts"] = event.start;
+			jsonEvent["dur"] = event.duration;
+			jsonEvent["pid"] = pid;
+			jsonEvent["tid"] = buffer->id;
+			if (!event.detail.isEmpty())
+			{
+				QJsonObject args;
+				args["file"] = event.detail;
+				jsonEvent["args"] = args;
+			}
+			events.append(jsonEvent);
+		}
+	}
+
+	QJsonObject trace;
+	trace["traceEvents"] = events;
+	trace["displayTimeUnit"] = "ms";
+	QJsonObject otherData;
+	otherData["droppedEvents"] = droppedCount;
+	trace["otherData"] = otherData;
+	return trace;
+}
+
+bool Tracer::writeTrace(const QString& filePath)
+{
+	QSaveFile file(filePath);
+	return file.open(QIODevice::WriteOnly) && file.write(QJsonDocument(getTrace()).toJson(QJsonDocument::Compact)) >= 0 && file.commit();
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <QAtomicInt>
+#include <QJsonObject>
+#include <QList>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QString>
+
+// Opt-in timeline of the processing, written in the Chrome trace event format which chrome://tracing and Perfetto open. Spans are
+// recorded into a buffer of the thread which runs them, so threads don't contend, and every thread is a separate track of the timeline.
+// When it is disabled a span costs one atomic load.
+class Tracer
+{
+	struct Event
+	{
+		const char* name;
+		const char* category;
+		QString detail;
+		qint64 start;
+		qint64 duration;
+	};
+
+	struct ThreadBuffer
+	{
+		int id = 0;
+		QString name;
+		QMutex mutex;
+		QList<Event> events;
+		qint64 droppedCount = 0;
+	};
+
+	// Long runs keep the newest spans out instead of growing without limit.
+	static constexpr int maxEventsPerThread = 200000;
+
+	static QAtomicInt isEnabledValue;
+	static QMutex buffersMutex;
+	static QList<QSharedPointer<ThreadBuffer>> buffers;
+
+	static ThreadBuffer& getThreadBuffer();
+	// Microseconds since the start of the process.
+	static qint64 getTime();
+
+public:
+	// Records the lifetime of the scope, the detail is shown as the file of the span.
+	class Span
+	{
+		const char* name;
+		const char* category;
+		QString detail;
+		qint64 start = -1;
+
+	public:
+		Span(const char* name, const char* category, const QString& detail = QString());
+		~Span();
+		Span(const Span&) = delete;
+		Span& operator=(const Span&) = delete;
+	};
+
+	static void setEnabled(bool isEnabled);
+	static bool isEnabled();
+	// Drops the recorded spans, e.g. before the next traced batch.
+	static void clear();
+
+	static QJsonObject getTrace();
+	static bool writeTrace(const QString& filePath);
+};
@@ -0,0 +1,198 @@
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QLocalSocket>
+#include "Worker.h"
+#include "MetadataReader.h"
+#include "Processor.h"
+
+int Worker::run(const QString& serverName)
+{
+	QLocalSocket socket;
+	socket.connectToServer(serverName);
+	if (!socket.waitForConnected())
+	{
+		return 1;
+	}
+
+	// Process id tells the supervisor which of its processes the connection belongs to.
+	QJsonObject ready;
+	ready["type"] = "ready";
+	ready["pid"] = QCoreApplication::applicationPid();
+	socket.write(QJsonDocument(ready).toJson(QJsonDocument::Compact) + '\n');
+	socket.waitForBytesWritten();
+
+	// Requests are handled synchronously, the worker has nothing else to do while it waits for the next one.
+	Worker worker;
+	while (socket.state() == QLocalSocket::ConnectedState)
+	{
+		if (!socket.canReadLine() && !socket.waitForReadyRead(-1))
+		{
+			break;
+		}
+
+		while (socket.canReadLine())
+		{
+			const QJsonObject reply = worker.handle(QJsonDocument::fromJson(socket.readLine()).object());
+			if (!reply.isEmpty())
+			{
+				socket.write(QJsonDocument(reply).toJson(QJsonDocument::Compact) + '\n');
+				socket.waitForBytesWritten();
+			}
+		}
+	}
+
+	return 0;
+}
+
+QJsonObject Worker::handle(const QJsonObject& request)
+{
+	const QString type = request["type"].toString();
+	if (type == "job")
+	{
+		settings.reset(new Settings(request["settings"].toObject()));
+		AsyncFileIO::setQueueDepth(settings->ioQueueDepth);
+		AsyncFileIO::setCachePolicy(settings->ioCachePolicy);
+		return {};
+	}
+	else if (type == "finished")
+	{
+		// References of the next batch are published again, so segments of this one are released.
+		publishedReferences.clear();
+		attachedReference.reset();
+		referenceChannels.clear();
+		referenceViews.clear();
+		referenceKey.clear();
+		return {};
+	}
+	else if (settings == nullptr)
+	{
+		return {};
+	}
+	else if (type == "prepare")
+	{
+		return prepare(request);
+	}
+	else if (type == "process")
+	{
+		return process(request);
+	}
+
+	return {};
+}
+
+QJsonObject Worker::prepare(const QJsonObject& request)
+{
+	QJsonObject reply;
+	reply["type"] = "prepared";
+	reply["key"] = request["key"];
+	reply["isPrepared"] = false;
+
+	const QSharedPointer<ProcessingItem> item = readItem(request);
+	if (item == nullptr)
+	{
+		return reply;
+	}
+
+	attachedReference.reset();
+	referenceChannels = Processor::prepareReference(*item);
+	referenceViews = ImageProcessor::getChannelViews(referenceChannels);
+	referenceKey = SharedReference::getKey("", *item);
+	if (referenceChannels.isEmpty())
+	{
+		referenceKey.clear();
+		return reply;
+	}
+
+	const QSharedPointer<SharedReference> sharedReference(new SharedReference(request["key"].toString()));
+	if (sharedReference->publish(referenceChannels))
+	{
+		publishedReferences.append(sharedReference);
+		reply["isPrepared"] = true;
+	}
+
+	return reply;
+}
+
+QJsonObject Worker::process(const QJsonObject& request)
+{
+	QElapsedTimer timer;
+	timer.start();
+
+	TwoPassProcessingState twoPassProcessingState;
+	twoPassProcessingState.performBatchScale = request["performBatchScale"].toBool();
+	twoPassProcessingState.commonScaleForBatch = request["commonScale"].toDouble(1);
+
+	bool isProcessed = false;
+	const QSharedPointer<ProcessingItem> item = readItem(request);
+	if (item != nullptr)
+	{
+		const ProcessingParcel parcel({ *item }, settings->sourceFilesRoot, settings->globalProcessingOptions, settings->savingOptions);
+		const bool isGainMapOutput = settings->savingOptions.outputFormat == SavingOptions::OutputFormatEnum::GainMap;
+		if (isGainMapOutput || loadReference(request["key"].toString(), *item))
+		{
+			isProcessed = Processor::processPrepared(parcel, 0, twoPassProcessingState, request["saveResult"].toBool(true), referenceViews);
+		}
+	}
+
+	QJsonObject reply;
+	reply["type"] = "processed";
+	reply["index"] = request["index"];
+	reply["isProcessed"] = isProcessed;
+	reply["commonScale"] = twoPassProcessingState.commonScaleForBatch;
+	reply["elapsed"] = timer.elapsed();
+	return reply;
+}
+
+bool Worker::loadReference(const QString& sharedKey, const ProcessingItem& item)
+{
+	const QString key = SharedReference::getKey("", item);
+	if (key == referenceKey)
+	{
+		return true;
+	}
+
+	ImageProcessor* imageProcessor = Processor::getImageProcessor(item.sourceFile->metadata->rawType);
+	const int channelSize = imageProcessor->getChannelSize(item.sourceFile->metadata);
+	delete imageProcessor;
+
+	// The segment stays attached while the reference is used, its channels are read in place.
+	referenceKey = key;
+	referenceChannels.clear();
+	attachedReference.reset(sharedKey.isEmpty() ? nullptr : new SharedReference(sharedKey));
+	if (attachedReference != nullptr && attachedReference->read(referenceViews, channelSize))
+	{
+		return true;
+	}
+
+	// Without a published segment, e.g. if shared memory is limited, the worker prepares the reference itself.
+	attachedReference.reset();
+	referenceChannels = Processor::prepareReference(item);
+	referenceViews = ImageProcessor::getChannelViews(referenceChannels);
+	if (referenceChannels.isEmpty())
+	{
+		referenceKey.clear();
+		return false;
+	}
+
+	return true;
+}
+
+QSharedPointer<ProcessingItem> Worker::readItem(const QJsonObject& request)
+{
+	const QString sourceFilePath = request["source"].toString();
+	const QString referenceFilePath = request["reference"].toString();
+	const QSharedPointer<Metadata> sourceMetadata = MetadataReader::readMetadata(sourceFilePath);
+	const QSharedPointer<Metadata> referenceMetadata = MetadataReader::readMetadata(referenceFilePath);
+	if (sourceMetadata == nullptr || referenceMetadata == nullptr)
+	{
+		return nullptr;
+	}
+
+	ProcessingOptions processingOptions;
+	processingOptions.luminanceCorrectionIntensity = request["luminanceCorrectionIntensity"].toDouble();
+	processingOptions.colorCorrectionIntensity = request["colorCorrectionIntensity"].toDouble();
+	processingOptions.gaussianBlurSigma = request["gaussianBlurSigma"].toDouble();
+
+	return QSharedPointer<ProcessingItem>(new ProcessingItem(QSharedPointer<FileInfo>(new FileInfo(sourceFilePath, sourceMetadata)), QSharedPointer<FileInfo>(new FileInfo(referenceFilePath, referenceMetadata)), processingOptions));
+}
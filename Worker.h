@@ -0,0 +1,33 @@
+#pragma once
+#include <QJsonObject>
+#include <QList>
+#include <QSharedPointer>
+#include <QString>
+
+#include "DataStructs.h"
+#include "Settings.h"
+#include "SharedReference.h"
+
+// Worker process of a pool. It gets requests from the supervisor over a local socket, one JSON object per line, handles them one by
+// one and replies in the same way. A crash of the worker loses only the request it was handling.
+class Worker
+{
+	QSharedPointer<Settings> settings;
+	QString referenceKey;
+	// Reference prepared by the worker itself, or the segment of another worker it reads the reference from.
+	QList<QList<float>> referenceChannels;
+	QSharedPointer<SharedReference> attachedReference;
+	QList<const float*> referenceViews;
+	// Published segments stay attached until the supervisor finishes the batch.
+	QList<QSharedPointer<SharedReference>> publishedReferences;
+
+	QJsonObject handle(const QJsonObject& request);
+	QJsonObject prepare(const QJsonObject& request);
+	QJsonObject process(const QJsonObject& request);
+	bool loadReference(const QString& sharedKey, const ProcessingItem& item);
+	static QSharedPointer<ProcessingItem> readItem(const QJsonObject& request);
+
+public:
+	// Returns the exit code of the worker process.
+	static int run(const QString& serverName);
+};
@@ -0,0 +1,473 @@
+#include <QCoreApplication>
+#include <QJsonDocument>
+#include <QThread>
+#include "WorkerPool.h"
+#include "Metrics.h"
+#include "Processor.h"
+
+WorkerPool::WorkerPool(const QJsonObject& job, int workersCount, QObject* parent) : QObject(parent), job(job), workersCount(workersCount)
+{
+	keyPrefix = QString("flatfield-%1-").arg(QCoreApplication::applicationPid());
+	connect(&server, &QLocalServer::newConnection, this, &WorkerPool::slotNewConnection);
+}
+
+WorkerPool::~WorkerPool()
+{
+	// Workers exit when the connection is closed, the ones which don't are killed.
+	isRunning = false;
+	const QList<Connection> remainingConnections = connections;
+	for (const Connection& connection : remainingConnections)
+	{
+		connection.socket->disconnectFromServer();
+	}
+	for (QProcess* process : processes)
+	{
+		process->disconnect(this);
+		if (!process->waitForFinished(1000))
+		{
+			process->kill();
+			process->waitForFinished();
+		}
+	}
+}
+
+bool WorkerPool::start()
+{
+	const QString serverName = keyPrefix + "server";
+	QLocalServer::removeServer(serverName);
+	if (!server.listen(serverName))
+	{
+		return false;
+	}
+
+	for (int i = 0; i < workersCount; i++)
+	{
+		startWorker();
+	}
+
+	return true;
+}
+
+void WorkerPool::startWorker()
+{
+	QProcess* process = new QProcess(this);
+	process->setProcessChannelMode(QProcess::ForwardedErrorChannel);
+	connect(process, &QProcess::finished, this, [this, process]() { slotProcessFinished(process); });
+	connect(process, &QProcess::errorOccurred, this, [this, process](QProcess::ProcessError error)
+	{
+		if (error == QProcess::FailedToStart)
+		{
+			slotProcessFinished(process);
+		}
+	});
+
+	processes.append(process);
+	// Frames of an item are still corrected in parallel, so the cores are split between the workers.
+	const int threadsCount = qMax(1, QThread::idealThreadCount() / workersCount);
+	process->start(QCoreApplication::applicationFilePath(), { "--worker", server.fullServerName(), "--threads", QString::number(threadsCount) });
+}
+
+void WorkerPool::process(const ProcessingParcel& batch)
+{
+	// Gain maps are not scaled and don't use the prepared reference.
+	const bool isGainMapOutput = batch.savingOptions.outputFormat == SavingOptions::OutputFormatEnum::GainMap;
+	isTwoPass = batch.globalProcessingOptions.scaleChannelsToAvoidClipping && batch.globalProcessingOptions.calculateCommonScaleForBatch && !isGainMapOutput;
+	const GlobalProcessingOptions::BatchPassEnum batchPass = isTwoPass ? batch.globalProcessingOptions.batchPass : GlobalProcessingOptions::BatchPassEnum::BothPasses;
+	isFirstPass = isTwoPass && batchPass != GlobalProcessingOptions::BatchPassEnum::SecondPass;
+	isSecondPass = batchPass != GlobalProcessingOptions::BatchPassEnum::FirstPass;
+
+	// Up to date items are left out the same way as in Processor::run.
+	manifest.reset(new Manifest(batch));
+	QList<bool> upToDate(batch.items.size());
+	for (int i = 0; i < batch.items.size(); i++)
+	{
+		upToDate[i] = batchPass == GlobalProcessingOptions::BatchPassEnum::BothPasses &&
+			manifest->isUpToDate(batch.items[i], Processor::getDestinationFilePath(batch.items[i], batch.savingOptions, batch.sourceFileRoot));
+	}
+	if (isTwoPass && upToDate.contains(false))
+	{
+		upToDate.fill(false);
+	}
+
+	parcel.reset(new ProcessingParcel(batch));
+	parcel->items.clear();
+	batchIndexes.clear();
+	keys.clear();
+	for (int i = 0; i < batch.items.size(); i++)
+	{
+		if (!upToDate[i])
+		{
+			parcel->items.append(batch.items[i]);
+			batchIndexes.append(i);
+			keys.append(isGainMapOutput ? QString() : SharedReference::getKey(keyPrefix, batch.items[i]));
+		}
+	}
+
+	twoPassProcessingState = TwoPassProcessingState();
+	if (isTwoPass && !isFirstPass)
+	{
+		twoPassProcessingState.performBatchScale = true;
+		twoPassProcessingState.commonScaleForBatch = batch.globalProcessingOptions.mergedCommonScaleForBatch;
+	}
+	firstPassProcessedCount = 0;
+	step = 1;
+	isRunning = true;
+	isStopped = false;
+
+	emit signalProcessingStarted((isFirstPass + isSecondPass) * parcel->items.size());
+
+	for (int i = 0; i < batch.items.size(); i++)
+	{
+		if (upToDate[i])
+		{
+			emit signalItemUpToDate(i);
+		}
+	}
+
+	startPass();
+}
+
+void WorkerPool::startPass()
+{
+	// Items are processed again in the second pass, a crash in the first pass doesn't use up their attempts.
+	itemAttempts.clear();
+	pendingIndexes.clear();
+	for (int i = 0; i < parcel->items.size(); i++)
+	{
+		pendingIndexes.append(i);
+	}
+
+	dispatch();
+}
+
+void WorkerPool::dispatch()
+{
+	if (!isRunning)
+	{
+		return;
+	}
+
+	for (Connection& connection : connections)
+	{
+		if (connection.index >= 0 || !connection.key.isEmpty())
+		{
+			continue;
+		}
+
+		// Items with a ready reference go first, a missing reference is prepared by the first idle worker, items of a reference which is
+		// being prepared wait for it.
+		int readyPosition = -1;
+		int missingPosition = -1;
+		for (int position = 0; position < pendingIndexes.size() && readyPosition < 0; position++)
+		{
+			const QString& key = keys[pendingIndexes[position]];
+			const ReferenceStateEnum state = key.isEmpty() ? ReferenceStateEnum::Unshared : referenceStates.value(key, ReferenceStateEnum::Missing);
+			if (state == ReferenceStateEnum::Ready || state == ReferenceStateEnum::Unshared)
+			{
+				readyPosition = position;
+			}
+			else if (state == ReferenceStateEnum::Missing && missingPosition < 0)
+			{
+				missingPosition = position;
+			}
+		}
+
+		if (readyPosition >= 0)
+		{
+			connection.index = pendingIndexes.takeAt(readyPosition);
+
+			QJsonObject request = createRequest("process", connection.index);
+			request["index"] = connection.index;
+			request["saveResult"] = !isTwoPass || twoPassProcessingState.performBatchScale;
+			request["performBatchScale"] = twoPassProcessingState.performBatchScale;
+			request["commonScale"] = twoPassProcessingState.commonScaleForBatch;
+			send(connection.socket, request);
+		}
+		else if (missingPosition >= 0)
+		{
+			connection.key = keys[pendingIndexes[missingPosition]];
+			referenceStates[connection.key] = ReferenceStateEnum::Preparing;
+			send(connection.socket, createRequest("prepare", pendingIndexes[missingPosition]));
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	if (isPassFinished())
+	{
+		if (isTwoPass && !twoPassProcessingState.performBatchScale && !isStopped)
+		{
+			emit signalFirstPassFinished(twoPassProcessingState.commonScaleForBatch, firstPassProcessedCount);
+			if (!isSecondPass)
+			{
+				finish();
+				return;
+			}
+
+			twoPassProcessingState.performBatchScale = true;
+			startPass();
+		}
+		else
+		{
+			finish();
+		}
+	}
+	else if (connections.isEmpty() && processes.isEmpty())
+	{
+		// No worker is left to process the rest of the batch, items of an unfinished first pass are not processed at all.
+		if (isTwoPass && !twoPassProcessingState.performBatchScale && isSecondPass)
+		{
+			twoPassProcessingState.performBatchScale = true;
+			pendingIndexes.clear();
+			for (int i = 0; i < parcel->items.size(); i++)
+			{
+				pendingIndexes.append(i);
+			}
+		}
+		while (!pendingIndexes.isEmpty())
+		{
+			handleProcessed(pendingIndexes.takeFirst(), false, 1, 0);
+		}
+		finish();
+	}
+}
+
+void WorkerPool::stop()
+{
+	if (!isRunning)
+	{
+		return;
+	}
+
+	isStopped = true;
+	pendingIndexes.clear();
+	dispatch();
+}
+
+bool WorkerPool::isPassFinished() const
+{
+	if (!pendingIndexes.isEmpty())
+	{
+		return false;
+	}
+
+	for (const Connection& connection : connections)
+	{
+		if (connection.index >= 0)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void WorkerPool::finish()
+{
+	isRunning = false;
+
+	// Shared references live until the last process detaches, the ones of the finished batch are not needed anymore.
+	QJsonObject request;
+	request["type"] = "finished";
+	for (const Connection& connection : connections)
+	{
+		send(connection.socket, request);
+	}
+	sharedReferences.clear();
+	referenceStates.clear();
+	referenceAttempts.clear();
+	manifest.reset();
+
+	emit signalProcessingFinished();
+}
+
+QJsonObject WorkerPool::createRequest(const QString& type, int index) const
+{
+	const ProcessingItem& item = parcel->items[index];
+
+	QJsonObject request;
+	request["type"] = type;
+	request["key"] = keys[index];
+	request["source"] = item.sourceFile->filePath;
+	request["reference"] = item.referenceFile->filePath;
+	request["luminanceCorrectionIntensity"] = item.processingOptions.luminanceCorrectionIntensity;
+	request["colorCorrectionIntensity"] = item.processingOptions.colorCorrectionIntensity;
+	request["gaussianBlurSigma"] = item.processingOptions.gaussianBlurSigma;
+	return request;
+}
+
+void WorkerPool::send(QLocalSocket* socket, const QJsonObject& request)
+{
+	socket->write(QJsonDocument(request).toJson(QJsonDocument::Compact) + '\n');
+	socket->flush();
+}
+
+void WorkerPool::slotNewConnection()
+{
+	while (server.hasPendingConnections())
+	{
+		QLocalSocket* socket = server.nextPendingConnection();
+		connect(socket, &QLocalSocket::readyRead, this, [this, socket]() { slotReadyRead(socket); });
+		connect(socket, &QLocalSocket::disconnected, this, [this, socket]() { slotDisconnected(socket); });
+
+		Connection connection;
+		connection.socket = socket;
+		connections.append(connection);
+
+		QJsonObject request;
+		request["type"] = "job";
+		request["settings"] = job;
+		send(socket, request);
+	}
+
+	dispatch();
+}
+
+int WorkerPool::findConnection(QLocalSocket* socket) const
+{
+	for (int i = 0; i < connections.size(); i++)
+	{
+		if (connections[i].socket == socket)
+		{
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+void WorkerPool::slotReadyRead(QLocalSocket* socket)
+{
+	while (socket->canReadLine())
+	{
+		const int connectionIndex = findConnection(socket);
+		if (connectionIndex < 0)
+		{
+			return;
+		}
+
+		Connection& connection = connections[connectionIndex];
+		const QJsonObject reply = QJsonDocument::fromJson(socket->readLine()).object();
+		const QString type = reply["type"].toString();
+		if (type == "ready")
+		{
+			for (QProcess* process : processes)
+			{
+				if (process->processId() == reply["pid"].toInteger())
+				{
+					connection.process = process;
+					connectedProcesses.insert(process);
+				}
+			}
+		}
+		else if (type == "prepared" && connection.key == reply["key"].toString())
+		{
+			handlePrepared(std::exchange(connection.key, QString()), reply["isPrepared"].toBool());
+		}
+		else if (type == "processed" && connection.index == reply["index"].toInt())
+		{
+			handleProcessed(std::exchange(connection.index, -1), reply["isProcessed"].toBool(), reply["commonScale"].toDouble(1), reply["elapsed"].toInteger());
+		}
+	}
+
+	dispatch();
+}
+
+void WorkerPool::handlePrepared(const QString& key, bool isPrepared)
+{
+	// Supervisor attaches too, so the reference outlives the worker which published it.
+	QSharedPointer<SharedReference> sharedReference(new SharedReference(key));
+	if (isPrepared && sharedReference->attach())
+	{
+		sharedReferences.insert(key, sharedReference);
+		referenceStates[key] = ReferenceStateEnum::Ready;
+	}
+	else
+	{
+		// Workers prepare the reference themselves then, or fail the items if it can't be read.
+		referenceStates[key] = ReferenceStateEnum::Unshared;
+	}
+}
+
+void WorkerPool::handleProcessed(int index, bool isProcessed, float commonScale, qint64 elapsed)
+{
+	if (!twoPassProcessingState.performBatchScale && isTwoPass)
+	{
+		if (isProcessed)
+		{
+			twoPassProcessingState.commonScaleForBatch = qMin(twoPassProcessingState.commonScaleForBatch, commonScale);
+			firstPassProcessedCount++;
+			emit signalProcessingProgressChanged(step++);
+		}
+		return;
+	}
+
+	Metrics::add(isProcessed ? Metrics::FilesProcessed : Metrics::FilesFailed);
+	if (isProcessed)
+	{
+		manifest->update(parcel->items[index], Processor::getDestinationFilePath(parcel->items[index], parcel->savingOptions, parcel->sourceFileRoot));
+	}
+
+	emit signalItemProcessed(batchIndexes[index], isProcessed, elapsed);
+
+	if (isProcessed)
+	{
+		emit signalProcessingProgressChanged(step++);
+	}
+}
+
+void WorkerPool::slotDisconnected(QLocalSocket* socket)
+{
+	const int connectionIndex = findConnection(socket);
+	if (connectionIndex < 0)
+	{
+		return;
+	}
+
+	const Connection connection = connections.takeAt(connectionIndex);
+	socket->deleteLater();
+
+	if (!isRunning)
+	{
+		return;
+	}
+
+	// Work of the lost worker goes back to the queue, unless it already crashed a worker before.
+	if (connection.index >= 0)
+	{
+		if (++itemAttempts[connection.index] < maxAttempts)
+		{
+			pendingIndexes.prepend(connection.index);
+		}
+		else
+		{
+			handleProcessed(connection.index, false, 1, 0);
+		}
+	}
+	if (!connection.key.isEmpty())
+	{
+		referenceStates[connection.key] = ++referenceAttempts[connection.key] < maxAttempts ? ReferenceStateEnum::Missing : ReferenceStateEnum::Unshared;
+	}
+
+	dispatch();
+}
+
+void WorkerPool::slotProcessFinished(QProcess* process)
+{
+	if (!processes.removeOne(process))
+	{
+		return;
+	}
+	process->deleteLater();
+
+	if (connectedProcesses.remove(process))
+	{
+		startWorker();
+	}
+	else
+	{
+		dispatch();
+	}
+}
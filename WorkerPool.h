@@ -0,0 +1,99 @@
+#pragma once
+#include <QHash>
+#include <QJsonObject>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QObject>
+#include <QProcess>
+#include <QSet>
+#include <QSharedPointer>
+
+#include "DataStructs.h"
+#include "Manifest.h"
+#include "SharedReference.h"
+
+// Processes a parcel in worker processes instead of threads, so a crash on a broken file fails only that file. Workers are started from
+// the same executable with the worker option, get items over a local socket and share prepared references through shared memory: the
+// first worker which needs a reference prepares and publishes it, the others only copy it. Items of a crashed worker are given to
+// another one, an item which crashes workers twice fails.
+class WorkerPool : public QObject
+{
+	Q_OBJECT
+
+	enum class ReferenceStateEnum { Missing, Preparing, Ready, Unshared };
+
+	struct Connection
+	{
+		QLocalSocket* socket;
+		QProcess* process = nullptr;
+		// Item or reference the worker is busy with, -1 and empty when it is idle.
+		int index = -1;
+		QString key;
+	};
+
+	static constexpr int maxAttempts = 2;
+
+	QJsonObject job;
+	int workersCount;
+	QString keyPrefix;
+	QLocalServer server;
+	QList<QProcess*> processes;
+	QList<Connection> connections;
+	// Workers which exit before they connect are not started again, e.g. if the executable can't be started at all.
+	QSet<QProcess*> connectedProcesses;
+
+	QSharedPointer<ProcessingParcel> parcel;
+	QSharedPointer<Manifest> manifest;
+	QList<int> batchIndexes;
+	QList<QString> keys;
+	QList<int> pendingIndexes;
+	QHash<int, int> itemAttempts;
+	QHash<QString, int> referenceAttempts;
+	QHash<QString, ReferenceStateEnum> referenceStates;
+	QHash<QString, QSharedPointer<SharedReference>> sharedReferences;
+	bool isTwoPass = false;
+	bool isFirstPass = false;
+	bool isSecondPass = true;
+	int firstPassProcessedCount = 0;
+	bool isRunning = false;
+	bool isStopped = false;
+	TwoPassProcessingState twoPassProcessingState;
+	int step = 1;
+
+	void startWorker();
+	int findConnection(QLocalSocket* socket) const;
+	void startPass();
+	void dispatch();
+	bool isPassFinished() const;
+	void finish();
+	void send(QLocalSocket* socket, const QJsonObject& request);
+	QJsonObject createRequest(const QString& type, int index) const;
+	void handleProcessed(int index, bool isProcessed, float commonScale, qint64 elapsed);
+	void handlePrepared(const QString& key, bool isPrepared);
+
+private slots:
+	void slotNewConnection();
+	void slotReadyRead(QLocalSocket* socket);
+	void slotDisconnected(QLocalSocket* socket);
+	void slotProcessFinished(QProcess* process);
+
+signals:
+	void signalProcessingStarted(int total);
+	void signalProcessingFinished();
+	void signalProcessingProgressChanged(int progress);
+	void signalItemProcessed(int index, bool isProcessed, qint64 elapsed);
+	void signalItemUpToDate(int index);
+	void signalFirstPassFinished(float commonScaleForBatch, int processedCount);
+
+public:
+	// Job has the same values as settings.json, workers load their settings from it.
+	WorkerPool(const QJsonObject& job, int workersCount, QObject* parent = nullptr);
+	~WorkerPool() override;
+
+	// Starts the workers, they are kept for all parcels. Returns false if the local server can't be started.
+	bool start();
+	// Runs the parcel in the workers and reports progress with the same signals as Processor.
+	void process(const ProcessingParcel& parcel);
+	// Items which workers already got are finished, the rest are not processed.
+	void stop();
+};
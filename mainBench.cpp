@@ -0,0 +1,211 @@
+#include "EndToEndBenchmark.h"
+#include "KernelBenchmark.h"
+
+#include <cstdio>
+#include <functional>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QFile>
+#include <QJsonDocument>
+#include <QSaveFile>
+#include <QSysInfo>
+#include <QThreadPool>
+
+// One compact object per line, flushed right away so results of long sweeps can be followed.
+static void writeResult(const QJsonObject& result)
+{
+    const QByteArray line = QJsonDocument(result).toJson(QJsonDocument::Compact) + '\n';
+    std::fwrite(line.constData(), 1, static_cast<size_t>(line.size()), stdout);
+    std::fflush(stdout);
+}
+
+// Parses a comma separated list, returns false if any of the values is not valid.
+template<typename T>
+static bool parseList(const QString& value, const std::function<bool(const QString&, T&)>& parse, QList<T>& list)
+{
+    list.clear();
+    for (const QString& item : value.split(',', Qt::SkipEmptyParts))
+    {
+        T parsed;
+        if (!parse(item.trimmed(), parsed))
+        {
+            return false;
+        }
+        list.append(parsed);
+    }
+    return !list.isEmpty();
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("flatfield-bench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Measures throughput of the pixel processing stages on synthetic images.\n"
+                                     "Results are written to stdout as JSON lines, the first line describes the machine.\n"
+                                     "Exit code is 2 if the end-to-end throughput regressed against the baseline.");
+    parser.addHelpOption();
+
+    const QCommandLineOption layoutsOption("layouts", "Comma separated layouts: mono, rgb, bayer. All by default.", "list");
+    const QCommandLineOption megapixelsOption("megapixels", "Comma separated image sizes in megapixels, 12,24,45,61,102,150 by default.", "list");
+    const QCommandLineOption sigmasOption("sigmas", "Comma separated blur sigmas, 1,10,100,1000 by default.", "list");
+    const QCommandLineOption kernelsOption("kernels", "Comma separated kernels: split, normalize, correct, blur, scale, assemble. All by default.", "list");
+    const QCommandLineOption repeatsOption("repeats", "Number of runs of every kernel, the best one is reported. 3 by default.", "count");
+    const QCommandLineOption threadsOption("threads", "Number of processing threads, all cores are used by default.", "count");
+    const QCommandLineOption bandwidthOption("memory-bandwidth", "Memory bandwidth in GB/s to compare with, measured by default.", "value");
+    const QCommandLineOption endToEndOption("end-to-end", "Runs a synthetic batch through scan, matching, reading, correction and saving instead of the kernels.");
+    const QCommandLineOption filesOption("files", "Number of source files of the end-to-end batch, 8 by default.", "count");
+    const QCommandLineOption workFolderOption("work-folder", "Folder for the end-to-end batch and its outputs, a temporary one by default.", "path");
+    const QCommandLineOption baselineOption("baseline", "End-to-end results are compared with the baseline file.", "file");
+    const QCommandLineOption writeBaselineOption("write-baseline", "End-to-end results are stored as the baseline file.", "file");
+    const QCommandLineOption maxRegressionOption("max-regression", "Allowed drop of files per second against the baseline in percent, 10 by default.", "percent");
+    parser.addOptions({ layoutsOption, megapixelsOption, sigmasOption, kernelsOption, repeatsOption, threadsOption, bandwidthOption,
+                        endToEndOption, filesOption, workFolderOption, baselineOption, writeBaselineOption, maxRegressionOption });
+    parser.process(a);
+
+    KernelBenchmark::Options options;
+    const std::function<bool(const QString&, Metadata::RawTypeEnum&)> parseLayout = [](const QString& value, Metadata::RawTypeEnum& layout)
+    {
+        for (const Metadata::RawTypeEnum candidate : { Metadata::Mono, Metadata::RGB, Metadata::Bayer })
+        {
+            if (value == KernelBenchmark::getName(candidate))
+            {
+                layout = candidate;
+                return true;
+            }
+        }
+        return false;
+    };
+    const std::function<bool(const QString&, int&)> parseMegapixels = [](const QString& value, int& megapixels)
+    {
+        bool isValid = false;
+        megapixels = value.toInt(&isValid);
+        return isValid && megapixels > 0;
+    };
+    const std::function<bool(const QString&, float&)> parseSigma = [](const QString& value, float& sigma)
+    {
+        bool isValid = false;
+        sigma = value.toFloat(&isValid);
+        return isValid && sigma > 0;
+    };
+    const std::function<bool(const QString&, KernelBenchmark::KernelEnum&)> parseKernel = [](const QString& value, KernelBenchmark::KernelEnum& kernel)
+    {
+        for (int candidate = 0; candidate < KernelBenchmark::KernelsCount; candidate++)
+        {
+            if (value == KernelBenchmark::getName(static_cast<KernelBenchmark::KernelEnum>(candidate)))
+            {
+                kernel = static_cast<KernelBenchmark::KernelEnum>(candidate);
+                return true;
+            }
+        }
+        return false;
+    };
+
+    if ((parser.isSet(layoutsOption) && !parseList(parser.value(layoutsOption), parseLayout, options.layouts)) ||
+        (parser.isSet(megapixelsOption) && !parseList(parser.value(megapixelsOption), parseMegapixels, options.megapixels)) ||
+        (parser.isSet(sigmasOption) && !parseList(parser.value(sigmasOption), parseSigma, options.sigmas)) ||
+        (parser.isSet(kernelsOption) && !parseList(parser.value(kernelsOption), parseKernel, options.kernels)))
+    {
+        qCritical().noquote() << "Invalid list of layouts, sizes, sigmas or kernels";
+        return 1;
+    }
+    if (parser.isSet(repeatsOption))
+    {
+        options.repeats = parser.value(repeatsOption).toInt();
+        if (options.repeats <= 0)
+        {
+            qCritical().noquote() << "Invalid number of repeats" << parser.value(repeatsOption);
+            return 1;
+        }
+    }
+    if (parser.isSet(threadsOption) && parser.value(threadsOption).toInt() > 0)
+    {
+        QThreadPool::globalInstance()->setMaxThreadCount(parser.value(threadsOption).toInt());
+    }
+
+    QJsonObject environment;
+    environment["type"] = "environment";
+    environment["cpuArchitecture"] = QSysInfo::currentCpuArchitecture();
+    environment["os"] = QSysInfo::prettyProductName();
+    environment["qtVersion"] = qVersion();
+    environment["threads"] = QThreadPool::globalInstance()->maxThreadCount();
+
+    if (!parser.isSet(endToEndOption))
+    {
+        const double memoryBandwidth = parser.isSet(bandwidthOption) ? parser.value(bandwidthOption).toDouble() : KernelBenchmark::measureMemoryBandwidth();
+        environment["memoryBandwidthGBs"] = memoryBandwidth;
+        writeResult(environment);
+
+        KernelBenchmark::run(options, memoryBandwidth, writeResult);
+        return 0;
+    }
+
+    // Batch has a single image size, the first one of the list.
+    EndToEndBenchmark::Options endToEndOptions;
+    if (parser.isSet(megapixelsOption))
+    {
+        endToEndOptions.megapixels = options.megapixels[0];
+    }
+    if (parser.isSet(filesOption))
+    {
+        endToEndOptions.filesCount = parser.value(filesOption).toInt();
+        if (endToEndOptions.filesCount <= 0)
+        {
+            qCritical().noquote() << "Invalid number of files" << parser.value(filesOption);
+            return 1;
+        }
+    }
+    endToEndOptions.workFolder = parser.value(workFolderOption);
+
+    const double maxRegression = parser.isSet(maxRegressionOption) ? parser.value(maxRegressionOption).toDouble() / 100 : 0.1;
+    if (maxRegression < 0)
+    {
+        qCritical().noquote() << "Invalid allowed regression" << parser.value(maxRegressionOption);
+        return 1;
+    }
+
+    // Baseline is read before the run, so a missing file doesn't cost a whole batch.
+    QJsonObject baseline;
+    if (parser.isSet(baselineOption))
+    {
+        QFile baselineFile(parser.value(baselineOption));
+        if (!baselineFile.open(QIODevice::ReadOnly))
+        {
+            qCritical().noquote() << "Can't read baseline" << parser.value(baselineOption);
+            return 1;
+        }
+        baseline = QJsonDocument::fromJson(baselineFile.readAll()).object();
+        if (baseline["files"].toInt() != endToEndOptions.filesCount || baseline["megapixels"].toInt() != endToEndOptions.megapixels)
+        {
+            qCritical().noquote() << "Baseline was recorded with" << baseline["files"].toInt() << "files of" << baseline["megapixels"].toInt() << "megapixels";
+            return 1;
+        }
+    }
+
+    writeResult(environment);
+    const QJsonObject results = EndToEndBenchmark::run(endToEndOptions, writeResult);
+    if (results.isEmpty())
+    {
+        qCritical().noquote() << "Can't create the batch";
+        return 1;
+    }
+    if (!EndToEndBenchmark::isComplete(results))
+    {
+        qCritical().noquote() << "Not all files of the batch were processed";
+        return 1;
+    }
+
+    if (parser.isSet(writeBaselineOption))
+    {
+        QSaveFile baselineFile(parser.value(writeBaselineOption));
+        if (!baselineFile.open(QIODevice::WriteOnly) || baselineFile.write(QJsonDocument(EndToEndBenchmark::createBaseline(endToEndOptions, results)).toJson()) < 0 || !baselineFile.commit())
+        {
+            qCritical().noquote() << "Can't write baseline" << parser.value(writeBaselineOption);
+            return 1;
+        }
+    }
+
+    return parser.isSet(baselineOption) && !EndToEndBenchmark::compare(results, baseline, maxRegression, writeResult) ? 2 : 0;
+}
@@ -0,0 +1,309 @@
+#include "BatchRunner.h"
+#include "BatchStatistics.h"
+#include "JobServer.h"
+#include "MemoryProfiler.h"
+#include "MetricsServer.h"
+#include "Worker.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QFile>
+#include <QJsonDocument>
+#include <QThreadPool>
+
+// Command line options override values of the job file, names of the values are the same as in settings.json.
+struct JobOption
+{
+    QCommandLineOption option;
+    QString key;
+    enum {String, Number, Flag} type;
+};
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("flatfield-cli");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Corrects all DNG files of the source folder which have exactly one matching reference file.\n"
+                                     "Result of every file and the batch summary are written to stdout as JSON lines.");
+    parser.addHelpOption();
+
+    const QCommandLineOption jobFileOption("job", "JSON job file, with the same values as settings.json.", "file");
+    const QCommandLineOption rebuildOption("rebuild-references", "Rebuild the reference files DB before processing.");
+    const QCommandLineOption noRecurseOption("no-recurse", "Do not scan subfolders of the source folder.");
+    const QCommandLineOption threadsOption("threads", "Number of processing threads, all cores are used by default.", "count");
+    const QCommandLineOption formatOption("format", "Output format: same, ljpeg or gainmap.", "format");
+    const QCommandLineOption forceOption("force", "Process files which are up to date in the processing manifest too.");
+    const QCommandLineOption watchOption("watch", "Keep running and process new files of the source folder as soon as they are written.");
+    const QCommandLineOption workersOption("workers", "Process files in this number of worker processes, so a crash on a broken file fails only that file.", "count");
+    const QCommandLineOption shardStatisticsOption("shard-statistics", "Run the first pass of a shard of a batch split across nodes and write its statistics to the file, nothing is saved.", "file");
+    const QCommandLineOption mergedStatisticsOption("merged-statistics", "Process a shard of a batch split across nodes with the common scale of the merged statistics file.", "file");
+    const QCommandLineOption mergeStatisticsOption("merge-statistics", "Merge statistics files of the shards given as arguments into the file and exit.", "file");
+    const QCommandLineOption serveOption("serve", "Keep running and accept jobs from clients of the local server with this name.", "name");
+    const QCommandLineOption memoryReportOption("memory-report", "Track memory held by the processing stages and write the report of the batch to the file.", "file");
+    const QCommandLineOption traceOption("trace", "Write a timeline of the processing to the file, in the Chrome trace format.", "file");
+    const QCommandLineOption traceIntervalOption("trace-interval", "With --watch, trace only every n-th batch, 1 by default.", "n");
+    const QCommandLineOption metricsPortOption("metrics-port", "Serve metrics on this port of localhost, at /metrics for Prometheus and /metrics.json.", "port");
+    // Started by the supervisor process only.
+    QCommandLineOption workerOption("worker", "Run as a worker of the supervisor listening on this server.", "server");
+    workerOption.setFlags(QCommandLineOption::HiddenFromHelp);
+    const QCommandLineOption settleTimeOption("settle-time", "Time in milliseconds the size of a new file must stay the same before it is processed, 1000 by default.", "ms");
+    const QList<JobOption> jobOptions =
+    {
+        { QCommandLineOption("sources", "Source files root folder.", "folder"), "sourceFilesRoot", JobOption::String },
+        { QCommandLineOption("references", "Reference files root folder.", "folder"), "referenceFilesRoot", JobOption::String },
+        { QCommandLineOption("focal-length-difference", "Allowed focal length difference, percents.", "value"), "referenceFileMatcherMaxAllowedFocalLengthDifferencePercents", JobOption::Number },
+        { QCommandLineOption("fnumber-difference", "Allowed f-number difference, stops.", "value"), "referenceFileMatcherMaxAllowedFNumberDifferenceStops", JobOption::Number },
+        { QCommandLineOption("ignore-focal-length", "Ignore focal length when matching references."), "referenceFileMatcherIgnoreFocalLength", JobOption::Flag },
+        { QCommandLineOption("ignore-fnumber", "Ignore f-number when matching references."), "referenceFileMatcherIgnoreFNumber", JobOption::Flag },
+        { QCommandLineOption("ignore-lens", "Ignore lens tag when matching references."), "referenceFileMatcherIgnoreLensTag", JobOption::Flag },
+        { QCommandLineOption("luminance", "Luminance correction intensity, 0 to 1.", "value"), "processingDefaultLuminanceCorrectionIntensity", JobOption::Number },
+        { QCommandLineOption("color", "Color correction intensity, 0 to 1.", "value"), "processingDefaultColorCorrectionIntensity", JobOption::Number },
+        { QCommandLineOption("blur", "Gaussian blur sigma.", "value"), "processingDefaultGaussianBlurSigma", JobOption::Number },
+        { QCommandLineOption("limit-to-white-level", "Limit values to the white level."), "processingLimitToWhiteLevel", JobOption::Flag },
+        { QCommandLineOption("scale-channels", "Scale channels to avoid clipping."), "processingScaleChannelsToAvoidClipping", JobOption::Flag },
+        { QCommandLineOption("common-scale", "Calculate common scale for the batch."), "processingCalculateCommonScaleForBatch", JobOption::Flag },
+        { QCommandLineOption("output-folder", "Save processed files to this folder.", "folder"), "saveProcessedFilesToFolderPath", JobOption::String },
+        { QCommandLineOption("output-subfolder", "Save processed files to this subfolder of every source folder.", "name"), "saveProcessedFilesToSubfolderFolderName", JobOption::String },
+        { QCommandLineOption("map-output", "Write corrected data straight into memory mapped output files."), "saveMapOutputFile", JobOption::Flag },
+    };
+
+    parser.addOptions({ jobFileOption, rebuildOption, noRecurseOption, threadsOption, formatOption, forceOption, watchOption, settleTimeOption, workersOption, workerOption, shardStatisticsOption, mergedStatisticsOption, mergeStatisticsOption, serveOption, metricsPortOption, memoryReportOption, traceOption, traceIntervalOption });
+    parser.addPositionalArgument("statistics", "Statistics files of the shards to merge, with --merge-statistics.", "[statistics...]");
+    for (const JobOption& jobOption : jobOptions)
+    {
+        parser.addOption(jobOption.option);
+    }
+    parser.process(a);
+
+    if (parser.isSet(workerOption))
+    {
+        if (parser.value(threadsOption).toInt() > 0)
+        {
+            QThreadPool::globalInstance()->setMaxThreadCount(parser.value(threadsOption).toInt());
+        }
+        return Worker::run(parser.value(workerOption));
+    }
+
+    if (parser.isSet(mergeStatisticsOption))
+    {
+        if (parser.positionalArguments().isEmpty())
+        {
+            qCritical().noquote() << "No statistics files to merge";
+            return 1;
+        }
+
+        BatchStatistics mergedStatistics;
+        for (const QString& filePath : parser.positionalArguments())
+        {
+            BatchStatistics statistics;
+            if (!statistics.read(filePath))
+            {
+                qCritical().noquote() << "Can't read statistics file" << filePath;
+                return 1;
+            }
+            if (!mergedStatistics.merge(statistics))
+            {
+                qCritical().noquote() << "Statistics file" << filePath << "was calculated with different options";
+                return 1;
+            }
+        }
+
+        if (!mergedStatistics.write(parser.value(mergeStatisticsOption)))
+        {
+            qCritical().noquote() << "Can't write statistics file" << parser.value(mergeStatisticsOption);
+            return 1;
+        }
+        return 0;
+    }
+
+    QJsonObject job;
+    if (parser.isSet(jobFileOption))
+    {
+        QFile jobFile(parser.value(jobFileOption));
+        const QJsonDocument jsonDocument = jobFile.open(QIODevice::ReadOnly) ? QJsonDocument::fromJson(jobFile.readAll()) : QJsonDocument();
+        if (!jsonDocument.isObject())
+        {
+            qCritical().noquote() << "Can't read job file" << jobFile.fileName();
+            return 1;
+        }
+        job = jsonDocument.object();
+    }
+
+    for (const JobOption& jobOption : jobOptions)
+    {
+        if (!parser.isSet(jobOption.option))
+        {
+            continue;
+        }
+
+        const QString value = parser.value(jobOption.option);
+        if (jobOption.type == JobOption::Flag)
+        {
+            job[jobOption.key] = true;
+        }
+        else if (jobOption.type == JobOption::Number)
+        {
+            bool isNumber = false;
+            job[jobOption.key] = value.toDouble(&isNumber);
+            if (!isNumber)
+            {
+                qCritical().noquote() << "Invalid value of" << jobOption.option.names().first() << ":" << value;
+                return 1;
+            }
+        }
+        else
+        {
+            job[jobOption.key] = value;
+        }
+    }
+
+    if (parser.isSet(noRecurseOption))
+    {
+        job["sourceFilesRecurseSubfolders"] = false;
+    }
+    if (parser.isSet(forceOption))
+    {
+        job["saveSkipUpToDate"] = false;
+    }
+    if (parser.isSet("output-folder"))
+    {
+        job["saveTo"] = SavingOptions::SaveToEnum::Folder;
+    }
+    else if (parser.isSet("output-subfolder"))
+    {
+        job["saveTo"] = SavingOptions::SaveToEnum::Subfolder;
+    }
+    if (parser.isSet(formatOption))
+    {
+        const QStringList formats = { "same", "ljpeg", "gainmap" };
+        const int format = formats.indexOf(parser.value(formatOption));
+        if (format < 0)
+        {
+            qCritical().noquote() << "Invalid output format" << parser.value(formatOption);
+            return 1;
+        }
+        job["saveOutputFormat"] = format;
+    }
+
+    const Settings settings(job);
+    // I/O tuning is global for the process, jobs of the server share it.
+    AsyncFileIO::setQueueDepth(settings.ioQueueDepth);
+    AsyncFileIO::setCachePolicy(settings.ioCachePolicy);
+    Prefetcher::setLookahead(settings.prefetchItems);
+    Prefetcher::setMemoryLimit(settings.prefetchMemoryLimit);
+    if (parser.isSet(threadsOption) && parser.value(threadsOption).toInt() > 0)
+    {
+        QThreadPool::globalInstance()->setMaxThreadCount(parser.value(threadsOption).toInt());
+    }
+
+    MetricsServer metricsServer;
+    if (parser.isSet(metricsPortOption) && !metricsServer.listen(parser.value(metricsPortOption).toUShort()))
+    {
+        qCritical().noquote() << "Can't serve metrics on port" << parser.value(metricsPortOption) << metricsServer.getErrorString();
+        return 1;
+    }
+
+    if (parser.isSet(serveOption))
+    {
+        JobServer jobServer;
+        if (!jobServer.listen(parser.value(serveOption)))
+        {
+            qCritical().noquote() << "Can't listen on" << parser.value(serveOption);
+            return 1;
+        }
+        return a.exec();
+    }
+
+    if (settings.sourceFilesRoot.isEmpty() || settings.referenceMatcherOptions.referenceFilesRoot.isEmpty())
+    {
+        qCritical().noquote() << "Source and reference folders must be set";
+        return 1;
+    }
+    if (settings.savingOptions.saveTo == SavingOptions::SaveToEnum::Folder && settings.savingOptions.saveToFolderPath.isEmpty())
+    {
+        qCritical().noquote() << "Output folder must be set";
+        return 1;
+    }
+
+    BatchRunner runner(settings);
+    if (!runner.loadReferences(parser.isSet(rebuildOption)))
+    {
+        qCritical().noquote() << "No reference files found in" << settings.referenceMatcherOptions.referenceFilesRoot;
+        return 1;
+    }
+
+    if (parser.isSet(shardStatisticsOption) || parser.isSet(mergedStatisticsOption))
+    {
+        // Without the common scale every file is corrected on its own, and shards need no statistics.
+        if (!settings.globalProcessingOptions.scaleChannelsToAvoidClipping || !settings.globalProcessingOptions.calculateCommonScaleForBatch ||
+            settings.savingOptions.outputFormat == SavingOptions::OutputFormatEnum::GainMap || parser.isSet(watchOption))
+        {
+            qCritical().noquote() << "Shards need channels scaled with the common scale for batch, without gain map output or watch mode";
+            return 1;
+        }
+
+        const bool isFirstPass = parser.isSet(shardStatisticsOption);
+        if (!runner.setShardPass(isFirstPass ? GlobalProcessingOptions::BatchPassEnum::FirstPass : GlobalProcessingOptions::BatchPassEnum::SecondPass,
+                                 parser.value(isFirstPass ? shardStatisticsOption : mergedStatisticsOption)))
+        {
+            qCritical().noquote() << "Can't use merged statistics file" << parser.value(mergedStatisticsOption);
+            return 1;
+        }
+    }
+
+    if (parser.isSet(memoryReportOption))
+    {
+        // Worker processes would need reports of their own.
+        if (parser.isSet(workersOption))
+        {
+            qCritical().noquote() << "Memory report can't be used with worker processes";
+            return 1;
+        }
+        MemoryProfiler::setEnabled(true);
+        runner.setMemoryReport(parser.value(memoryReportOption));
+    }
+
+    if (parser.isSet(traceOption))
+    {
+        // Spans of worker processes would be in their own traces.
+        if (parser.isSet(workersOption))
+        {
+            qCritical().noquote() << "Trace can't be used with worker processes";
+            return 1;
+        }
+        runner.setTrace(parser.value(traceOption), parser.isSet(traceIntervalOption) ? parser.value(traceIntervalOption).toInt() : 1);
+    }
+
+    if (parser.isSet(workersOption))
+    {
+        const int workersCount = parser.value(workersOption).toInt();
+        if (workersCount <= 0)
+        {
+            qCritical().noquote() << "Invalid number of workers" << parser.value(workersOption);
+            return 1;
+        }
+        if (!runner.startWorkers(job, workersCount))
+        {
+            qCritical().noquote() << "Can't start the worker pool";
+            return 1;
+        }
+    }
+
+    if (parser.isSet(watchOption))
+    {
+        const int settleTime = parser.isSet(settleTimeOption) ? parser.value(settleTimeOption).toInt() : FolderWatcher::defaultSettleTime;
+        if (!runner.watch(settleTime))
+        {
+            qCritical().noquote() << "Can't watch" << settings.sourceFilesRoot;
+            return 1;
+        }
+        return a.exec();
+    }
+
+    QObject::connect(&runner, &BatchRunner::signalFinished, &a, &QCoreApplication::exit);
+    runner.start();
+    return a.exec();
+}
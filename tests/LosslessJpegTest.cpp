@@ -0,0 +1,44 @@
+#include <QTest>
+#include "LosslessJpeg.h"
+
+class LosslessJpegTest : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void roundTrip();
+	void overfullHuffmanTable();
+};
+
+void LosslessJpegTest::roundTrip()
+{
+	const int width = 16;
+	const int height = 8;
+	QList<uint16_t> source(width * height);
+	for (int i = 0; i < source.size(); i++)
+	{
+		source[i] = static_cast<uint16_t>(i * 389 % 65536);
+	}
+
+	const QByteArray encoded = LosslessJpeg::encode(source.constData(), width, width, height, 1, 16);
+	QList<uint16_t> decoded(width * height);
+	QVERIFY(LosslessJpeg::decode(encoded.constData(), encoded.size(), { decoded.data(), width, width, height, width }));
+	QCOMPARE(decoded, source);
+}
+
+void LosslessJpegTest::overfullHuffmanTable()
+{
+	// DHT with 16 codes of length 1, only 2 fit, the extra ones would be written past the end of the lookup.
+	QByteArray data = QByteArray::fromHex("ffd8" "ffc4" "0023" "00" "10000000000000000000000000000000");
+	for (int i = 0; i < 16; i++)
+	{
+		data.append(static_cast<char>(i));
+	}
+	data.append(QByteArray::fromHex("ffc3" "000b" "10" "0001" "0001" "01" "011100"));
+
+	uint16_t sample = 0;
+	QVERIFY(!LosslessJpeg::decode(data.constData(), data.size(), { &sample, 1, 1, 1, 1 }));
+}
+
+QTEST_APPLESS_MAIN(LosslessJpegTest)
+#include "LosslessJpegTest.moc"
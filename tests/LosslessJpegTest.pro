@@ -0,0 +1,16 @@
+# Regression tests of the lossless JPEG decoder, run with make check.
+QT = core testlib
+
+CONFIG += c++17 console testcase
+CONFIG -= app_bundle
+
+TARGET = tst_losslessjpeg
+
+INCLUDEPATH += $$PWD/..
+
+SOURCES += \
+    $$PWD/../LosslessJpeg.cpp \
+    LosslessJpegTest.cpp
+
+HEADERS += \
+    $$PWD/../LosslessJpeg.h
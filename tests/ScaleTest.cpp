@@ -0,0 +1,70 @@
+#include <algorithm>
+#include <QTest>
+#include "BitPacking.h"
+#include "FlatfieldCore.h"
+
+class ScaleTest : public QObject
+{
+	Q_OBJECT
+
+	static QSharedPointer<Metadata> createMetadata(int size, int bitsPerSample);
+
+private slots:
+	void packedSourceIsScaledToItsRange();
+};
+
+QSharedPointer<Metadata> ScaleTest::createMetadata(int size, int bitsPerSample)
+{
+	const QSharedPointer<Metadata> metadata(new Metadata());
+	metadata->cameraMaker = "Test";
+	metadata->cameraModel = "Test";
+	metadata->rawType = Metadata::RawTypeEnum::Mono;
+	metadata->imageHeight = size;
+	metadata->imageWidth = size;
+	metadata->activeArea = { 0, 0, size, size };
+	metadata->blackLevels = { 0 };
+	metadata->bitsPerSample = bitsPerSample;
+	metadata->whiteLevels = { metadata->getMaxValue() };
+	return metadata;
+}
+
+void ScaleTest::packedSourceIsScaledToItsRange()
+{
+	// Reference falls to a half at the corners, so corrected corners are twice as bright as the flat source and exceed 12 bits.
+	const int size = 64;
+	const QSharedPointer<Metadata> metadata = createMetadata(size, 12);
+	QList<uint16_t> imageBuffer(size * size, 3000);
+	QList<uint16_t> referenceBuffer(size * size);
+	const float center = (size - 1) / 2.0f;
+	for (int row = 0; row < size; row++)
+	{
+		for (int column = 0; column < size; column++)
+		{
+			const float distance = ((row - center) * (row - center) + (column - center) * (column - center)) / (2 * center * center);
+			referenceBuffer[row * size + column] = static_cast<uint16_t>(4000 * (1 - distance / 2));
+		}
+	}
+
+	ProcessingOptions processingOptions;
+	processingOptions.luminanceCorrectionIntensity = 1;
+	processingOptions.gaussianBlurSigma = 1;
+	GlobalProcessingOptions globalProcessingOptions;
+	globalProcessingOptions.scaleChannelsToAvoidClipping = true;
+	QVERIFY(FlatfieldCore::correct(imageBuffer, metadata, referenceBuffer, metadata, processingOptions, globalProcessingOptions));
+
+	// Scaled to the 12 bit range, so only the brightest corners come close to the largest value.
+	const uint16_t maxValue = *std::max_element(imageBuffer.begin(), imageBuffer.end());
+	QVERIFY(maxValue <= metadata->getMaxValue());
+	QVERIFY(maxValue > metadata->getMaxValue() * 0.99);
+	QVERIFY(std::count(imageBuffer.begin(), imageBuffer.end(), maxValue) < imageBuffer.size() / 100);
+
+	// Packing clamps values above the range, none are changed.
+	QByteArray packed(BitPacking::getPackedSize(imageBuffer.size(), metadata->bitsPerSample), 0);
+	BitPacking::pack(imageBuffer.constData(), packed.data(), imageBuffer.size(), metadata->bitsPerSample);
+	QList<uint16_t> unpacked(imageBuffer.size());
+	BitPacking::unpack(packed.constData(), unpacked.data(), unpacked.size(), metadata->bitsPerSample);
+	QCOMPARE(unpacked, imageBuffer);
+}
+
+QTEST_APPLESS_MAIN(ScaleTest)
+#include "ScaleTest.moc"
@@ -0,0 +1,12 @@
+# Tests of scaling and clipping of corrected samples to the range of the source, run with make check.
+QT = core testlib
+
+CONFIG += console testcase
+CONFIG -= app_bundle
+
+TARGET = tst_scale
+
+include(../FlatfieldCore.pri)
+
+SOURCES += \
+    ScaleTest.cpp